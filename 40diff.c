@@ -0,0 +1,250 @@
+/*
+ * 40diff.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Compares two compressed images of the same size without decompressing
+ * them, printing the same difference `ppmdiff` would print for their
+ * decompressions, and how many blocks differ
+ *
+ * Usage: `./40diff image1 image2`, where either image may be `-` for standard
+ * input.
+ *
+ * A codeword holds everything its 2-by-2 block decompresses from, and nothing
+ * else, so two blocks with the same codeword decompress to the same pixels
+ * and add nothing to the difference. The codewords of both images are read a
+ * chunk at a time and compared with memcmp, a chunk and then a cache line at
+ * a time, so that unchanged stretches (most of the image, when comparing two
+ * versions of an archived image) cost little more than reading them; only
+ * the blocks whose codewords differ are decoded, both ways, and compared
+ * pixel by pixel.
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+/* C standard library */
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* CS 40 */
+#include "assert.h"
+#include "mem.h"
+
+/* Student-written */
+#include "blockPack.h"
+#include "readwrite.h"
+
+/* The number of codewords of each image read at once */
+#define CHUNK_WORDS (1 << 18)
+
+/* The number of codewords compared at once before looking at single ones: a
+ * 64-byte cache line */
+#define RUN_WORDS 16
+
+/* An exact sum of squares; __extension__ keeps -pedantic quiet */
+__extension__ typedef unsigned __int128 Sum;
+
+/*******************************************************************************
+ * Functions
+ ******************************************************************************/
+
+/* openCompressed
+ *
+ * Opens a compressed image and reads its header.
+ *
+ * Parameters
+ *      char *name      the file name of the image, or `-` for `stdin`
+ *      unsigned *width set to the width of the image, in pixels
+ *      unsigned *height
+ *                      set to the height of the image, in pixels
+ *
+ * Returns
+ *      FILE *          the image, positioned at its first codeword
+ *
+ * Notes
+ *      Prints a message to `stderr` and exits with code 1 (`EXIT_FAILURE`) if
+ *              the file could not be opened.
+ *      Will CRE if the image does not start with a valid format 2 header.
+ */
+static FILE *openCompressed(char *name, unsigned *width, unsigned *height)
+{
+        FILE *fp = strcmp(name, "-") == 0 ? stdin : fopen(name, "rb");
+        if (fp == NULL) {
+                fprintf(stderr, "Error: file %s could not be opened.\n", name);
+                exit(EXIT_FAILURE);
+        }
+        readCompressedHeader(fp, width, height);
+        return fp;
+}
+
+/* decodeWord
+ *
+ * Decodes a codeword as it is stored in a file into the pixels of its block.
+ *
+ * Parameters
+ *      const unsigned char *bytes
+ *                      the four bytes of the codeword, least significant
+ *                      first
+ *      struct Pnm_rgb *pixels
+ *                      an array of four pixels, set to the top-left,
+ *                      top-right, bottom-left and bottom-right pixels of the
+ *                      block, at maxval 255, as decompress40 would give them
+ *
+ * Returns
+ *      None (void)
+ */
+static void decodeWord(const unsigned char *bytes, struct Pnm_rgb *pixels)
+{
+        uint32_t codeWord = (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 |
+                            (uint32_t)bytes[2] << 16 |
+                            (uint32_t)bytes[3] << 24;
+        struct vidComp block[4];
+        decodeBlock(codeWord, block);
+        for (int i = 0; i < 4; i++) {
+                pixels[i] = toRGB(block[i], 255);
+        }
+}
+
+/* compareWord
+ *
+ * Gets the sum of the squared differences of the pixels two codewords
+ * decode to.
+ *
+ * Parameters
+ *      const unsigned char *a, *b
+ *                      the four bytes of each codeword
+ *
+ * Returns
+ *      uint64_t        the sum over the 12 samples of the block, at maxval
+ *                      255
+ */
+static uint64_t compareWord(const unsigned char *a, const unsigned char *b)
+{
+        struct Pnm_rgb pixelsA[4], pixelsB[4];
+        decodeWord(a, pixelsA);
+        decodeWord(b, pixelsB);
+        uint64_t sum = 0;
+        for (int i = 0; i < 4; i++) {
+                int64_t dr = (int64_t)pixelsA[i].red - pixelsB[i].red;
+                int64_t dg = (int64_t)pixelsA[i].green - pixelsB[i].green;
+                int64_t db = (int64_t)pixelsA[i].blue - pixelsB[i].blue;
+                sum += dr * dr + dg * dg + db * db;
+        }
+        return sum;
+}
+
+/* compareChunk
+ *
+ * Compares a chunk of the codewords of two images.
+ *
+ * Parameters
+ *      const unsigned char *a, *b
+ *                      the codewords of each image, as stored in the file
+ *      size_t words    the number of codewords in the chunk
+ *      uint64_t *changed
+ *                      increased by the number of codewords that differ
+ *
+ * Returns
+ *      uint64_t        the sum of the squared differences of the samples of
+ *                      the chunk, at maxval 255
+ *
+ * Notes
+ *      At most 2^40 for a full chunk, so it fits.
+ */
+static uint64_t compareChunk(const unsigned char *a, const unsigned char *b,
+                             size_t words, uint64_t *changed)
+{
+        uint64_t sum = 0;
+        if (memcmp(a, b, words * 4) == 0) {
+                return 0;
+        }
+        for (size_t run = 0; run < words; run += RUN_WORDS) {
+                size_t end = words - run < RUN_WORDS ? words : run + RUN_WORDS;
+                if (memcmp(a + run * 4, b + run * 4, (end - run) * 4) == 0) {
+                        continue;
+                }
+                for (size_t word = run; word < end; word++) {
+                        if (memcmp(a + word * 4, b + word * 4, 4) != 0) {
+                                sum += compareWord(a + word * 4, b + word * 4);
+                                (*changed)++;
+                        }
+                }
+        }
+        return sum;
+}
+
+/* main
+ *
+ * Entry point for the 40diff program; checks that both images are the same
+ * size, then compares their codewords a chunk at a time.
+ *
+ * Parameters
+ *      int argc        (number of command-line arguments, including the
+ *                      program name)
+ *      char **argv     (array of strings representing command-line arguments)
+ *
+ * Returns
+ *      int             0 (EXIT_SUCCESS) if the images could be compared
+ *                      1 (EXIT_FAILURE) otherwise
+ *
+ * Notes
+ *      Will exit with 1 if the images are not the same size; `ppmdiff` can
+ *              compare their decompressions instead.
+ *      Will CRE if an image is not a valid compressed image, or ends early.
+ */
+int main(int argc, char *argv[])
+{
+        if (argc != 3 || (strcmp(argv[1], "-") == 0 &&
+                          strcmp(argv[2], "-") == 0)) {
+                fprintf(stderr, "Usage: %s image1 image2\n"
+                        "  (at most one image may be '-' for stdin)\n",
+                        argv[0]);
+                exit(EXIT_FAILURE);
+        }
+
+        unsigned width1, height1, width2, height2;
+        FILE *input1 = openCompressed(argv[1], &width1, &height1);
+        FILE *input2 = openCompressed(argv[2], &width2, &height2);
+        if (width1 != width2 || height1 != height2) {
+                fprintf(stderr, "%s: the images are %ux%u and %ux%u; compare "
+                        "their decompressions with ppmdiff\n", argv[0],
+                        width1, height1, width2, height2);
+                exit(EXIT_FAILURE);
+        }
+
+        uint64_t blocks = (uint64_t)(width1 / 2) * (height1 / 2);
+        unsigned char *words1 = ALLOC(CHUNK_WORDS * 4);
+        unsigned char *words2 = ALLOC(CHUNK_WORDS * 4);
+        Sum sum = 0;
+        uint64_t changed = 0;
+        for (uint64_t done = 0; done < blocks; ) {
+                size_t count = blocks - done < CHUNK_WORDS ?
+                               (size_t)(blocks - done) : CHUNK_WORDS;
+                size_t got1 = fread(words1, 4, count, input1);
+                size_t got2 = fread(words2, 4, count, input2);
+                assert(got1 == count && got2 == count);
+                sum += compareChunk(words1, words2, count, &changed);
+                done += count;
+        }
+        FREE(words1);
+        FREE(words2);
+        if (input1 != stdin) {
+                fclose(input1);
+        }
+        if (input2 != stdin) {
+                fclose(input2);
+        }
+
+        /* the same arithmetic as Diff40_rmse, so the same result as ppmdiff */
+        double samples = 3.0 * width1 * height1;
+        double rmsd = samples == 0 ? 0 : sqrt((double)sum / samples) / 255;
+        fprintf(stdout, "Diff is: %.4f\n", rmsd);
+        fprintf(stdout, "Blocks differing: %llu of %llu\n",
+                (unsigned long long)changed, (unsigned long long)blocks);
+        return EXIT_SUCCESS;
+}
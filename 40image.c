@@ -5,7 +5,12 @@
  *
  * Compresses or decompresses an image provided by the user
  *
- * Usage: `./40image.c [-c|-d] [filename]`
+ * Usage: `./40image.c [-c|-d] [--rows A:B]
+ *                    [--methods plain|blocked|morton|mapped|auto]
+ *                    [--map-over MB] [--no-kernels]
+ *                    [--stats[=json]] [--counters] [--trace out.json]
+ *                    [--budget MB] [--pool MB] [--report-error] [filename]`
+ *        `./40image.c --study [filename]`
  *
  * Providing a filename is optional. If it is not provided, `40image.c` reads
  * from standard input instead.
@@ -16,6 +21,58 @@
  * If it does contain a valid image, when run with the flag `-c`, `40image.c`
  * will print the compressed image to `stdout`. When run with the flag `-d`, 
  * `40image.c` will print the decompressed image to `stdout`.
+ *
+ * When compressing, `--rows A:B` compresses only the pixel rows from A up to
+ * (but not including) B of a raw PPM, producing a shard that 40merge can join
+ * with the shards of the other rows. A must be even.
+ *
+ * `--methods blocked` holds every raster in a blocked UArray2b instead of the
+ * default plain UArray2 (`--methods plain`). `--methods auto` first times
+ * every stage on a sample of the image under each backend and map order and
+ * then uses the fastest; images under 16 megapixels are not worth the study
+ * and use the default. The output is the same every way; only the speed
+ * and memory use differ.
+ *
+ * `--methods morton` lays every raster out along a Z-order curve (see
+ * a2morton.h), which keeps both row and column neighbours close without a
+ * blocksize to choose.
+ *
+ * Plain and blocked rasters are processed by stage code specialized for
+ * them at compile time (see kernels40.h); `--no-kernels` maps through the
+ * A2Methods suite instead, as other backends do, to compare the two.
+ *
+ * `--methods mapped` holds every raster in a temporary file mapped into
+ * memory (see a2mapped.h), so images larger than memory can be processed
+ * without swapping; `--map-over MB` does the same but keeps rasters under MB
+ * megabytes in memory.
+ *
+ * `--study` times every stage of compressing and decompressing the given PPM
+ * under each backend and map order and prints the times and cache misses,
+ * without compressing anything.
+ *
+ * `--stats` prints the wall time, CPU time, throughput and output size of
+ * every stage, plus the peak memory use and the bytes each stage allocated,
+ * to `stderr` once the image has been processed; `--stats=json` prints the
+ * same as a JSON object. `--counters` adds hardware performance counters
+ * (IPC, cache, TLB and branch misses) for every stage to that report, where
+ * the system provides them.
+ *
+ * `--trace out.json` records every stage, band and I/O operation as Chrome
+ * trace events, tagged with the thread that ran it, and writes them to
+ * out.json on exit for viewing in chrome://tracing or ui.perfetto.dev.
+ *
+ * `--budget MB` stops the run with an uncaught Alloc40_Over_Budget exception
+ * as soon as the codec would have more than MB megabytes of arrays and
+ * buffers allocated at once.
+ *
+ * `--pool MB` lets each thread keep up to MB megabytes of freed rasters for
+ * reuse (see pool40.h), which pays off when the same sizes are allocated
+ * again, as in `--methods auto`.
+ *
+ * `--report-error`, when compressing, also prints to `stderr` the difference
+ * `ppmdiff` would find between the image and its decompression, in the same
+ * `Diff is: E` form, measured on each block as it is quantized, without
+ * decoding the output; with `--rows` it is that of the band.
  */
 
 /*******************************************************************************
@@ -27,19 +84,56 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
-#include <string.h>
+#include <stdbool.h>
 
 /* CS 40 */
 #include "assert.h"
 
 /* Student-written */
 #include "compress40.h"
+#include "trace40.h"
+#include "alloc40.h"
+#include "pool40.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "a2mapped.h"
+#include "a2morton.h"
+#include "kernels40.h"
 
 /*******************************************************************************
  * Functions
  ******************************************************************************/
 static void (*compress_or_decompress)(FILE *input) = compress40;
 
+/* The band of pixel rows given with `--rows`, if any */
+static bool rows_given = false;
+static unsigned rows_first = 0;
+static unsigned rows_last = 0;
+
+/* Whether to time every stage, and whether to report as JSON */
+static bool stats_given = false;
+static bool stats_json = false;
+static bool stats_counters = false;
+
+/* Whether to print the error of the compressed image; set with
+ * `--report-error` */
+static bool report_error = false;
+
+/* compress_rows
+ *
+ * Compresses the band of rows given on the command line with `--rows`.
+ *
+ * Parameters
+ *      FILE *input     a file pointer to a valid raw PPM image
+ *
+ * Returns
+ *      None (void)
+ */
+static void compress_rows(FILE *input)
+{
+        compress40_rows(input, rows_first, rows_last);
+}
+
 /* main
  *
  * Entry point for the 40image.c program; checks if the given command-line
@@ -69,14 +163,101 @@ int main(int argc, char *argv[])
                         compress_or_decompress = compress40;
                 } else if (strcmp(argv[i], "-d") == 0) {
                         compress_or_decompress = decompress40;
+                } else if (strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+                        char end;
+                        i++;
+                        if (sscanf(argv[i], "%u:%u%c", &rows_first, &rows_last,
+                                   &end) != 2 || rows_first >= rows_last ||
+                            (rows_first & 1)) {
+                                fprintf(stderr, "%s: bad row range '%s' "
+                                        "(expected A:B with A even, A < B)\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                        rows_given = true;
+                } else if (strcmp(argv[i], "--methods") == 0 && i + 1 < argc) {
+                        i++;
+                        if (strcmp(argv[i], "plain") == 0) {
+                                compress40_methods(uarray2_methods_plain);
+                        } else if (strcmp(argv[i], "blocked") == 0) {
+                                compress40_methods(uarray2_methods_blocked);
+                        } else if (strcmp(argv[i], "morton") == 0) {
+                                compress40_methods(uarray2_methods_morton);
+                        } else if (strcmp(argv[i], "mapped") == 0) {
+                                compress40_methods(uarray2_methods_mapped);
+                        } else if (strcmp(argv[i], "auto") == 0) {
+                                compress40_autotune(true);
+                        } else {
+                                fprintf(stderr, "%s: unknown methods '%s' "
+                                        "(expected plain, blocked, morton, "
+                                        "mapped or auto)\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                } else if (strcmp(argv[i], "--budget") == 0 && i + 1 < argc) {
+                        char *end;
+                        unsigned long long mb = strtoull(argv[++i], &end, 10);
+                        if (*end != '\0' || mb == 0) {
+                                fprintf(stderr, "%s: bad budget '%s' "
+                                        "(expected megabytes)\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                        Alloc40_budget(mb << 20);
+                } else if (strcmp(argv[i], "--map-over") == 0 &&
+                           i + 1 < argc) {
+                        char *end;
+                        unsigned long long mb = strtoull(argv[++i], &end, 10);
+                        if (*end != '\0') {
+                                fprintf(stderr, "%s: bad mapping threshold "
+                                        "'%s' (expected megabytes)\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                        A2Mapped_threshold(mb << 20);
+                        compress40_methods(uarray2_methods_mapped);
+                } else if (strcmp(argv[i], "--pool") == 0 && i + 1 < argc) {
+                        char *end;
+                        unsigned long long mb = strtoull(argv[++i], &end, 10);
+                        if (*end != '\0') {
+                                fprintf(stderr, "%s: bad pool size '%s' "
+                                        "(expected megabytes)\n",
+                                        argv[0], argv[i]);
+                                exit(1);
+                        }
+                        Pool40_limit(mb << 20);
+                } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+                        Trace40_start(argv[++i]);
+                } else if (strcmp(argv[i], "--no-kernels") == 0) {
+                        Kernels40_enable(false);
+                } else if (strcmp(argv[i], "--report-error") == 0) {
+                        report_error = true;
+                } else if (strcmp(argv[i], "--study") == 0) {
+                        compress_or_decompress = compress40_study;
+                } else if (strcmp(argv[i], "--stats") == 0) {
+                        stats_given = true;
+                } else if (strcmp(argv[i], "--stats=json") == 0) {
+                        stats_given = true;
+                        stats_json = true;
+                } else if (strcmp(argv[i], "--counters") == 0) {
+                        stats_given = true;
+                        stats_counters = true;
                 } else if (*argv[i] == '-') {
                         fprintf(stderr, "%s: unknown option '%s'\n",
                                 argv[0], argv[i]);
                         exit(1);
                 } else if (argc - i > 2) {
                         fprintf(stderr, "Usage: %s -d [filename]\n"
-                                "       %s -c [filename]\n",
-                                argv[0], argv[0]);
+                                "       %s -c [--rows A:B] [filename]\n"
+                                "       %s --study [filename]\n"
+                                "  (-c and -d may add --methods "
+                                "plain|blocked|morton|mapped|auto, "
+                                "--map-over MB, --no-kernels, "
+                                "--stats[=json], "
+                                "--counters, --trace out.json, "
+                                "--budget MB and --pool MB; -c may add "
+                                "--report-error)\n",
+                                argv[0], argv[0], argv[0]);
                         exit(1);
                 } else {
                         break;
@@ -84,6 +265,34 @@ int main(int argc, char *argv[])
         }
         assert(argc - i <= 1);    /* at most one file on command line */
 
+        if (rows_given) {
+                if (compress_or_decompress != compress40) {
+                        fprintf(stderr, "%s: --rows only applies to -c\n",
+                                argv[0]);
+                        exit(1);
+                }
+                compress_or_decompress = compress_rows;
+        }
+        if (report_error) {
+                if (compress_or_decompress == decompress40 ||
+                    compress_or_decompress == compress40_study) {
+                        fprintf(stderr, "%s: --report-error only applies to "
+                                "-c\n", argv[0]);
+                        exit(1);
+                }
+                compress40_report_error(true);
+        }
+
+        Stats40_T stats = NULL;
+        if (stats_given) {
+                stats = Stats40_new(compress_or_decompress == decompress40 ?
+                                    "decompress" : "compress");
+                if (stats_counters) {
+                        Stats40_count_hardware(stats);
+                }
+                compress40_stats(stats);
+        }
+
         /* Passes input to compress_or_decompress */
         if (i < argc) {
                 FILE *fp = fopen(argv[i], "r");
@@ -94,5 +303,9 @@ int main(int argc, char *argv[])
                 compress_or_decompress(stdin);
         }
 
+        Stats40_report(stats, stderr, stats_json);
+        Stats40_free(&stats);
+        Trace40_stop();
+
         return EXIT_SUCCESS; 
 }
@@ -0,0 +1,153 @@
+/*
+ * 40merge.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Joins compressed shards made by `40image -c --rows A:B` into a single
+ * compressed image
+ *
+ * Usage: `./40merge shard1 [shard2 ...]`
+ *
+ * The shards must be given top to bottom and together cover every row of the
+ * original image; every shard but the last must have an even height, so that
+ * the 2-by-2 blocks of the shards line up. Because codewords are stored
+ * row-major with no dependencies between blocks, joining the shards only
+ * requires checking that their widths agree, adding up their heights, and
+ * copying their codewords one after the other. The merged image is printed
+ * to `stdout` in format 2.
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+/* C standard library */
+#include <stdlib.h>
+#include <stdio.h>
+
+/* CS 40 */
+#include "assert.h"
+
+/* Student-written */
+#include "readwrite.h"
+
+/*******************************************************************************
+ * Functions
+ ******************************************************************************/
+
+/* openShard
+ *
+ * Opens a shard and reads its header.
+ *
+ * Parameters
+ *      char *name      the file name of the shard
+ *      unsigned *width set to the width of the shard, in pixels
+ *      unsigned *height
+ *                      set to the height of the shard, in pixels
+ *
+ * Returns
+ *      FILE *          the shard, positioned at its first codeword
+ *
+ * Notes
+ *      Prints a message to `stderr` and exits with code 1 (`EXIT_FAILURE`) if
+ *              the file could not be opened.
+ *      Will CRE if the shard does not start with a valid format 2 header.
+ */
+static FILE *openShard(char *name, unsigned *width, unsigned *height)
+{
+        FILE *fp = fopen(name, "rb");
+        if (fp == NULL) {
+                fprintf(stderr, "Error: file %s could not be opened.\n", name);
+                exit(EXIT_FAILURE);
+        }
+        readCompressedHeader(fp, width, height);
+        return fp;
+}
+
+/* copyCodeWords
+ *
+ * Copies the codewords of a shard to `stdout`.
+ *
+ * Parameters
+ *      FILE *shard     a shard positioned at its first codeword
+ *      size_t bytes    the number of codeword bytes in the shard
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Will CRE if the shard ends before all of its codewords are read.
+ */
+static void copyCodeWords(FILE *shard, size_t bytes)
+{
+        char buf[1 << 16];
+        while (bytes > 0) {
+                size_t chunk = bytes < sizeof(buf) ? bytes : sizeof(buf);
+                size_t got = fread(buf, 1, chunk, shard);
+                assert(got == chunk);
+                fwrite(buf, 1, chunk, stdout);
+                bytes -= chunk;
+        }
+}
+
+/* main
+ *
+ * Entry point for the 40merge program; reads the header of every shard to
+ * build the merged header, then copies the codewords of each shard in turn.
+ *
+ * Parameters
+ *      int argc        (number of command-line arguments, including the
+ *                      program name)
+ *      char **argv     (array of strings representing command-line arguments)
+ *
+ * Returns
+ *      int             0 (EXIT_SUCCESS) if the shards could be merged
+ *                      1 (EXIT_FAILURE) otherwise
+ *
+ * Notes
+ *      Will exit with 1 if the shards do not have the same width, or a
+ *              shard other than the last has an odd height, which would
+ *              misalign the 2-by-2 blocks of the shards after it.
+ *      Will CRE if a shard is not a valid compressed image.
+ */
+int main(int argc, char *argv[])
+{
+        if (argc < 2) {
+                fprintf(stderr, "Usage: %s shard1 [shard2 ...]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+
+        /* The merged height is the sum of the heights of all shards */
+        unsigned width = 0, height = 0;
+        for (int i = 1; i < argc; i++) {
+                unsigned shardWidth, shardHeight;
+                FILE *fp = openShard(argv[i], &shardWidth, &shardHeight);
+                fclose(fp);
+                if (i > 1 && shardWidth != width) {
+                        fprintf(stderr, "%s: %s is %u pixels wide, "
+                                "expected %u\n", argv[0], argv[i],
+                                shardWidth, width);
+                        exit(EXIT_FAILURE);
+                }
+                if (i < argc - 1 && shardHeight % 2 != 0) {
+                        fprintf(stderr, "%s: %s is %u pixels high; every "
+                                "shard but the last must have an even "
+                                "height\n", argv[0], argv[i], shardHeight);
+                        exit(EXIT_FAILURE);
+                }
+                width = shardWidth;
+                height += shardHeight;
+        }
+
+        fprintf(stdout, "COMP40 Compressed image format 2\n%u %u\n",
+                                                                width, height);
+        for (int i = 1; i < argc; i++) {
+                unsigned shardWidth, shardHeight;
+                FILE *fp = openShard(argv[i], &shardWidth, &shardHeight);
+                copyCodeWords(fp, (size_t)(shardWidth / 2) *
+                                  (shardHeight / 2) * sizeof(uint32_t));
+                fclose(fp);
+        }
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,530 @@
+/*
+ * a2compressed.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements the A2Methods interface for compressed images. The codewords are
+ * kept as they are stored in the file; the cache is a handful of tile-sized
+ * buffers, each stamped with when it was last used, and a table giving the
+ * buffer, if any, of every tile. A miss decodes the tile into the buffer used
+ * longest ago, with decodeBlock and toRGB, just as decompress40 decodes it.
+ * The tile `at` found last is checked before the table, so that runs of
+ * nearby accesses cost a compare and an add.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "assert.h"
+
+#include "a2compressed.h"
+#include "alloc40.h"
+#include "blockPack.h"
+#include "readwrite.h"
+
+#define TILE A2COMPRESSED_TILE
+
+/* struct slot
+ *
+ * Holds one decoded tile of the cache.
+ *
+ * Components
+ *      int tile                the tile it holds, counted row by row; -1 if
+ *                              none
+ *      uint64_t used           when it was last used; 0 if never
+ *      struct Pnm_rgb *pixels  the pixels of the tile, row by row, TILE to a
+ *                              row whatever the width of the tile
+ */
+struct slot {
+        int tile;
+        uint64_t used;
+        struct Pnm_rgb *pixels;
+};
+
+/* struct compressed
+ *
+ * Holds a compressed image and its cache.
+ *
+ * Components
+ *      int width, height       the size of the image, in pixels; both even
+ *      int blocksWide          the number of codewords in a row
+ *      unsigned char *words    the codewords, 4 bytes each, least significant
+ *                              first, row by row
+ *      int tilesWide, tilesHigh
+ *                              the number of tiles across and down
+ *      int *slotOf             the cache slot holding each tile; -1 if none
+ *      int slots               the number of slots in the cache
+ *      struct slot *cache      the slots
+ *      uint64_t clock          the count of tile lookups, to stamp slots with
+ *      int lastTile            the tile found last; -1 if none
+ *      struct Pnm_rgb *lastPixels
+ *                              its pixels
+ */
+struct compressed {
+        int width, height;
+        int blocksWide;
+        unsigned char *words;
+        int tilesWide, tilesHigh;
+        int *slotOf;
+        int slots;
+        struct slot *cache;
+        uint64_t clock;
+        int lastTile;
+        struct Pnm_rgb *lastPixels;
+};
+
+/* A2Compressed_read
+ *
+ * Read a compressed image into an array of the pixels it decompresses to.
+ *
+ * Parameters
+ *      FILE *input             a file positioned at the start of a compressed
+ *                              image
+ *      int cacheTiles          the most tiles to keep decoded at once; 0 for
+ *                              a row of tiles, so that row-major maps decode
+ *                              every tile once
+ *
+ * Returns
+ *      A2Methods_UArray2       the array, for use with
+ *                              uarray2_methods_compressed
+ *
+ * Notes
+ *      Will CRE if input is NULL or cacheTiles is negative.
+ *      Will CRE if the image is not a valid compressed image, or ends early.
+ *      Allocates memory, counted by alloc40; free it with the suite's `free`.
+ */
+extern A2 A2Compressed_read(FILE *input, int cacheTiles)
+{
+        assert(input != NULL);
+        assert(cacheTiles >= 0);
+        unsigned width, height;
+        readCompressedHeader(input, &width, &height);
+
+        struct compressed *image = Alloc40_malloc(sizeof(*image));
+        image->width = width;
+        image->height = height;
+        image->blocksWide = width / 2;
+        size_t words = (size_t)(width / 2) * (height / 2);
+        image->words = Alloc40_malloc(words * 4);
+        size_t got = fread(image->words, 4, words, input);
+        assert(got == words);
+
+        image->tilesWide = (width + TILE - 1) / TILE;
+        image->tilesHigh = (height + TILE - 1) / TILE;
+        size_t tiles = (size_t)image->tilesWide * image->tilesHigh;
+        image->slotOf = Alloc40_malloc((tiles + 1) * sizeof(int));
+        for (size_t tile = 0; tile < tiles; tile++) {
+                image->slotOf[tile] = -1;
+        }
+
+        image->slots = cacheTiles > 0 ? cacheTiles : image->tilesWide;
+        if (image->slots < 1) {
+                image->slots = 1;
+        }
+        image->cache = Alloc40_malloc(image->slots * sizeof(struct slot));
+        for (int i = 0; i < image->slots; i++) {
+                image->cache[i] = (struct slot){ -1, 0, NULL };
+                image->cache[i].pixels = Alloc40_malloc(TILE * TILE *
+                                                sizeof(struct Pnm_rgb));
+        }
+        image->clock = 0;
+        image->lastTile = -1;
+        image->lastPixels = NULL;
+        return image;
+}
+
+/* decodeTile
+ *
+ * Decode the codewords of one tile into its pixels.
+ *
+ * Parameters
+ *      struct compressed *image
+ *                              the image
+ *      int tile                the tile, counted row by row
+ *      struct Pnm_rgb *pixels  where to put its pixels, TILE to a row
+ *
+ * Returns
+ *      (Nothing.)
+ */
+static void decodeTile(struct compressed *image, int tile,
+                       struct Pnm_rgb *pixels)
+{
+        int left = tile % image->tilesWide * TILE;
+        int top = tile / image->tilesWide * TILE;
+        int right = image->width - left < TILE ? image->width : left + TILE;
+        int bottom = image->height - top < TILE ? image->height : top + TILE;
+
+        for (int row = top / 2; row < bottom / 2; row++) {
+                const unsigned char *word = image->words +
+                        ((size_t)row * image->blocksWide + left / 2) * 4;
+                struct Pnm_rgb *upper = pixels + (row * 2 - top) * TILE;
+                struct Pnm_rgb *lower = upper + TILE;
+                for (int col = 0; col < (right - left) / 2; col++, word += 4) {
+                        uint32_t codeWord = (uint32_t)word[0] |
+                                            (uint32_t)word[1] << 8 |
+                                            (uint32_t)word[2] << 16 |
+                                            (uint32_t)word[3] << 24;
+                        struct vidComp block[4];
+                        decodeBlock(codeWord, block);
+                        upper[2 * col] = toRGB(block[0], 255);
+                        upper[2 * col + 1] = toRGB(block[1], 255);
+                        lower[2 * col] = toRGB(block[2], 255);
+                        lower[2 * col + 1] = toRGB(block[3], 255);
+                }
+        }
+}
+
+/* tilePixels
+ *
+ * Get the pixels of a tile, decoding it into the cache if it is not there.
+ *
+ * Parameters
+ *      struct compressed *image
+ *                              the image
+ *      int tile                the tile, counted row by row
+ *
+ * Returns
+ *      struct Pnm_rgb *        its pixels, TILE to a row; good until another
+ *                              tile is decoded into the same slot
+ */
+static struct Pnm_rgb *tilePixels(struct compressed *image, int tile)
+{
+        if (tile == image->lastTile) {
+                return image->lastPixels;
+        }
+
+        int slot = image->slotOf[tile];
+        if (slot < 0) {
+                slot = 0;
+                for (int i = 1; i < image->slots; i++) {
+                        if (image->cache[i].used < image->cache[slot].used) {
+                                slot = i;
+                        }
+                }
+                struct slot *victim = &image->cache[slot];
+                if (victim->tile >= 0) {
+                        image->slotOf[victim->tile] = -1;
+                }
+                decodeTile(image, tile, victim->pixels);
+                victim->tile = tile;
+                image->slotOf[tile] = slot;
+        }
+
+        image->cache[slot].used = ++image->clock;
+        image->lastTile = tile;
+        image->lastPixels = image->cache[slot].pixels;
+        return image->lastPixels;
+}
+
+/* new
+ *
+ * Not supported: a compressed array can only be read, with
+ * A2Compressed_read.
+ *
+ * Notes
+ *      Always a CRE.
+ */
+static A2 new(int width, int height, int size)
+{
+        (void)width;
+        (void)height;
+        (void)size;
+        assert(0);
+        return NULL;
+}
+
+/* new_with_blocksize
+ *
+ * Not supported, as `new`.
+ *
+ * Notes
+ *      Always a CRE.
+ */
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        (void)blocksize;
+        return new(width, height, size);
+}
+
+/* a2free
+ *
+ * Deallocate and clear the given pointer to an array.
+ *
+ * Parameters
+ *      A2 *array2p     the address of the pointer to the array to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `array2p` or `*array2p` is NULL.
+ *      Sets `*array2p` to NULL.
+ */
+static void a2free(A2 *array2p)
+{
+        assert(array2p != NULL && *array2p != NULL);
+        struct compressed *image = *array2p;
+        for (int i = 0; i < image->slots; i++) {
+                Alloc40_free(image->cache[i].pixels);
+        }
+        Alloc40_free(image->cache);
+        Alloc40_free(image->slotOf);
+        Alloc40_free(image->words);
+        Alloc40_free(image);
+        *array2p = NULL;
+}
+
+/* width
+ *
+ * Get the width of an array, in pixels.
+ */
+static int width(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((struct compressed *)array2)->width;
+}
+
+/* height
+ *
+ * Get the height of an array, in pixels.
+ */
+static int height(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((struct compressed *)array2)->height;
+}
+
+/* size
+ *
+ * Get the size of an element of an array: that of a struct Pnm_rgb.
+ */
+static int size(A2 array2)
+{
+        assert(array2 != NULL);
+        return sizeof(struct Pnm_rgb);
+}
+
+/* blocksize
+ *
+ * Get the blocksize of an array: the side of a tile.
+ */
+static int blocksize(A2 array2)
+{
+        assert(array2 != NULL);
+        return TILE;
+}
+
+/* at
+ *
+ * Get a pointer to the pixel at the given position of an array.
+ *
+ * Parameters
+ *      A2 uarray2      a compressed array
+ *      int col         the column (x-position) of the desired pixel
+ *      int row         the row (y-position) of the desired pixel
+ *
+ * Returns
+ *      A2Methods_Object *
+ *                      a pointer to the decoded pixel; good until the next
+ *                      call on the array
+ *
+ * Notes
+ *      Will CRE if `array2` is NULL.
+ *      Will CRE if `col` is not between 0 and one less than the array's width.
+ *      Will CRE if `row` is not between 0 and one less than the array's height.
+ *      Decodes the tile of the pixel if it is not in the cache.
+ */
+static A2Methods_Object *at(A2 array2, int col, int row)
+{
+        assert(array2 != NULL);
+        struct compressed *image = array2;
+        assert(col >= 0 && col < image->width);
+        assert(row >= 0 && row < image->height);
+        int tile = row / TILE * image->tilesWide + col / TILE;
+        return tilePixels(image, tile) + row % TILE * TILE + col % TILE;
+}
+
+/* map_block_major
+ *
+ * Call the given function for all pixels of the array, tile by tile and
+ * row-major within each tile, decoding each tile once.
+ *
+ * Parameters
+ *      A2 uarray2      a compressed array
+ *      A2Methods_applyfun apply
+ *                      a function to apply to each pixel of the array
+ *      void *cl        an arbitrary address provided by the client
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` or `apply` are NULL.
+ *      `apply` must not call `at` on the same array.
+ */
+static void map_block_major(A2 uarray2, A2Methods_applyfun apply, void *cl)
+{
+        assert(uarray2 != NULL && apply != NULL);
+        struct compressed *image = uarray2;
+        for (int tile = 0; tile < image->tilesWide * image->tilesHigh;
+             tile++) {
+                struct Pnm_rgb *pixels = tilePixels(image, tile);
+                int left = tile % image->tilesWide * TILE;
+                int top = tile / image->tilesWide * TILE;
+                int right = image->width - left < TILE ? image->width
+                                                       : left + TILE;
+                int bottom = image->height - top < TILE ? image->height
+                                                        : top + TILE;
+                for (int row = top; row < bottom; row++) {
+                        for (int col = left; col < right; col++) {
+                                apply(col, row, uarray2,
+                                      &pixels[(row - top) * TILE + col - left],
+                                      cl);
+                        }
+                }
+        }
+}
+
+/* map_row_major
+ *
+ * Call the given function for all pixels of the array, in row-major order.
+ *
+ * Parameters
+ *      A2 uarray2      a compressed array
+ *      A2Methods_applyfun apply
+ *                      a function to apply to each pixel of the array
+ *      void *cl        an arbitrary address provided by the client
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` or `apply` are NULL.
+ *      `apply` must not call `at` on the same array.
+ *      Decodes every tile once if the cache holds a row of tiles, and
+ *      TILE times otherwise.
+ */
+static void map_row_major(A2 uarray2, A2Methods_applyfun apply, void *cl)
+{
+        assert(uarray2 != NULL && apply != NULL);
+        struct compressed *image = uarray2;
+        for (int row = 0; row < image->height; row++) {
+                int first = row / TILE * image->tilesWide;
+                for (int col = 0; col < image->width; ) {
+                        struct Pnm_rgb *pixels =
+                                tilePixels(image, first + col / TILE) +
+                                row % TILE * TILE;
+                        int end = image->width - col < TILE ? image->width
+                                                            : col + TILE;
+                        for (; col < end; col++) {
+                                apply(col, row, uarray2, &pixels[col % TILE],
+                                      cl);
+                        }
+                }
+        }
+}
+
+/* map_col_major
+ *
+ * Call the given function for all pixels of the array, in column-major
+ * order.
+ *
+ * Parameters
+ *      A2 uarray2      a compressed array
+ *      A2Methods_applyfun apply
+ *                      a function to apply to each pixel of the array
+ *      void *cl        an arbitrary address provided by the client
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` or `apply` are NULL.
+ *      `apply` must not call `at` on the same array.
+ *      Decodes every tile once if the cache holds a column of tiles, and
+ *      TILE times otherwise.
+ */
+static void map_col_major(A2 uarray2, A2Methods_applyfun apply, void *cl)
+{
+        assert(uarray2 != NULL && apply != NULL);
+        struct compressed *image = uarray2;
+        for (int col = 0; col < image->width; col++) {
+                for (int row = 0; row < image->height; ) {
+                        struct Pnm_rgb *pixels =
+                                tilePixels(image, row / TILE *
+                                           image->tilesWide + col / TILE) +
+                                col % TILE;
+                        int end = image->height - row < TILE ? image->height
+                                                              : row + TILE;
+                        for (; row < end; row++) {
+                                apply(col, row, uarray2,
+                                      &pixels[row % TILE * TILE], cl);
+                        }
+                }
+        }
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void                    *cl;
+};
+
+static void apply_small(int i, int j, A2 uarray2, void *elem, void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)uarray2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_row_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_row_major(a2, apply_small, &mycl);
+}
+
+static void small_map_col_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_col_major(a2, apply_small, &mycl);
+}
+
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_block_major(a2, apply_small, &mycl);
+}
+
+/* uarray2_methods_compressed_struct
+ *
+ * An implementation of the A2Methods interface for compressed images.
+ */
+static struct A2Methods_T uarray2_methods_compressed_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+
+        width,
+        height,
+        size,
+        blocksize,
+
+        at,
+
+        map_row_major,
+        map_col_major,
+        map_block_major,
+        map_block_major,                /* map_default */
+
+        small_map_row_major,
+        small_map_col_major,
+        small_map_block_major,
+        small_map_block_major           /* small_map_default */
+};
+
+/* The exported struct */
+A2Methods_T uarray2_methods_compressed = &uarray2_methods_compressed_struct;
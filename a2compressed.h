@@ -0,0 +1,58 @@
+/*
+ * a2compressed.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Defines a third A2Methods backend, next to uarray2_methods_plain and
+ * uarray2_methods_blocked, whose storage is the codewords of a compressed
+ * image. Its elements are the struct Pnm_rgb pixels, at maxval 255, that
+ * decompress40 would give; a pixel is decoded only when it is asked for, 64
+ * by 64 pixels (a tile) at a time, into a small cache of the tiles used
+ * last. An image so held takes 4 bytes for every 4 pixels, a twelfth of a
+ * plain raster of Pnm_rgb, plus the cache.
+ *
+ * The arrays are read-only: `new` and `new_with_blocksize` are checked
+ * runtime errors, and a pixel written through `at` is lost when its tile
+ * leaves the cache. A pointer from `at` stays good until the next call on
+ * the same array. The cache belongs to the array, so an array must be used
+ * by one thread at a time.
+ *
+ * `map_block_major` (the default) decodes every tile once; `map_row_major`
+ * does so too when the cache holds a row of tiles, and `map_col_major` when
+ * it holds a column.
+ */
+
+#ifndef A2COMPRESSED_INCLUDED
+#define A2COMPRESSED_INCLUDED
+
+#include <stdio.h>
+#include "a2methods.h"
+
+/* The side of a tile, in pixels */
+#define A2COMPRESSED_TILE 64
+
+extern A2Methods_T uarray2_methods_compressed;
+
+/* A2Compressed_read
+ *
+ * Read a compressed image into an array of the pixels it decompresses to.
+ *
+ * Parameters
+ *      FILE *input             a file positioned at the start of a compressed
+ *                              image
+ *      int cacheTiles          the most tiles to keep decoded at once; 0 for
+ *                              a row of tiles, so that row-major maps decode
+ *                              every tile once
+ *
+ * Returns
+ *      A2Methods_UArray2       the array, for use with
+ *                              uarray2_methods_compressed
+ *
+ * Notes
+ *      Will CRE if input is NULL or cacheTiles is negative.
+ *      Will CRE if the image is not a valid compressed image, or ends early.
+ *      Allocates memory, counted by alloc40; free it with the suite's `free`.
+ */
+extern A2Methods_UArray2 A2Compressed_read(FILE *input, int cacheTiles);
+
+#endif
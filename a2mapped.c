@@ -0,0 +1,509 @@
+/*
+ * a2mapped.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements the A2Methods interface for file-backed arrays. An array is one
+ * mapping, shared with its temporary file (or private and anonymous, below
+ * the threshold), of whole tiles: the tile of (col, row) is
+ * row / TILE * tilesWide + col / TILE, and the element is at
+ * (row % TILE) * TILE + col % TILE within it. A tile of any element size is a
+ * multiple of 4096 bytes, so the tiles of a row of tiles are a run of whole
+ * pages that madvise can be given directly. Pages are only ever given back
+ * (MADV_DONTNEED) when a file holds them, since anonymous pages would lose
+ * their contents.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "assert.h"
+
+#include "a2mapped.h"
+#include "alloc40.h"
+
+typedef A2Methods_UArray2 A2;
+
+#define TILE A2MAPPED_TILE
+
+/* struct mapped
+ *
+ * Holds a file-backed array.
+ *
+ * Components
+ *      int width, height       the size of the array, in elements
+ *      int size                the size of an element, in bytes
+ *      int tilesWide, tilesHigh
+ *                              the number of tiles across and down
+ *      size_t tileBytes        the bytes of a tile
+ *      char *base              the mapping; NULL if the array is empty
+ *      size_t bytes            the length of the mapping
+ *      int fd                  the file behind the mapping; -1 if it is
+ *                              anonymous
+ *      int tag                 the alloc40 tag the array was counted under
+ */
+struct mapped {
+        int width, height;
+        int size;
+        int tilesWide, tilesHigh;
+        size_t tileBytes;
+        char *base;
+        size_t bytes;
+        int fd;
+        int tag;
+};
+
+static size_t threshold = 0;
+
+/* A2Mapped_threshold
+ *
+ * Set the smallest array that is backed by a file.
+ *
+ * Parameters
+ *      size_t bytes            arrays of at least this many bytes are mapped
+ *                              from a file, smaller ones from memory; 0, the
+ *                              default, maps every array from a file
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Only arrays created afterwards are affected. Arrays in memory are
+ *      counted by alloc40; those in files are not.
+ */
+extern void A2Mapped_threshold(size_t bytes)
+{
+        threshold = bytes;
+}
+
+/* openTemporary
+ *
+ * Create a temporary file of the given length, already removed.
+ *
+ * Parameters
+ *      size_t bytes            the length of the file
+ *
+ * Returns
+ *      int                     the open file
+ *
+ * Notes
+ *      Will CRE if the file cannot be created or extended.
+ */
+static int openTemporary(size_t bytes)
+{
+        const char *dir = getenv("TMPDIR");
+        char name[4096];
+        int len = snprintf(name, sizeof(name), "%s/a2mapped-XXXXXX",
+                           dir != NULL && *dir != '\0' ? dir : "/tmp");
+        assert(len > 0 && (size_t)len < sizeof(name));
+        int fd = mkstemp(name);
+        assert(fd >= 0);
+        unlink(name);
+        int failed = ftruncate(fd, bytes);
+        assert(!failed);
+        return fd;
+}
+
+/* new
+ *
+ * Allocate, initialize, and return a new file-backed 2D array.
+ *
+ * Parameters
+ *      int width       the width (number of columns) of the array
+ *      int height      the height (number of rows) of the array
+ *      int size        the size of each element, in bytes; must include padding
+ *                      necessary for alignment
+ *
+ * Returns
+ *      A2              the created array
+ *
+ * Notes
+ *      Will CRE if width and/or height are negative.
+ *      Will CRE if size is not positive.
+ *      Will CRE if the file or mapping cannot be made, or its size overflows.
+ *      Raises Alloc40_Over_Budget if an array kept in memory would go over
+ *      the memory budget.
+ *      All elements are initialized to zero.
+ */
+static A2 new(int width, int height, int size)
+{
+        assert(width >= 0 && height >= 0);
+        assert(size > 0);
+        struct mapped header;
+        header.width = width;
+        header.height = height;
+        header.size = size;
+        header.tilesWide = (width + TILE - 1) / TILE;
+        header.tilesHigh = (height + TILE - 1) / TILE;
+        header.tileBytes = (size_t)TILE * TILE * size;
+        bool overflow = __builtin_mul_overflow(header.tileBytes,
+                                               (size_t)header.tilesWide *
+                                               header.tilesHigh,
+                                               &header.bytes);
+        assert(!overflow);
+        header.base = NULL;
+        header.fd = -1;
+
+        /* the header and a mapping kept in memory are counted at once,
+           before either is made, so that going over the budget leaks
+           neither */
+        bool inMemory = header.bytes < threshold;
+        header.tag = Alloc40_count(sizeof(header) +
+                                   (inMemory ? header.bytes : 0));
+        struct mapped *array = malloc(sizeof(*array));
+        assert(array != NULL);
+        *array = header;
+        if (array->bytes == 0) {
+                return array;
+        }
+
+        void *base;
+        if (inMemory) {
+                base = mmap(NULL, array->bytes, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        } else {
+                array->fd = openTemporary(array->bytes);
+                base = mmap(NULL, array->bytes, PROT_READ | PROT_WRITE,
+                            MAP_SHARED, array->fd, 0);
+        }
+        assert(base != MAP_FAILED);
+        array->base = base;
+        return array;
+}
+
+/* new_with_blocksize
+ *
+ * Allocate, initialize, and return a new file-backed 2D array. The tiles are
+ * always A2MAPPED_TILE elements on a side, so this is equivalent to `new()`.
+ */
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        (void)blocksize;
+        return new(width, height, size);
+}
+
+/* a2free
+ *
+ * Deallocate and clear the given pointer to an array, removing its file.
+ *
+ * Parameters
+ *      A2 *array2p     the address of the pointer to the array to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `array2p` or `*array2p` is NULL.
+ *      Sets `*array2p` to NULL.
+ */
+static void a2free(A2 *array2p)
+{
+        assert(array2p != NULL && *array2p != NULL);
+        struct mapped *array = *array2p;
+        if (array->base != NULL) {
+                munmap(array->base, array->bytes);
+        }
+        if (array->fd >= 0) {
+                close(array->fd);
+        }
+        Alloc40_uncount(array->tag, sizeof(*array) +
+                                    (array->fd < 0 ? array->bytes : 0));
+        free(array);
+        *array2p = NULL;
+}
+
+/* width
+ *
+ * Get the width of an array.
+ */
+static int width(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((struct mapped *)array2)->width;
+}
+
+/* height
+ *
+ * Get the height of an array.
+ */
+static int height(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((struct mapped *)array2)->height;
+}
+
+/* size
+ *
+ * Get the size of an element of an array.
+ */
+static int size(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((struct mapped *)array2)->size;
+}
+
+/* blocksize
+ *
+ * Get the blocksize of an array: the side of a tile.
+ */
+static int blocksize(A2 array2)
+{
+        assert(array2 != NULL);
+        return TILE;
+}
+
+/* element
+ *
+ * Get the address of an element, which must be in the array.
+ */
+static inline char *element(struct mapped *array, int col, int row)
+{
+        size_t tile = (size_t)(row / TILE) * array->tilesWide + col / TILE;
+        return array->base + tile * array->tileBytes +
+               (size_t)((row % TILE) * TILE + col % TILE) * array->size;
+}
+
+/* at
+ *
+ * Get a pointer to the element at the given position for a given array.
+ *
+ * Parameters
+ *      A2 uarray2      a 2D array
+ *      int col         the column (x-position) of the desired element
+ *      int row         the row (y-position) of the desired element
+ *
+ * Returns
+ *      A2Methods_Object *
+ *                      a pointer to the given position in the array
+ *
+ * Notes
+ *      Will CRE if `array2` is NULL.
+ *      Will CRE if `col` is not between 0 and one less than the array's width.
+ *      Will CRE if `row` is not between 0 and one less than the array's height.
+ */
+static A2Methods_Object *at(A2 array2, int col, int row)
+{
+        assert(array2 != NULL);
+        struct mapped *array = array2;
+        assert(col >= 0 && col < array->width);
+        assert(row >= 0 && row < array->height);
+        return element(array, col, row);
+}
+
+/* advise
+ *
+ * Give the kernel advice about a run of whole rows of tiles.
+ *
+ * Parameters
+ *      struct mapped *array    the array
+ *      int first               the first row of tiles
+ *      int count               the number of rows of tiles; clipped to the
+ *                              array
+ *      int advice              the advice, as for madvise
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      MADV_DONTNEED is ignored unless a file holds the array.
+ *      The advice is only a hint, so failures are ignored.
+ */
+static void advise(struct mapped *array, int first, int count, int advice)
+{
+        if (array->base == NULL || first >= array->tilesHigh ||
+            (advice == MADV_DONTNEED && array->fd < 0)) {
+                return;
+        }
+        if (count > array->tilesHigh - first) {
+                count = array->tilesHigh - first;
+        }
+        size_t rowBytes = array->tileBytes * array->tilesWide;
+        madvise(array->base + rowBytes * first, rowBytes * count, advice);
+}
+
+/* map_block_major
+ *
+ * Call the given function for all elements of the array, tile by tile and
+ * row-major within each tile, which is the order they are in memory.
+ *
+ * Parameters
+ *      A2 uarray2      a 2D array
+ *      A2Methods_applyfun apply
+ *                      a function to apply to each element of the array
+ *      void *cl        an arbitrary address provided by the client
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` or `apply` are NULL.
+ *      May raise exceptions if `apply` raises exceptions.
+ *      Gives back the pages of a file-backed row of tiles once it is done.
+ */
+static void map_block_major(A2 uarray2, A2Methods_applyfun apply, void *cl)
+{
+        assert(uarray2 != NULL && apply != NULL);
+        struct mapped *array = uarray2;
+        advise(array, 0, array->tilesHigh, MADV_SEQUENTIAL);
+        for (int tileRow = 0; tileRow < array->tilesHigh; tileRow++) {
+                int top = tileRow * TILE;
+                int bottom = array->height - top < TILE ? array->height
+                                                        : top + TILE;
+                for (int tileCol = 0; tileCol < array->tilesWide; tileCol++) {
+                        int left = tileCol * TILE;
+                        int right = array->width - left < TILE ? array->width
+                                                               : left + TILE;
+                        for (int row = top; row < bottom; row++) {
+                                for (int col = left; col < right; col++) {
+                                        apply(col, row, uarray2,
+                                              element(array, col, row), cl);
+                                }
+                        }
+                }
+                advise(array, tileRow, 1, MADV_DONTNEED);
+        }
+        advise(array, 0, array->tilesHigh, MADV_NORMAL);
+}
+
+/* map_row_major
+ *
+ * Call the given function for all elements of the array, iterating in
+ * row-major order.
+ *
+ * Parameters
+ *      A2 uarray2      a 2D array
+ *      A2Methods_applyfun apply
+ *                      a function to apply to each element of the array
+ *      void *cl        an arbitrary address provided by the client
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` or `apply` are NULL.
+ *      May raise exceptions if `apply` raises exceptions.
+ *      Asks for each row of tiles to be read in while the one before it is
+ *      walked, and gives back the pages of a file-backed row of tiles once
+ *      it is done; they are read back from the file if used again.
+ */
+static void map_row_major(A2 uarray2, A2Methods_applyfun apply, void *cl)
+{
+        assert(uarray2 != NULL && apply != NULL);
+        struct mapped *array = uarray2;
+        advise(array, 0, 1, MADV_WILLNEED);
+        for (int tileRow = 0; tileRow < array->tilesHigh; tileRow++) {
+                advise(array, tileRow + 1, 1, MADV_WILLNEED);
+                int top = tileRow * TILE;
+                int bottom = array->height - top < TILE ? array->height
+                                                        : top + TILE;
+                for (int row = top; row < bottom; row++) {
+                        for (int col = 0; col < array->width; col++) {
+                                apply(col, row, uarray2,
+                                      element(array, col, row), cl);
+                        }
+                }
+                advise(array, tileRow, 1, MADV_DONTNEED);
+        }
+}
+
+/* map_col_major
+ *
+ * Call the given function for all elements of the array, iterating in
+ * column-major order.
+ *
+ * Parameters
+ *      A2 uarray2      a 2D array
+ *      A2Methods_applyfun apply
+ *                      a function to apply to each element of the array
+ *      void *cl        an arbitrary address provided by the client
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` or `apply` are NULL.
+ *      May raise exceptions if `apply` raises exceptions.
+ *      A column of tiles is spread over the whole mapping, so read-ahead is
+ *      turned off while it runs.
+ */
+static void map_col_major(A2 uarray2, A2Methods_applyfun apply, void *cl)
+{
+        assert(uarray2 != NULL && apply != NULL);
+        struct mapped *array = uarray2;
+        advise(array, 0, array->tilesHigh, MADV_RANDOM);
+        for (int col = 0; col < array->width; col++) {
+                for (int row = 0; row < array->height; row++) {
+                        apply(col, row, uarray2, element(array, col, row), cl);
+                }
+        }
+        advise(array, 0, array->tilesHigh, MADV_NORMAL);
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void                    *cl;
+};
+
+static void apply_small(int i, int j, A2 uarray2, void *elem, void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)uarray2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_row_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_row_major(a2, apply_small, &mycl);
+}
+
+static void small_map_col_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_col_major(a2, apply_small, &mycl);
+}
+
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_block_major(a2, apply_small, &mycl);
+}
+
+/* uarray2_methods_mapped_struct
+ *
+ * An implementation of the A2Methods interface for file-backed 2D arrays.
+ */
+static struct A2Methods_T uarray2_methods_mapped_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+
+        width,
+        height,
+        size,
+        blocksize,
+
+        at,
+
+        map_row_major,
+        map_col_major,
+        map_block_major,
+        map_block_major,                /* map_default */
+
+        small_map_row_major,
+        small_map_col_major,
+        small_map_block_major,
+        small_map_block_major           /* small_map_default */
+};
+
+/* The exported struct */
+A2Methods_T uarray2_methods_mapped = &uarray2_methods_mapped_struct;
@@ -0,0 +1,54 @@
+/*
+ * a2mapped.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Defines an A2Methods backend for rasters larger than memory. Its arrays
+ * live in a memory-mapped temporary file, so the kernel pages them in and
+ * out as they are used instead of the process running out of memory or
+ * swapping. The elements are stored 64 by 64 to a tile, tile after tile, so
+ * that a tile is a whole number of pages and both row and column neighbours
+ * are usually on the same one.
+ *
+ * Every map tells the kernel how it will walk the array: sequentially for
+ * `map_block_major` (the default, which walks memory in order), a row of
+ * tiles ahead for `map_row_major`, and at random for `map_col_major`. The
+ * first two also give back the pages of each row of tiles they are done
+ * with, which the kernel reads back from the file if they are used again.
+ *
+ * The files are made in $TMPDIR, or /tmp, and removed as soon as they are
+ * open, so nothing is left behind however the program ends. Arrays smaller
+ * than a threshold, set with A2Mapped_threshold, are kept in ordinary memory
+ * instead, in the same layout.
+ */
+
+#ifndef A2MAPPED_INCLUDED
+#define A2MAPPED_INCLUDED
+
+#include <stddef.h>
+#include "a2methods.h"
+
+/* The side of a tile, in elements */
+#define A2MAPPED_TILE 64
+
+extern A2Methods_T uarray2_methods_mapped;
+
+/* A2Mapped_threshold
+ *
+ * Set the smallest array that is backed by a file.
+ *
+ * Parameters
+ *      size_t bytes            arrays of at least this many bytes are mapped
+ *                              from a file, smaller ones from memory; 0, the
+ *                              default, maps every array from a file
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Only arrays created afterwards are affected. Arrays in memory are
+ *      counted by alloc40; those in files are not.
+ */
+extern void A2Mapped_threshold(size_t bytes);
+
+#endif
@@ -0,0 +1,512 @@
+/*
+ * a2morton.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements the A2Methods interface for Z-order arrays. The shorter side of
+ * an array is rounded up to a power of two, SIDE = 2^shift, and the array is
+ * stored as a line of SIDE-by-SIDE squares along its longer side. Within a
+ * square, an element's index has the low `shift` bits of its column in the
+ * even bit places and those of its row in the odd ones; the rest of the
+ * column (or row) counts squares. As the short side is at most SIDE, that is
+ *
+ *      spread(col & mask) | spread(row & mask) << 1
+ *              | ((col | row) >> shift) << 2 * shift
+ *
+ * spread is one PDEP instruction where the compiler may use BMI2 (build
+ * with -mbmi2 or -march=native) and five shift-and-mask steps otherwise.
+ *
+ * The padding is never read or written. The array is one anonymous mapping,
+ * which the kernel only gives memory a page at a time as it is first written,
+ * so padding pages no element shares take no memory. Only the elements and
+ * the header are counted by alloc40.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+#include "assert.h"
+
+#include "a2morton.h"
+#include "alloc40.h"
+
+typedef A2Methods_UArray2 A2;
+
+/* struct morton
+ *
+ * Holds a Z-order array.
+ *
+ * Components
+ *      int width, height       the size of the array, in elements
+ *      int size                the size of an element, in bytes
+ *      int shift               log2 of the side of a square
+ *      unsigned mask           the side of a square, less one
+ *      int squares             the number of squares
+ *      char *base              the mapping; NULL if the array is empty
+ *      size_t bytes            the length of the mapping
+ *      int tag                 the alloc40 tag the array was counted under
+ */
+struct morton {
+        int width, height;
+        int size;
+        int shift;
+        unsigned mask;
+        int squares;
+        char *base;
+        size_t bytes;
+        int tag;
+};
+
+/* spread
+ *
+ * Move bit i of a number to bit 2i.
+ */
+static inline uint64_t spread(uint32_t bits)
+{
+#if defined(__BMI2__)
+        return _pdep_u64(bits, 0x5555555555555555);
+#else
+        uint64_t x = bits;
+        x = (x | x << 16) & 0x0000ffff0000ffff;
+        x = (x | x << 8) & 0x00ff00ff00ff00ff;
+        x = (x | x << 4) & 0x0f0f0f0f0f0f0f0f;
+        x = (x | x << 2) & 0x3333333333333333;
+        x = (x | x << 1) & 0x5555555555555555;
+        return x;
+#endif
+}
+
+/* compact
+ *
+ * Move bit 2i of a number to bit i, dropping the odd bits; undoes spread.
+ */
+static inline uint32_t compact(uint64_t bits)
+{
+#if defined(__BMI2__)
+        return _pext_u64(bits, 0x5555555555555555);
+#else
+        uint64_t x = bits & 0x5555555555555555;
+        x = (x | x >> 1) & 0x3333333333333333;
+        x = (x | x >> 2) & 0x0f0f0f0f0f0f0f0f;
+        x = (x | x >> 4) & 0x00ff00ff00ff00ff;
+        x = (x | x >> 8) & 0x0000ffff0000ffff;
+        x = (x | x >> 16) & 0x00000000ffffffff;
+        return x;
+#endif
+}
+
+/* countedBytes
+ *
+ * Get the bytes of an array that alloc40 counts.
+ *
+ * Parameters
+ *      const struct morton *array
+ *                      the array, whose size and bytes are set
+ *
+ * Returns
+ *      size_t          the size of its header and, if it has a mapping, of
+ *                      its elements
+ */
+static size_t countedBytes(const struct morton *array)
+{
+        size_t elements = (size_t)array->width * array->height * array->size;
+        return sizeof(*array) + (array->bytes > 0 ? elements : 0);
+}
+
+/* new
+ *
+ * Allocate, initialize, and return a new Z-order 2D array.
+ *
+ * Parameters
+ *      int width       the width (number of columns) of the array
+ *      int height      the height (number of rows) of the array
+ *      int size        the size of each element, in bytes; must include padding
+ *                      necessary for alignment
+ *
+ * Returns
+ *      A2              the created array
+ *
+ * Notes
+ *      Will CRE if width and/or height are negative.
+ *      Will CRE if size is not positive.
+ *      Will CRE if the mapping cannot be made, or its size overflows.
+ *      Raises Alloc40_Over_Budget if the elements would go over the memory
+ *      budget.
+ *      All elements are initialized to zero.
+ */
+static A2 new(int width, int height, int size)
+{
+        assert(width >= 0 && height >= 0);
+        assert(size > 0);
+        struct morton header;
+        header.width = width;
+        header.height = height;
+        header.size = size;
+        int shorter = width < height ? width : height;
+        int longer = width < height ? height : width;
+        header.shift = 0;
+        while ((1LL << header.shift) < shorter) {
+                header.shift++;
+        }
+        header.mask = (1U << header.shift) - 1;
+        header.squares = shorter == 0 ? 0 :
+                         (int)((longer + (int64_t)header.mask) >>
+                               header.shift);
+        size_t squareBytes;
+        bool overflow = __builtin_mul_overflow((size_t)1 << 2 * header.shift,
+                                               (size_t)size, &squareBytes) ||
+                        __builtin_mul_overflow(squareBytes,
+                                               (size_t)header.squares,
+                                               &header.bytes);
+        assert(!overflow);
+        header.base = NULL;
+
+        /* the header and the elements are counted at once, before either is
+           allocated, so that going over the budget leaks neither */
+        header.tag = Alloc40_count(countedBytes(&header));
+        struct morton *array = malloc(sizeof(*array));
+        assert(array != NULL);
+        *array = header;
+        if (array->bytes == 0) {
+                return array;
+        }
+
+        void *base = mmap(NULL, array->bytes, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        assert(base != MAP_FAILED);
+        array->base = base;
+        return array;
+}
+
+/* new_with_blocksize
+ *
+ * Allocate, initialize, and return a new Z-order 2D array. A Z-order array
+ * has no blocksize, so this is equivalent to `new()`.
+ */
+static A2 new_with_blocksize(int width, int height, int size, int blocksize)
+{
+        (void)blocksize;
+        return new(width, height, size);
+}
+
+/* a2free
+ *
+ * Deallocate and clear the given pointer to an array.
+ *
+ * Parameters
+ *      A2 *array2p     the address of the pointer to the array to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `array2p` or `*array2p` is NULL.
+ *      Sets `*array2p` to NULL.
+ */
+static void a2free(A2 *array2p)
+{
+        assert(array2p != NULL && *array2p != NULL);
+        struct morton *array = *array2p;
+        if (array->base != NULL) {
+                munmap(array->base, array->bytes);
+        }
+        Alloc40_uncount(array->tag, countedBytes(array));
+        free(array);
+        *array2p = NULL;
+}
+
+/* width
+ *
+ * Get the width of an array.
+ */
+static int width(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((struct morton *)array2)->width;
+}
+
+/* height
+ *
+ * Get the height of an array.
+ */
+static int height(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((struct morton *)array2)->height;
+}
+
+/* size
+ *
+ * Get the size of an element of an array.
+ */
+static int size(A2 array2)
+{
+        assert(array2 != NULL);
+        return ((struct morton *)array2)->size;
+}
+
+/* blocksize
+ *
+ * Get the blocksize of an array, which is 1, as for a plain array.
+ */
+static int blocksize(A2 array2)
+{
+        assert(array2 != NULL);
+        return 1;
+}
+
+/* element
+ *
+ * Get the address of an element, which must be in the array.
+ */
+static inline char *element(struct morton *array, int col, int row)
+{
+        uint64_t index = spread(col & array->mask) |
+                         spread(row & array->mask) << 1;
+        index |= (uint64_t)((col | row) >> array->shift) << 2 * array->shift;
+        return array->base + index * array->size;
+}
+
+/* at
+ *
+ * Get a pointer to the element at the given position for a given array.
+ *
+ * Parameters
+ *      A2 uarray2      a 2D array
+ *      int col         the column (x-position) of the desired element
+ *      int row         the row (y-position) of the desired element
+ *
+ * Returns
+ *      A2Methods_Object *
+ *                      a pointer to the given position in the array
+ *
+ * Notes
+ *      Will CRE if `array2` is NULL.
+ *      Will CRE if `col` is not between 0 and one less than the array's width.
+ *      Will CRE if `row` is not between 0 and one less than the array's height.
+ */
+static A2Methods_Object *at(A2 array2, int col, int row)
+{
+        assert(array2 != NULL);
+        struct morton *array = array2;
+        assert(col >= 0 && col < array->width);
+        assert(row >= 0 && row < array->height);
+        return element(array, col, row);
+}
+
+/* walk
+ *
+ * Call a function for the elements of one square of a Z-order array, in
+ * memory order, skipping the padding.
+ *
+ * Parameters
+ *      struct morton *array    the array
+ *      char *base              the first element of the square
+ *      int left, top           the column and row of that element
+ *      int side                the side of the square, a power of two
+ *      A2Methods_applyfun apply
+ *                              the function to apply to each element
+ *      void *cl                the closure to pass to `apply`
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      A square wholly in the array is walked in one loop down its memory,
+ *      a 2-by-2 block at a time so that the coordinates are found once a
+ *      block; one partly in it is split into its four quarters, which are in
+ *      memory top-left, top-right, bottom-left, bottom-right.
+ */
+static void walk(struct morton *array, char *base, int left, int top,
+                 int side, A2Methods_applyfun apply, void *cl)
+{
+        if (left >= array->width || top >= array->height) {
+                return;
+        }
+        if (side == 1) {
+                apply(left, top, array, base, cl);
+                return;
+        }
+        if (array->width - left >= side && array->height - top >= side) {
+                uint64_t quads = (uint64_t)side * side / 4;
+                int step = array->size;
+                for (uint64_t quad = 0; quad < quads; quad++) {
+                        int col = left + 2 * compact(quad);
+                        int row = top + 2 * compact(quad >> 1);
+                        char *first = base + quad * 4 * step;
+                        apply(col, row, array, first, cl);
+                        apply(col + 1, row, array, first + step, cl);
+                        apply(col, row + 1, array, first + 2 * step, cl);
+                        apply(col + 1, row + 1, array, first + 3 * step, cl);
+                }
+                return;
+        }
+        int half = side / 2;
+        size_t quarter = (size_t)half * half * array->size;
+        walk(array, base, left, top, half, apply, cl);
+        walk(array, base + quarter, left + half, top, half, apply, cl);
+        walk(array, base + 2 * quarter, left, top + half, half, apply, cl);
+        walk(array, base + 3 * quarter, left + half, top + half, half, apply,
+             cl);
+}
+
+/* map_block_major
+ *
+ * Call the given function for all elements of the array in Z-order, which is
+ * the order they are in memory.
+ *
+ * Parameters
+ *      A2 uarray2      a 2D array
+ *      A2Methods_applyfun apply
+ *                      a function to apply to each element of the array
+ *      void *cl        an arbitrary address provided by the client
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` or `apply` are NULL.
+ *      May raise exceptions if `apply` raises exceptions.
+ */
+static void map_block_major(A2 uarray2, A2Methods_applyfun apply, void *cl)
+{
+        assert(uarray2 != NULL && apply != NULL);
+        struct morton *array = uarray2;
+        int side = 1 << array->shift;
+        size_t squareBytes = (size_t)side * side * array->size;
+        bool wide = array->width >= array->height;
+        for (int square = 0; square < array->squares; square++) {
+                walk(array, array->base + square * squareBytes,
+                     wide ? square * side : 0, wide ? 0 : square * side, side,
+                     apply, cl);
+        }
+}
+
+/* map_row_major
+ *
+ * Call the given function for all elements of the array, iterating in
+ * row-major order.
+ *
+ * Parameters
+ *      A2 uarray2      a 2D array
+ *      A2Methods_applyfun apply
+ *                      a function to apply to each element of the array
+ *      void *cl        an arbitrary address provided by the client
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` or `apply` are NULL.
+ *      May raise exceptions if `apply` raises exceptions.
+ */
+static void map_row_major(A2 uarray2, A2Methods_applyfun apply, void *cl)
+{
+        assert(uarray2 != NULL && apply != NULL);
+        struct morton *array = uarray2;
+        for (int row = 0; row < array->height; row++) {
+                for (int col = 0; col < array->width; col++) {
+                        apply(col, row, uarray2, element(array, col, row), cl);
+                }
+        }
+}
+
+/* map_col_major
+ *
+ * Call the given function for all elements of the array, iterating in
+ * column-major order.
+ *
+ * Parameters
+ *      A2 uarray2      a 2D array
+ *      A2Methods_applyfun apply
+ *                      a function to apply to each element of the array
+ *      void *cl        an arbitrary address provided by the client
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` or `apply` are NULL.
+ *      May raise exceptions if `apply` raises exceptions.
+ */
+static void map_col_major(A2 uarray2, A2Methods_applyfun apply, void *cl)
+{
+        assert(uarray2 != NULL && apply != NULL);
+        struct morton *array = uarray2;
+        for (int col = 0; col < array->width; col++) {
+                for (int row = 0; row < array->height; row++) {
+                        apply(col, row, uarray2, element(array, col, row), cl);
+                }
+        }
+}
+
+struct small_closure {
+        A2Methods_smallapplyfun *apply;
+        void                    *cl;
+};
+
+static void apply_small(int i, int j, A2 uarray2, void *elem, void *vcl)
+{
+        struct small_closure *cl = vcl;
+        (void)i;
+        (void)j;
+        (void)uarray2;
+        cl->apply(elem, cl->cl);
+}
+
+static void small_map_row_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_row_major(a2, apply_small, &mycl);
+}
+
+static void small_map_col_major(A2 a2, A2Methods_smallapplyfun apply,
+                                void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_col_major(a2, apply_small, &mycl);
+}
+
+static void small_map_block_major(A2 a2, A2Methods_smallapplyfun apply,
+                                  void *cl)
+{
+        struct small_closure mycl = { apply, cl };
+        map_block_major(a2, apply_small, &mycl);
+}
+
+/* uarray2_methods_morton_struct
+ *
+ * An implementation of the A2Methods interface for Z-order 2D arrays.
+ */
+static struct A2Methods_T uarray2_methods_morton_struct = {
+        new,
+        new_with_blocksize,
+        a2free,
+
+        width,
+        height,
+        size,
+        blocksize,
+
+        at,
+
+        map_row_major,
+        map_col_major,
+        map_block_major,
+        map_block_major,                /* map_default */
+
+        small_map_row_major,
+        small_map_col_major,
+        small_map_block_major,
+        small_map_block_major           /* small_map_default */
+};
+
+/* The exported struct */
+A2Methods_T uarray2_methods_morton = &uarray2_methods_morton_struct;
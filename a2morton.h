@@ -0,0 +1,24 @@
+/*
+ * a2morton.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Defines an A2Methods backend whose arrays are laid out along a Z-order
+ * (Morton) curve: the bits of an element's column and row are interleaved to
+ * give its place in memory. Every aligned square of a power-of-two side is
+ * then one run of memory, at every size at once, so both row and column
+ * neighbours are usually near in memory and there is no blocksize to tune.
+ * The 2-by-2 blocks the codec packs are four elements in a row.
+ *
+ * `map_block_major` (the default) walks the array in Z-order, which is the
+ * order it is in memory; `map_row_major` and `map_col_major` are native too.
+ */
+
+#ifndef A2MORTON_INCLUDED
+#define A2MORTON_INCLUDED
+
+#include "a2methods.h"
+
+extern A2Methods_T uarray2_methods_morton;
+
+#endif
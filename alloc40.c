@@ -0,0 +1,307 @@
+/*
+ * alloc40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements the allocation accounting. Tags live in a fixed table; a lock
+ * is taken only to add a tag the first time it is set. The counts and the
+ * budget are read and updated with GCC's __atomic builtins, relaxed, since
+ * each only has to be right on its own. Memory from Alloc40_malloc carries a small header
+ * holding its size and tag, so Alloc40_free needs nothing else.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "assert.h"
+
+#include "alloc40.h"
+
+/* The most tags that can be told apart */
+#define MAX_TAGS 32
+
+const Except_T Alloc40_Over_Budget = { "Memory budget exceeded" };
+
+/* struct counts
+ *
+ * Holds the counts of one tag, or of the whole process.
+ *
+ * Components
+ *      const char *name        the tag
+ *      size_t allocs, frees    how many allocations and deallocations
+ *      size_t live             the bytes allocated and not yet freed
+ *      size_t peak             the most bytes ever live at once
+ *      size_t total            the bytes ever allocated
+ */
+struct counts {
+        const char *name;
+        size_t allocs, frees;
+        size_t live, peak, total;
+};
+
+/* struct header
+ *
+ * Precedes memory from Alloc40_malloc; 16 bytes, so that the memory after it
+ * stays aligned for any type.
+ */
+struct header {
+        size_t bytes;
+        int64_t tag;
+};
+
+static struct counts tags[MAX_TAGS] = { { "other", 0, 0, 0, 0, 0 } };
+static int numTags = 1;
+static struct counts all = { "all", 0, 0, 0, 0, 0 };
+static size_t budget = 0;
+static pthread_mutex_t tagsLock = PTHREAD_MUTEX_INITIALIZER;
+static __thread int current = 0;
+
+/* raisePeak
+ *
+ * Raise a peak to a new live count if that is higher, atomically.
+ */
+static void raisePeak(size_t *peak, size_t live)
+{
+        size_t seen = __atomic_load_n(peak, __ATOMIC_RELAXED);
+        while (live > seen &&
+               !__atomic_compare_exchange_n(peak, &seen, live, true,
+                                            __ATOMIC_RELAXED,
+                                            __ATOMIC_RELAXED)) {
+        }
+}
+
+/* Alloc40_tag
+ *
+ * Set the tag the calling thread's allocations are counted under.
+ *
+ * Parameters
+ *      const char *tag         the tag, such as a stage name; must outlive
+ *                              the program's use of this module
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if tag is NULL.
+ *      Allocations made before any tag is set are counted under "other", as
+ *      are those of any tag beyond the 32nd.
+ */
+extern void Alloc40_tag(const char *tag)
+{
+        assert(tag != NULL);
+        int count = __atomic_load_n(&numTags, __ATOMIC_ACQUIRE);
+        for (int i = 0; i < count; i++) {
+                if (strcmp(tags[i].name, tag) == 0) {
+                        current = i;
+                        return;
+                }
+        }
+
+        pthread_mutex_lock(&tagsLock);
+        int i;
+        for (i = 0; i < numTags && strcmp(tags[i].name, tag) != 0; i++) {
+        }
+        if (i == numTags && numTags < MAX_TAGS) {
+                tags[i].name = tag;
+                __atomic_store_n(&numTags, numTags + 1, __ATOMIC_RELEASE);
+        }
+        current = i < numTags ? i : 0;
+        pthread_mutex_unlock(&tagsLock);
+}
+
+/* Alloc40_count
+ *
+ * Count an allocation under the calling thread's tag.
+ *
+ * Parameters
+ *      size_t bytes            the size of the allocation
+ *
+ * Returns
+ *      int                     the tag it was counted under; give it back to
+ *                              Alloc40_uncount when the memory is freed
+ *
+ * Notes
+ *      Raises Alloc40_Over_Budget, counting nothing, if the allocation would
+ *      take the live bytes over the budget.
+ */
+extern int Alloc40_count(size_t bytes)
+{
+        size_t live = __atomic_add_fetch(&all.live, bytes, __ATOMIC_RELAXED);
+        size_t most = __atomic_load_n(&budget, __ATOMIC_RELAXED);
+        if (most != 0 && live > most) {
+                __atomic_sub_fetch(&all.live, bytes, __ATOMIC_RELAXED);
+                RAISE(Alloc40_Over_Budget);
+        }
+        raisePeak(&all.peak, live);
+        __atomic_add_fetch(&all.allocs, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&all.total, bytes, __ATOMIC_RELAXED);
+
+        struct counts *tag = &tags[current];
+        live = __atomic_add_fetch(&tag->live, bytes, __ATOMIC_RELAXED);
+        raisePeak(&tag->peak, live);
+        __atomic_add_fetch(&tag->allocs, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&tag->total, bytes, __ATOMIC_RELAXED);
+        return current;
+}
+
+/* Alloc40_uncount
+ *
+ * Count the deallocation of memory counted by Alloc40_count.
+ *
+ * Parameters
+ *      int tag                 the tag Alloc40_count returned
+ *      size_t bytes            the size that was counted
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if tag is not a tag Alloc40_count can return.
+ */
+extern void Alloc40_uncount(int tag, size_t bytes)
+{
+        assert(tag >= 0 && tag < MAX_TAGS);
+        __atomic_sub_fetch(&all.live, bytes, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&all.frees, 1, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&tags[tag].live, bytes, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&tags[tag].frees, 1, __ATOMIC_RELAXED);
+}
+
+/* Alloc40_malloc
+ *
+ * Allocate memory and count it under the calling thread's tag.
+ *
+ * Parameters
+ *      size_t bytes            the number of bytes wanted
+ *
+ * Returns
+ *      void *                  the memory, aligned as malloc's is
+ *
+ * Notes
+ *      Will CRE if the allocation fails.
+ *      Raises Alloc40_Over_Budget if it would go over the budget.
+ *      Free it with Alloc40_free().
+ */
+extern void *Alloc40_malloc(size_t bytes)
+{
+        int tag = Alloc40_count(bytes);
+        struct header *header = malloc(sizeof(struct header) + bytes);
+        assert(header != NULL);
+        header->bytes = bytes;
+        header->tag = tag;
+        return header + 1;
+}
+
+/* Alloc40_free
+ *
+ * Free memory from Alloc40_malloc and count its deallocation.
+ *
+ * Parameters
+ *      void *ptr               the memory, or NULL
+ *
+ * Returns
+ *      (Nothing.)
+ */
+extern void Alloc40_free(void *ptr)
+{
+        if (ptr == NULL) {
+                return;
+        }
+        struct header *header = (struct header *)ptr - 1;
+        Alloc40_uncount(header->tag, header->bytes);
+        free(header);
+}
+
+/* Alloc40_budget
+ *
+ * Limit the bytes that may be live at once.
+ *
+ * Parameters
+ *      size_t bytes            the limit; 0 for no limit
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Memory that is already live is not affected.
+ */
+extern void Alloc40_budget(size_t bytes)
+{
+        __atomic_store_n(&budget, bytes, __ATOMIC_RELAXED);
+}
+
+/* Alloc40_live
+ *
+ * Get the bytes counted as live right now, over every tag.
+ */
+extern size_t Alloc40_live(void)
+{
+        return __atomic_load_n(&all.live, __ATOMIC_RELAXED);
+}
+
+/* Alloc40_peak
+ *
+ * Get the most bytes ever counted as live at once, over every tag.
+ */
+extern size_t Alloc40_peak(void)
+{
+        return __atomic_load_n(&all.peak, __ATOMIC_RELAXED);
+}
+
+/* Alloc40_report
+ *
+ * Print the counts of every tag that has allocated anything.
+ *
+ * Parameters
+ *      FILE *out               where to print them
+ *      bool json               print one JSON object instead of a table
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if out is NULL.
+ *      The JSON object is printed without a trailing newline, so that it can
+ *      be nested in another.
+ */
+extern void Alloc40_report(FILE *out, bool json)
+{
+        assert(out != NULL);
+        int count = __atomic_load_n(&numTags, __ATOMIC_ACQUIRE);
+
+        if (json) {
+                bool first = true;
+                fprintf(out, "{\"live_bytes\": %zu, \"peak_bytes\": %zu, "
+                        "\"allocs\": %zu, \"tags\": [", all.live, all.peak,
+                        all.allocs);
+                for (int i = 0; i < count; i++) {
+                        struct counts *c = &tags[i];
+                        if (c->allocs == 0) {
+                                continue;
+                        }
+                        fprintf(out, "%s\n  {\"tag\": \"%s\", \"allocs\": %zu, "
+                                "\"frees\": %zu, \"live_bytes\": %zu, "
+                                "\"peak_bytes\": %zu, \"total_bytes\": %zu}",
+                                first ? "" : ",", c->name, c->allocs,
+                                c->frees, c->live, c->peak, c->total);
+                        first = false;
+                }
+                fprintf(out, "]}");
+                return;
+        }
+
+        fprintf(out, "%-10s %9s %9s %14s %14s %14s\n", "memory", "allocs",
+                "frees", "live bytes", "peak bytes", "total bytes");
+        for (int i = 0; i < count; i++) {
+                struct counts *c = &tags[i];
+                if (c->allocs > 0) {
+                        fprintf(out, "%-10s %9zu %9zu %14zu %14zu %14zu\n",
+                                c->name, c->allocs, c->frees, c->live,
+                                c->peak, c->total);
+                }
+        }
+        fprintf(out, "%-10s %9zu %9zu %14zu %14zu %14zu\n", all.name,
+                all.allocs, all.frees, all.live, all.peak, all.total);
+}
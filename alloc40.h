@@ -0,0 +1,156 @@
+/*
+ * alloc40.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Accounts for the memory the codec allocates. UArray2, UArray2b and the
+ * codec's own buffers report every allocation and deallocation here, under
+ * the tag (usually the name of a stage) the allocating thread last set. For
+ * every tag, and for the process as a whole, it keeps the number of
+ * allocations and deallocations, the bytes still live, the most bytes ever
+ * live at once and the total bytes ever allocated.
+ *
+ * A budget can be set on the live bytes of the whole process; an allocation
+ * that would go over it raises Alloc40_Over_Budget instead of being made.
+ *
+ * The counts are kept with atomic operations and the current tag is
+ * per-thread, so every function may be called from any thread.
+ */
+
+#ifndef ALLOC40_H
+#define ALLOC40_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "except.h"
+
+/* Raised by an allocation that would take the live bytes over the budget */
+extern const Except_T Alloc40_Over_Budget;
+
+/* Alloc40_tag
+ *
+ * Set the tag the calling thread's allocations are counted under.
+ *
+ * Parameters
+ *      const char *tag         the tag, such as a stage name; must outlive
+ *                              the program's use of this module
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if tag is NULL.
+ *      Allocations made before any tag is set are counted under "other", as
+ *      are those of any tag beyond the 32nd.
+ */
+extern void Alloc40_tag(const char *tag);
+
+/* Alloc40_count
+ *
+ * Count an allocation under the calling thread's tag.
+ *
+ * Parameters
+ *      size_t bytes            the size of the allocation
+ *
+ * Returns
+ *      int                     the tag it was counted under; give it back to
+ *                              Alloc40_uncount when the memory is freed
+ *
+ * Notes
+ *      Raises Alloc40_Over_Budget, counting nothing, if the allocation would
+ *      take the live bytes over the budget.
+ */
+extern int Alloc40_count(size_t bytes);
+
+/* Alloc40_uncount
+ *
+ * Count the deallocation of memory counted by Alloc40_count.
+ *
+ * Parameters
+ *      int tag                 the tag Alloc40_count returned
+ *      size_t bytes            the size that was counted
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if tag is not a tag Alloc40_count can return.
+ */
+extern void Alloc40_uncount(int tag, size_t bytes);
+
+/* Alloc40_malloc
+ *
+ * Allocate memory and count it under the calling thread's tag.
+ *
+ * Parameters
+ *      size_t bytes            the number of bytes wanted
+ *
+ * Returns
+ *      void *                  the memory, aligned as malloc's is
+ *
+ * Notes
+ *      Will CRE if the allocation fails.
+ *      Raises Alloc40_Over_Budget if it would go over the budget.
+ *      Free it with Alloc40_free().
+ */
+extern void *Alloc40_malloc(size_t bytes);
+
+/* Alloc40_free
+ *
+ * Free memory from Alloc40_malloc and count its deallocation.
+ *
+ * Parameters
+ *      void *ptr               the memory, or NULL
+ *
+ * Returns
+ *      (Nothing.)
+ */
+extern void Alloc40_free(void *ptr);
+
+/* Alloc40_budget
+ *
+ * Limit the bytes that may be live at once.
+ *
+ * Parameters
+ *      size_t bytes            the limit; 0 for no limit
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Memory that is already live is not affected.
+ */
+extern void Alloc40_budget(size_t bytes);
+
+/* Alloc40_live
+ *
+ * Get the bytes counted as live right now, over every tag.
+ */
+extern size_t Alloc40_live(void);
+
+/* Alloc40_peak
+ *
+ * Get the most bytes ever counted as live at once, over every tag.
+ */
+extern size_t Alloc40_peak(void);
+
+/* Alloc40_report
+ *
+ * Print the counts of every tag that has allocated anything.
+ *
+ * Parameters
+ *      FILE *out               where to print them
+ *      bool json               print one JSON object instead of a table
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if out is NULL.
+ *      The JSON object is printed without a trailing newline, so that it can
+ *      be nested in another.
+ */
+extern void Alloc40_report(FILE *out, bool json);
+
+#endif
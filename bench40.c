@@ -0,0 +1,653 @@
+/*
+ * bench40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Microbenchmarks for every kernel of the image codec: the RGB/video
+ * component conversions, the discrete cosine transform and quantization,
+ * codeword packing, the Bitpack and Arith40 primitives, row- and
+ * column-order element access in UArray2, UArray2b and the Z-order backend,
+ * and each map order of the A2Methods suites.
+ *
+ * Usage: `./bench40 [-s samples] [-n ops] [name...]`
+ *
+ * Every benchmark is run once untimed to warm caches and branch predictors,
+ * then timed `samples` times (default 31) over `ops` operations (default
+ * 1048576) each. It reports the median, 99th percentile and fastest time per
+ * operation, and the median throughput in GB/s of the bytes each operation
+ * reads and writes. Inputs come from a fixed seed, so runs are repeatable.
+ * Naming benchmarks runs only those whose names contain one of the names.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "a2blocked.h"
+#include "a2morton.h"
+#include "bitpack.h"
+#include "uarray2.h"
+#include "uarray2b.h"
+#include "blockPack.h"
+
+/* The number of precomputed inputs each kernel cycles through; a power of 2 */
+#define INPUTS 4096
+
+/* The side of the square rasters used by the access and map benchmarks */
+#define SIDE 1024
+
+/* A benchmark
+ *
+ * Components
+ *      const char *name        the name it is reported and selected by
+ *      size_t bytes            the bytes one operation reads and writes
+ *      size_t (*run)(size_t)   does at least the given number of operations
+ *                              and returns how many it did
+ */
+struct bench {
+        const char *name;
+        size_t bytes;
+        size_t (*run)(size_t ops);
+};
+
+/* Results are folded into these so the compiler cannot drop the kernels */
+static volatile uint64_t sink;
+static volatile float fsink;
+
+/* Precomputed inputs */
+static struct Pnm_rgb rgbs[INPUTS];
+static struct vidComp vidComps[INPUTS];
+static struct myYs ys[INPUTS];
+static struct abcd abcds[INPUTS];
+static struct pack packs[INPUTS];
+static struct fullPack fullPacks[INPUTS];
+static uint32_t codeWords[INPUTS];
+static uint64_t words[INPUTS];
+static float chromas[INPUTS];
+
+/* The rasters of the access and map benchmarks */
+static UArray2_T plain;
+static UArray2b_T blocked;
+static A2Methods_UArray2 morton;
+
+/* randomUnit
+ *
+ * Get a pseudo-random number from the fixed-seed generator.
+ *
+ * Parameters
+ *      float lo                the smallest number wanted
+ *      float hi                the largest number wanted
+ *
+ * Returns
+ *      float                   a number in [lo, hi]
+ */
+static float randomUnit(float lo, float hi)
+{
+        return lo + (hi - lo) * ((float)rand() / RAND_MAX);
+}
+
+/* setUp
+ *
+ * Fill the inputs of every benchmark.
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Allocates the rasters, which live until the program exits.
+ */
+static void setUp(void)
+{
+        srand(40);
+        for (int i = 0; i < INPUTS; i++) {
+                rgbs[i].red = rand() % 256;
+                rgbs[i].green = rand() % 256;
+                rgbs[i].blue = rand() % 256;
+                vidComps[i] = toVideoComponent(rgbs[i], 255);
+                ys[i].Y1 = randomUnit(0, 1);
+                ys[i].Y2 = randomUnit(0, 1);
+                ys[i].Y3 = randomUnit(0, 1);
+                ys[i].Y4 = randomUnit(0, 1);
+                abcds[i].a = randomUnit(0, 1);
+                abcds[i].b = randomUnit(-0.5, 0.5);
+                abcds[i].c = randomUnit(-0.5, 0.5);
+                abcds[i].d = randomUnit(-0.5, 0.5);
+                packs[i] = quantabcd(abcds[i]);
+                fullPacks[i].pack = packs[i];
+                fullPacks[i].pb = rand() % 16;
+                fullPacks[i].pr = rand() % 16;
+                codeWords[i] = packCodeword(fullPacks[i]);
+                words[i] = (uint64_t)rand() << 32 | (uint64_t)rand();
+                chromas[i] = randomUnit(-0.5, 0.5);
+        }
+
+        plain = UArray2_new(SIDE, SIDE, sizeof(struct vidComp));
+        blocked = UArray2b_new_64K_block(SIDE, SIDE, sizeof(struct vidComp));
+        morton = uarray2_methods_morton->new(SIDE, SIDE,
+                                             sizeof(struct vidComp));
+        for (int row = 0; row < SIDE; row++) {
+                for (int col = 0; col < SIDE; col++) {
+                        struct vidComp v = vidComps[(row * SIDE + col) &
+                                                    (INPUTS - 1)];
+                        *(struct vidComp *)UArray2_at(plain, col, row) = v;
+                        *(struct vidComp *)UArray2b_at(blocked, col, row) = v;
+                        *(struct vidComp *)uarray2_methods_morton->at(morton,
+                                                                      col,
+                                                                      row) = v;
+                }
+        }
+}
+
+/*******************************************************************************
+ * Kernels
+ *
+ * Each run function does `ops` calls of one kernel, cycling through the
+ * precomputed inputs, and returns `ops`.
+ ******************************************************************************/
+
+static size_t runToVideoComponent(size_t ops)
+{
+        float sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += toVideoComponent(rgbs[i & (INPUTS - 1)], 255).y;
+        }
+        fsink = sum;
+        return ops;
+}
+
+static size_t runToRGB(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += toRGB(vidComps[i & (INPUTS - 1)], 255).red;
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runDiscreteTrans(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += discreteTrans(ys[i & (INPUTS - 1)]).a;
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runDiscreteDetrans(size_t ops)
+{
+        float sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += discreteDetrans(abcds[i & (INPUTS - 1)]).Y1;
+        }
+        fsink = sum;
+        return ops;
+}
+
+static size_t runQuantabcd(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += quantabcd(abcds[i & (INPUTS - 1)]).b;
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runUnQuantabcd(size_t ops)
+{
+        float sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += unQuantabcd(packs[i & (INPUTS - 1)]).b;
+        }
+        fsink = sum;
+        return ops;
+}
+
+static size_t runPackCodeword(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += packCodeword(fullPacks[i & (INPUTS - 1)]);
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runUnPackCodeword(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += unPackCodeword(codeWords[i & (INPUTS - 1)]).pack.a;
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runBitpackFitsu(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += Bitpack_fitsu(words[i & (INPUTS - 1)] >> 40, 20);
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runBitpackFitss(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += Bitpack_fitss((int64_t)words[i & (INPUTS - 1)] >> 40,
+                                     20);
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runBitpackGetu(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += Bitpack_getu(words[i & (INPUTS - 1)], 9, i & 31);
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runBitpackGets(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += Bitpack_gets(words[i & (INPUTS - 1)], 5, i & 31);
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runBitpackNewu(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += Bitpack_newu(words[i & (INPUTS - 1)], 9, i & 31,
+                                    i & 511);
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runBitpackNews(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += Bitpack_news(words[i & (INPUTS - 1)], 5, i & 31,
+                                    (int64_t)(i & 31) - 16);
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runIndexOfChroma(size_t ops)
+{
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += Arith40_index_of_chroma(chromas[i & (INPUTS - 1)]);
+        }
+        sink = sum;
+        return ops;
+}
+
+static size_t runChromaOfIndex(size_t ops)
+{
+        float sum = 0;
+        for (size_t i = 0; i < ops; i++) {
+                sum += Arith40_chroma_of_index(i & 15);
+        }
+        fsink = sum;
+        return ops;
+}
+
+/*******************************************************************************
+ * Element access and map orders
+ *
+ * These visit whole SIDE x SIDE rasters, so they may do a few more than `ops`
+ * operations; they return how many they did.
+ ******************************************************************************/
+
+static size_t runUArray2At(size_t ops)
+{
+        float sum = 0;
+        size_t done = 0;
+        while (done < ops) {
+                for (int row = 0; row < SIDE; row++) {
+                        for (int col = 0; col < SIDE; col++) {
+                                sum += ((struct vidComp *)
+                                        UArray2_at(plain, col, row))->y;
+                        }
+                }
+                done += SIDE * SIDE;
+        }
+        fsink = sum;
+        return done;
+}
+
+static size_t runUArray2bAt(size_t ops)
+{
+        float sum = 0;
+        size_t done = 0;
+        while (done < ops) {
+                for (int row = 0; row < SIDE; row++) {
+                        for (int col = 0; col < SIDE; col++) {
+                                sum += ((struct vidComp *)
+                                        UArray2b_at(blocked, col, row))->y;
+                        }
+                }
+                done += SIDE * SIDE;
+        }
+        fsink = sum;
+        return done;
+}
+
+static size_t runUArray2AtCol(size_t ops)
+{
+        float sum = 0;
+        size_t done = 0;
+        while (done < ops) {
+                for (int col = 0; col < SIDE; col++) {
+                        for (int row = 0; row < SIDE; row++) {
+                                sum += ((struct vidComp *)
+                                        UArray2_at(plain, col, row))->y;
+                        }
+                }
+                done += SIDE * SIDE;
+        }
+        fsink = sum;
+        return done;
+}
+
+static size_t runUArray2bAtCol(size_t ops)
+{
+        float sum = 0;
+        size_t done = 0;
+        while (done < ops) {
+                for (int col = 0; col < SIDE; col++) {
+                        for (int row = 0; row < SIDE; row++) {
+                                sum += ((struct vidComp *)
+                                        UArray2b_at(blocked, col, row))->y;
+                        }
+                }
+                done += SIDE * SIDE;
+        }
+        fsink = sum;
+        return done;
+}
+
+static size_t runMortonAt(size_t ops)
+{
+        A2Methods_T methods = uarray2_methods_morton;
+        float sum = 0;
+        size_t done = 0;
+        while (done < ops) {
+                for (int row = 0; row < SIDE; row++) {
+                        for (int col = 0; col < SIDE; col++) {
+                                sum += ((struct vidComp *)
+                                        methods->at(morton, col, row))->y;
+                        }
+                }
+                done += SIDE * SIDE;
+        }
+        fsink = sum;
+        return done;
+}
+
+static size_t runMortonAtCol(size_t ops)
+{
+        A2Methods_T methods = uarray2_methods_morton;
+        float sum = 0;
+        size_t done = 0;
+        while (done < ops) {
+                for (int col = 0; col < SIDE; col++) {
+                        for (int row = 0; row < SIDE; row++) {
+                                sum += ((struct vidComp *)
+                                        methods->at(morton, col, row))->y;
+                        }
+                }
+                done += SIDE * SIDE;
+        }
+        fsink = sum;
+        return done;
+}
+
+/* applySum
+ *
+ * Apply function for the map benchmarks: adds the Y of each element to the
+ * float pointed to by the closure.
+ */
+static void applySum(int col, int row, A2Methods_UArray2 array2,
+                     A2Methods_Object *element, void *cl)
+{
+        (void)col;
+        (void)row;
+        (void)array2;
+        *(float *)cl += ((struct vidComp *)element)->y;
+}
+
+/* runMap
+ *
+ * Map over one raster in the given order until at least `ops` elements have
+ * been visited.
+ *
+ * Parameters
+ *      A2Methods_UArray2 array the raster
+ *      A2Methods_mapfun *map   the map function to time
+ *      size_t ops              the number of elements to visit
+ *
+ * Returns
+ *      size_t                  the number of elements visited
+ */
+static size_t runMap(A2Methods_UArray2 array, A2Methods_mapfun *map,
+                     size_t ops)
+{
+        float sum = 0;
+        size_t done = 0;
+        while (done < ops) {
+                map(array, applySum, &sum);
+                done += SIDE * SIDE;
+        }
+        fsink = sum;
+        return done;
+}
+
+static size_t runMapRowMajor(size_t ops)
+{
+        return runMap(plain, uarray2_methods_plain->map_row_major, ops);
+}
+
+static size_t runMapColMajor(size_t ops)
+{
+        return runMap(plain, uarray2_methods_plain->map_col_major, ops);
+}
+
+static size_t runMapBlockMajor(size_t ops)
+{
+        return runMap(blocked, uarray2_methods_blocked->map_block_major, ops);
+}
+
+static size_t runMapMorton(size_t ops)
+{
+        return runMap(morton, uarray2_methods_morton->map_default, ops);
+}
+
+static size_t runMapMortonColMajor(size_t ops)
+{
+        return runMap(morton, uarray2_methods_morton->map_col_major, ops);
+}
+
+static const struct bench BENCHES[] = {
+        { "toVideoComponent", sizeof(struct Pnm_rgb) + sizeof(struct vidComp),
+          runToVideoComponent },
+        { "toRGB", sizeof(struct vidComp) + sizeof(struct Pnm_rgb), runToRGB },
+        { "discreteTrans", sizeof(struct myYs) + sizeof(struct pack),
+          runDiscreteTrans },
+        { "discreteDetrans", sizeof(struct abcd) + sizeof(struct myYs),
+          runDiscreteDetrans },
+        { "quantabcd", sizeof(struct abcd) + sizeof(struct pack),
+          runQuantabcd },
+        { "unQuantabcd", sizeof(struct pack) + sizeof(struct abcd),
+          runUnQuantabcd },
+        { "packCodeword", sizeof(struct fullPack) + sizeof(uint32_t),
+          runPackCodeword },
+        { "unPackCodeword", sizeof(uint32_t) + sizeof(struct fullPack),
+          runUnPackCodeword },
+        { "Bitpack_fitsu", sizeof(uint64_t), runBitpackFitsu },
+        { "Bitpack_fitss", sizeof(uint64_t), runBitpackFitss },
+        { "Bitpack_getu", 2 * sizeof(uint64_t), runBitpackGetu },
+        { "Bitpack_gets", 2 * sizeof(uint64_t), runBitpackGets },
+        { "Bitpack_newu", 2 * sizeof(uint64_t), runBitpackNewu },
+        { "Bitpack_news", 2 * sizeof(uint64_t), runBitpackNews },
+        { "Arith40_index_of_chroma", sizeof(float) + sizeof(unsigned),
+          runIndexOfChroma },
+        { "Arith40_chroma_of_index", sizeof(unsigned) + sizeof(float),
+          runChromaOfIndex },
+        { "UArray2_at", sizeof(struct vidComp), runUArray2At },
+        { "UArray2b_at", sizeof(struct vidComp), runUArray2bAt },
+        { "morton_at", sizeof(struct vidComp), runMortonAt },
+        { "UArray2_at_col", sizeof(struct vidComp), runUArray2AtCol },
+        { "UArray2b_at_col", sizeof(struct vidComp), runUArray2bAtCol },
+        { "morton_at_col", sizeof(struct vidComp), runMortonAtCol },
+        { "map_row_major", sizeof(struct vidComp), runMapRowMajor },
+        { "map_col_major", sizeof(struct vidComp), runMapColMajor },
+        { "map_block_major", sizeof(struct vidComp), runMapBlockMajor },
+        { "map_morton", sizeof(struct vidComp), runMapMorton },
+        { "map_morton_col_major", sizeof(struct vidComp),
+          runMapMortonColMajor },
+};
+
+/*******************************************************************************
+ * Harness
+ ******************************************************************************/
+
+/* nowNs
+ *
+ * Read the monotonic clock.
+ *
+ * Returns
+ *      double                  the time in nanoseconds
+ */
+static double nowNs(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* compareDoubles
+ *
+ * qsort comparison function for doubles, smallest first.
+ */
+static int compareDoubles(const void *a, const void *b)
+{
+        double x = *(const double *)a;
+        double y = *(const double *)b;
+        return (x > y) - (x < y);
+}
+
+/* selected
+ *
+ * Tell whether a benchmark was asked for on the command line.
+ *
+ * Parameters
+ *      const char *name        the name of the benchmark
+ *      int count               the number of names given
+ *      char **names            the names given
+ *
+ * Returns
+ *      bool                    true if no names were given or `name`
+ *                              contains one of them
+ */
+static bool selected(const char *name, int count, char **names)
+{
+        if (count == 0) {
+                return true;
+        }
+        for (int i = 0; i < count; i++) {
+                if (strstr(name, names[i]) != NULL) {
+                        return true;
+                }
+        }
+        return false;
+}
+
+/* runBench
+ *
+ * Warm up, time and report one benchmark.
+ *
+ * Parameters
+ *      const struct bench *bench       the benchmark
+ *      int samples                     the number of timed runs
+ *      size_t ops                      the operations in each run
+ *      double *times                   room for `samples` doubles
+ *
+ * Returns
+ *      (Nothing.)
+ */
+static void runBench(const struct bench *bench, int samples, size_t ops,
+                     double *times)
+{
+        bench->run(ops);
+        for (int i = 0; i < samples; i++) {
+                double start = nowNs();
+                size_t done = bench->run(ops);
+                times[i] = (nowNs() - start) / done;
+        }
+        qsort(times, samples, sizeof(double), compareDoubles);
+
+        double median = times[samples / 2];
+        int p99 = (samples * 99 + 99) / 100 - 1;
+        printf("%-24s %10.2f %10.2f %10.2f %9.3f\n", bench->name, median,
+               times[p99], times[0],
+               median > 0 ? bench->bytes / median : 0.0);
+}
+
+int main(int argc, char *argv[])
+{
+        int samples = 31;
+        size_t ops = 1 << 20;
+        int i = 1;
+        for (; i < argc && argv[i][0] == '-'; i++) {
+                if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+                        samples = atoi(argv[++i]);
+                } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+                        ops = strtoul(argv[++i], NULL, 10);
+                } else {
+                        break;
+                }
+        }
+        if ((i < argc && argv[i][0] == '-') || samples < 1 || ops < 1) {
+                fprintf(stderr, "Usage: %s [-s samples] [-n ops] [name...]\n",
+                        argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        setUp();
+        double *times = malloc(samples * sizeof(double));
+        assert(times != NULL);
+
+        printf("%-24s %10s %10s %10s %9s\n", "benchmark", "median ns",
+               "p99 ns", "min ns", "GB/s");
+        int count = sizeof(BENCHES) / sizeof(BENCHES[0]);
+        for (int b = 0; b < count; b++) {
+                if (selected(BENCHES[b].name, argc - i, argv + i)) {
+                        runBench(&BENCHES[b], samples, ops, times);
+                }
+        }
+
+        free(times);
+        UArray2_free(&plain);
+        UArray2b_free(&blocked);
+        uarray2_methods_morton->free(&morton);
+        return EXIT_SUCCESS;
+}
@@ -9,41 +9,26 @@
  */
 #include "blockPack.h"
 #include "bitpack.h"
+#include "kernels40.h"
 
 /*******************************************************************************
  * Structs
  ******************************************************************************/
-/* a struct to hold unquantized a, b, c, d values from a 2-by-2 block*/
- struct abcd {
-        float a, b, c, d;
+/* What pack2by2Measured gives every block it packs */
+struct measure {
+        Pack2by2_measure *measure;
+        void *cl;
+        int denominator;
 };
 
-/* a struct to hold untransformed Y video component values of a 2-by-2 block*/
-struct myYs {
-        float Y1, Y2, Y3, Y4;
-};
-
-/* a struct to hold quantized a, b, c, d values from a 2-by-2 block*/
-struct pack {
-        unsigned a;
-        int b, c, d;
-};
-
-/* a struct to hold a pack (quantized a, b, c, d values) and pb, pr 
- * from a 2-by-2 block*/
-struct fullPack {
-        struct pack pack;
-        unsigned pb, pr;
-};
-
-/* A struct to use in our apply function */
+/* A struct to use in our apply function; measure is NULL unless the blocks
+   packed are being measured */
 struct mappingCl {
         A2 array;
         A2Methods_T methods;
+        const struct measure *measure;
 };
 
-A2 unEncode(A2 codeWords, A2Methods_T methods);
-
 /* quantabcd
  *
  * Quantizes the cosine coefficient values of a 2-by-2 block of pixels, turning
@@ -167,71 +152,110 @@ struct abcd unQuantabcd(struct pack quant)
         return unQuant;
 }
 
-/* unCalc2by2
+/* unPackBlock
  *
- * Sets the video component values for a 2-by-2 block of pixels from its
- * compressed state.
+ * Sets the video component values for the four pixels of a 2-by-2 block from
+ * its quantized state.
  * 
  * Parameters
- *      A2 packed              An array of fullpack structs that contain the 
- *                             the compressed versions of video component values
- *                             for a 2-by-2 block of pixels.
- *      A2Methods_T methods    a methods suite for accessing values in the 
- *                             A2 packed.
- *      int col                the column corresponding to a fullpack struct in
- *                             packed.
- *      int row                the row corresponding to a fullpack struct in
- *                             packed.
+ *      struct fullPack compPixel
+ *                             the quantized a, b, c, d, pb and pr values of
+ *                             the block
+ *      struct vidComp *block  an array of four vidComp structs, set to the
+ *                             top-left, top-right, bottom-left and
+ *                             bottom-right pixels of the block in that order
  *
  * Returns
- *      struct vidComp myVidComps
- *                             a struct vidComp that contains lossy video
- *                             component values for four pixels in a 2-by-2
- *                             block after decompression
+ *      None (void)
  *
  * Notes
- *      Will CRE if packed is NULL.
- *      Will CRE if methods is NULL.
- *      Will CRE if the malloc'd array of vidComp structs is NULL.
- *      The video component values returned in the vidComp struct will not be
- *      equivalent to the values of the original image, since the average pb
- *      and pr values will be used for each pixel and the Y values will be 
- *      rounded.
+ *      Will CRE if block is NULL.
  */
-struct vidComp *unCalc2by2(A2 packed, A2Methods_T methods, int col, int row)
+static void unPackBlock(struct fullPack compPixel, struct vidComp *block)
 {
-        assert(packed != NULL);
-        assert(methods != NULL);
-        assert(col >= 0);
-        assert(row >= 0);
-        struct fullPack compPixel = 
-                              *(struct fullPack *)methods->at(packed, col, row);
-
-        unsigned avgPb = compPixel.pb;
-        unsigned avgPr = compPixel.pr;
-        float pb = Arith40_chroma_of_index(avgPb);
-        float pr = Arith40_chroma_of_index(avgPr); 
+        assert(block != NULL);
+        float pb = Arith40_chroma_of_index(compPixel.pb);
+        float pr = Arith40_chroma_of_index(compPixel.pr); 
 
         struct abcd components = unQuantabcd(compPixel.pack);
         struct myYs yBlock = discreteDetrans(components);
 
-        struct vidComp *myVidComps = malloc(sizeof(struct vidComp) * 4);
-        assert(myVidComps != NULL);
-        
-        myVidComps[0].y = yBlock.Y1;
-        myVidComps[1].y = yBlock.Y2;
-        myVidComps[2].y = yBlock.Y3;
-        myVidComps[3].y = yBlock.Y4;
+        block[0].y = yBlock.Y1;
+        block[1].y = yBlock.Y2;
+        block[2].y = yBlock.Y3;
+        block[3].y = yBlock.Y4;
 
         for (int i = 0; i < 4; i++)
         {
-                myVidComps[i].pb = pb;
-                myVidComps[i].pr = pr;
+                block[i].pb = pb;
+                block[i].pr = pr;
         }
+}
+
+/* packBlock
+ *
+ * Takes the average of pb and pr over a 2-by-2 block of pixels and quantizes
+ * the average pb and pr and the Y luma values.
+ * 
+ * Parameters
+ *      const struct vidComp *block
+ *                             the video component values of the top-left,
+ *                             top-right, bottom-left and bottom-right pixels
+ *                             of the block, in that order
+ *
+ * Returns
+ *      struct fullPack        the quantized values of the block
+ *
+ * Notes
+ *      Will CRE if block is NULL.
+ */
+static struct fullPack packBlock(const struct vidComp *block)
+{
+        assert(block != NULL);
+        float avgPb = (block[0].pb + block[1].pb + block[2].pb + 
+                       block[3].pb) / 4.0;
+        float avgPr = (block[0].pr + block[1].pr + block[2].pr + 
+                       block[3].pr) / 4.0;
 
-        return myVidComps;
+        unsigned pb = Arith40_index_of_chroma(avgPb);
+        unsigned pr = Arith40_index_of_chroma(avgPr); 
+
+        struct myYs yBlock = {block[0].y, block[1].y, block[2].y, block[3].y};
+
+        struct pack trans = discreteTrans(yBlock);
+        struct fullPack components = {trans, pb, pr};
+
+        return components;
 }
 
+/* measureBlock
+ *
+ * Gives the measure of pack2by2Measured a block just packed, with the RGB
+ * pixels it decompresses to.
+ *
+ * Parameters
+ *      const struct measure *measure
+ *                             the measure and its closure
+ *      struct fullPack block  the quantized values of the block
+ *      int col, row           the place of the block among the blocks
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Decodes the block with the same arithmetic as decode and VCtoRGB.
+ */
+static void measureBlock(const struct measure *measure, struct fullPack block,
+                         int col, int row)
+{
+        struct vidComp comps[4];
+        unPackBlock(block, comps);
+        struct Pnm_rgb pixels[4];
+        for (int k = 0; k < 4; k++) {
+                pixels[k] = toRGB(comps[k], measure->denominator);
+        }
+        measure->measure(col, row, pixels, measure->cl);
+}
 
 /* calc2by2
  *
@@ -267,29 +291,14 @@ struct fullPack calc2by2(A2 vComp, A2Methods_T methods, int col, int row)
         assert(!(col & 1));
         assert(!(row & 1));
           
-        struct vidComp one = 
-                        *(struct vidComp *)methods->at(vComp, col, row);
-        struct vidComp two = 
-                        *(struct vidComp *)methods->at(vComp, col + 1, row);
-        struct vidComp three = 
-                        *(struct vidComp *)methods->at(vComp, col, row + 1);
-        struct vidComp four = 
-                        *(struct vidComp *)methods->at(vComp, col + 1, row + 1);
-
-        
-
-        float avgPb = (one.pb + two.pb + three.pb + four.pb) / 4.0;
-        float avgPr = (one.pr + two.pr + three.pr + four.pr) / 4.0;
-
-        unsigned pb = Arith40_index_of_chroma(avgPb);
-        unsigned pr = Arith40_index_of_chroma(avgPr); 
-
-        struct myYs yBlock = {one.y, two.y, three.y, four.y};
-
-        struct pack trans = discreteTrans(yBlock);
-        struct fullPack components = {trans, pb, pr};
-
-        return components;
+        struct vidComp block[4] = {
+                *(struct vidComp *)methods->at(vComp, col, row),
+                *(struct vidComp *)methods->at(vComp, col + 1, row),
+                *(struct vidComp *)methods->at(vComp, col, row + 1),
+                *(struct vidComp *)methods->at(vComp, col + 1, row + 1)
+        };
+
+        return packBlock(block);
 }
 
 /* apply2by2
@@ -307,7 +316,8 @@ struct fullPack calc2by2(A2 vComp, A2Methods_T methods, int col, int row)
  *                             component format.
  *      void *element          A pointer to the current element worked on.
  *      void *cl               A bundle containing the array we are writing to,
- *                             as well as the methods to manipulate the arrays.
+ *                             as well as the methods to manipulate the arrays
+ *                             and the measure of every block, if any.
  *
  * Returns
  *      None (void)
@@ -331,15 +341,20 @@ void apply2by2(int col, int row, A2 uarray2, void *element, void *cl)
         A2Methods_T methods = bundle.methods;
         A2 newArray = bundle.array;
         if (!(col & 1) && !(row & 1)) {
-                *(struct fullPack *)methods->at(newArray, col / 2, row / 2) = 
-                                           calc2by2(uarray2, methods, col, row);
+                struct fullPack block = calc2by2(uarray2, methods, col, row);
+                *(struct fullPack *)methods->at(newArray, col / 2, row / 2) =
+                                                                         block;
+                if (bundle.measure != NULL) {
+                        measureBlock(bundle.measure, block, col / 2, row / 2);
+                }
         }
 }
 
 /* unApply2by2
  *
- * Apply function that uses unCalc2by2 to convert compressed pixel data into
- * 2by2 blocks of pixels in the video component format. 
+ * Apply function that converts compressed pixel data into 2by2 blocks of
+ * pixels in the video component format, in a buffer on the stack, so that no
+ * block costs an allocation.
  *
  * Parameters
  *      int col                the column of the element being worked on.
@@ -375,7 +390,8 @@ void unApply2by2(int col, int row, A2 uarray2, void *element, void *cl)
         assert(bundle.methods != NULL);
         A2Methods_T methods = bundle.methods;
         A2 newArray = bundle.array;
-        struct vidComp *comps = unCalc2by2(uarray2, methods, col, row);
+        struct vidComp comps[4];
+        unPackBlock(*(struct fullPack *)element, comps);
         for (int i = 0; i < 2; i++)
         {
                 for (int j = 0; j < 2; j++)
@@ -387,9 +403,35 @@ void unApply2by2(int col, int row, A2 uarray2, void *element, void *cl)
                 }
                 
         }
-        free(comps);
 }
 
+/* The per-block operations of pack2by2, unPack2by2, packCodeWords and
+   unEncode, specialized for each backend by kernels40.h */
+#define PACK2BY2(block, pixels, col, row, measure)                             \
+        do {                                                                   \
+                struct vidComp comps[4] = {                                    \
+                        *(pixels)[0], *(pixels)[1], *(pixels)[2], *(pixels)[3] \
+                };                                                             \
+                *(block) = packBlock(comps);                                   \
+                if ((measure) != NULL) {                                       \
+                        measureBlock((measure), *(block), (col), (row));       \
+                }                                                              \
+        } while (0)
+#define UNPACK2BY2(block, pixels, col, row, unused)                            \
+        do {                                                                   \
+                struct vidComp comps[4];                                       \
+                unPackBlock(*(block), comps);                                  \
+                for (int k = 0; k < 4; k++) {                                  \
+                        *(pixels)[k] = comps[k];                               \
+                }                                                              \
+        } while (0)
+#define PACKCODEWORD(in, out, unused) (*(out) = packCodeword(*(in)))
+#define UNPACKCODEWORD(in, out, unused) (*(out) = unPackCodeword(*(in)))
+KERNELS40_BLOCKS(pack2by2, struct fullPack, struct vidComp, PACK2BY2)
+KERNELS40_BLOCKS(unPack2by2, struct fullPack, struct vidComp, UNPACK2BY2)
+KERNELS40_MAP(packCodeWords, struct fullPack, uint32_t, PACKCODEWORD)
+KERNELS40_MAP(unEncode, uint32_t, struct fullPack, UNPACKCODEWORD)
+
 /* pack2by2
  *
  * Calls the functions of blockPack to quantize the video component values of 
@@ -408,20 +450,99 @@ void unApply2by2(int col, int row, A2 uarray2, void *element, void *cl)
  * Notes
  *      Will CRE if vComp is NULL.
  *      Will CRE if methods is NULL.
+ *      Uses the specialization of kernels40.h for plain and blocked
+ *      suites.
  *      
  */
 A2 pack2by2(A2 vComp, A2Methods_T methods)
+{
+        return pack2by2Measured(vComp, methods, NULL, NULL, 0);
+}
+
+/* pack2by2Measured
+ *
+ * Does what pack2by2 does, and gives every block, as soon as it is packed,
+ * to a measure along with the RGB pixels it decompresses to.
+ *
+ * Parameters
+ *      A2 vComp               an array of vidComp structs that holds the video
+ *                             component values of the pixels of a PPM image.
+ *      A2Methods_T methods    a methods suite for creating new and accessing
+ *                             the values of a UArray2.
+ *      Pack2by2_measure *measure
+ *                             called with the place of every block among the
+ *                             blocks, its top-left, top-right, bottom-left
+ *                             and bottom-right pixels, and cl; NULL to
+ *                             measure nothing
+ *      void *cl               passed to measure
+ *      int denominator        the maxval the pixels are scaled to
+ *
+ * Returns
+ *      Returns a Uarray2 containing the compressed image data in a struct.
+ *
+ * Notes
+ *      Will CRE if vComp is NULL.
+ *      Will CRE if methods is NULL.
+ *      The pixels are those decompressing the blocks with denominator would
+ *      give, without any array of them being built.
+ *      Uses the specialization of kernels40.h for plain and blocked
+ *      suites.
+ */
+A2 pack2by2Measured(A2 vComp, A2Methods_T methods, Pack2by2_measure *measure,
+                    void *cl, int denominator)
 {
         assert(vComp != NULL);
         assert(methods != NULL);
 
         int width = methods->width(vComp);
         int height = methods->height(vComp);
+        struct measure measuring = {measure, cl, denominator};
+        struct measure *blocks = measure != NULL ? &measuring : NULL;
         
         A2 newArr = 
                    methods->new(width / 2, height / 2, sizeof(struct fullPack));
-        struct mappingCl bundle = {newArr, methods};
-        methods->map_default(vComp, apply2by2, &bundle);
+        if (!pack2by2Kernel(newArr, vComp, methods, blocks)) {
+                struct mappingCl bundle = {newArr, methods, blocks};
+                methods->map_default(vComp, apply2by2, &bundle);
+        }
+        
+        return newArr;
+}
+
+/* unPack2by2
+ *
+ * Calls the functions of blockPack to turn the quantized values of every
+ * 2-by-2 block back into the video component values of its four pixels.
+ *
+ * Parameters
+ *      A2 packArr             an array of fullPack structs, one per block
+ *      A2Methods_T methods    a methods suite for creating new and accessing
+ *                             the values of a UArray2.
+ *
+ * Returns
+ *      A2 newArr              an array of vidComp structs, twice as wide and
+ *                             twice as high as packArr
+ *
+ * Notes
+ *      Will CRE if packArr is NULL.
+ *      Will CRE if methods is NULL.
+ *      Uses the specialization of kernels40.h for plain and blocked
+ *      suites.
+ *      
+ */
+A2 unPack2by2(A2 packArr, A2Methods_T methods)
+{
+        assert(packArr != NULL);
+        assert(methods != NULL);
+
+        int width = methods->width(packArr);
+        int height = methods->height(packArr);
+        
+        A2 newArr = methods->new(width * 2, height * 2, sizeof(struct vidComp));
+        if (!unPack2by2Kernel(packArr, newArr, methods, NULL)) {
+                struct mappingCl bundle = {newArr, methods, NULL};
+                methods->map_default(packArr, unApply2by2, &bundle);
+        }
         
         return newArr;
 }
@@ -454,13 +575,7 @@ A2 decode(A2 codeWords, A2Methods_T methods)
         assert(methods != NULL);
 
         A2 packArr = unEncode(codeWords, methods);
-        
-        int width = methods->width(packArr);
-        int height = methods->height(packArr);
-        
-        A2 newArr = methods->new(width * 2, height * 2, sizeof(struct vidComp));
-        struct mappingCl bundle = {newArr, methods};
-        methods->map_default(packArr, unApply2by2, &bundle);
+        A2 newArr = unPack2by2(packArr, methods);
         methods->free(&packArr);
         
         return newArr;
@@ -527,6 +642,52 @@ struct fullPack unPackCodeword(uint32_t codeword) {
         return newPack;
 }
 
+/* encodeBlock
+ *
+ * Encodes the video component values of a single 2-by-2 block of pixels
+ * straight into its codeword, without building any intermediate array.
+ *
+ * Parameters
+ *      const struct vidComp *block
+ *                             the video component values of the top-left,
+ *                             top-right, bottom-left and bottom-right pixels
+ *                             of the block, in that order
+ *
+ * Returns
+ *      uint32_t               the 32-bit codeword of the block
+ *
+ * Notes
+ *      Will CRE if block is NULL.
+ *      Gives the same codeword encode does for the block.
+ */
+uint32_t encodeBlock(const struct vidComp *block)
+{
+        return packCodeword(packBlock(block));
+}
+
+/* decodeBlock
+ *
+ * Decodes a single codeword straight into the video component values of its
+ * 2-by-2 block of pixels, without building any intermediate array.
+ *
+ * Parameters
+ *      uint32_t codeWord      a 32-bit codeword
+ *      struct vidComp *block  an array of four vidComp structs, set to the
+ *                             top-left, top-right, bottom-left and
+ *                             bottom-right pixels of the block in that order
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Will CRE if block is NULL.
+ *      Gives the same values decode does for the block.
+ */
+void decodeBlock(uint32_t codeWord, struct vidComp *block)
+{
+        unPackBlock(unPackCodeword(codeWord), block);
+}
+
 /* applyEncode TODO: Complete function contract
  *
  * Apply function that uses encode to pack the values of a, b, c, d, pb, and pr
@@ -570,6 +731,43 @@ void applyEncode(int col, int row, A2 uarray2, void *element, void *cl)
                                      packCodeword(*(struct fullPack *) element);
 }
 
+/* packCodeWords
+ *
+ * Calls the packCodeword function to pack the quantized values of every
+ * 2-by-2 block into its 32-bit codeword
+ *
+ * Parameters
+ *      A2 packArr             an array of fullPack structs, one per block
+ *      A2Methods_T methods    a methods suite for creating new and accessing
+ *                             the values of a UArray2.
+ *
+ * Returns
+ *      Returns a Uarray2 of 32-bit codewords the same size as packArr.
+ *
+ * Notes
+ *      Will CRE if packArr is NULL.
+ *      Will CRE if methods is NULL.
+ *      Uses the specialization of kernels40.h for plain and blocked
+ *      suites.
+ *      
+ */
+A2 packCodeWords(A2 packArr, A2Methods_T methods)
+{
+        assert(packArr != NULL);
+        assert(methods != NULL);
+
+        int width = methods->width(packArr);
+        int height = methods->height(packArr);
+        
+        A2 codeWords = methods->new(width, height, sizeof(uint32_t));
+        if (!packCodeWordsKernel(packArr, codeWords, methods, 0)) {
+                struct mappingCl bundle = {codeWords, methods, NULL};
+                methods->map_default(packArr, applyEncode, &bundle);
+        }
+        
+        return codeWords;
+}
+
 /* encode
  *
  * Calls the packCodeword function to pack all 2-by-2 block of pixel's values
@@ -598,13 +796,7 @@ A2 encode(A2 vComp, A2Methods_T methods)
 
         
         A2 packArr = pack2by2(vComp, methods);
-
-        int width = methods->width(packArr);
-        int height = methods->height(packArr);
-        
-        A2 codeWords = methods->new(width, height, sizeof(uint32_t));
-        struct mappingCl bundle = {codeWords, methods};
-        methods->map_default(packArr, applyEncode, &bundle);
+        A2 codeWords = packCodeWords(packArr, methods);
         methods->free(&packArr);
         
         return codeWords;
@@ -672,6 +864,8 @@ void applyunEncode(int col, int row, A2 uarray2, void *element, void *cl)
  * Notes
  *      Will CRE if codeWords is NULL.
  *      Will CRE if methods is NULL.
+ *      Uses the specialization of kernels40.h for plain and blocked
+ *      suites.
  *      
  */
 A2 unEncode(A2 codeWords, A2Methods_T methods)
@@ -683,8 +877,10 @@ A2 unEncode(A2 codeWords, A2Methods_T methods)
         int height = methods->height(codeWords);
         
         A2 packArr = methods->new(width, height, sizeof(struct fullPack));
-        struct mappingCl bundle = {packArr, methods};
-        methods->map_default(codeWords, applyunEncode, &bundle);
+        if (!unEncodeKernel(codeWords, packArr, methods, 0)) {
+                struct mappingCl bundle = {packArr, methods, NULL};
+                methods->map_default(codeWords, applyunEncode, &bundle);
+        }
         
         return packArr;
 }
\ No newline at end of file
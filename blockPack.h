@@ -14,8 +14,55 @@
 
 #include "floating.h"
 #include "arith40.h"
+#include <stdint.h>
+
+/* a struct to hold unquantized a, b, c, d values from a 2-by-2 block*/
+struct abcd {
+        float a, b, c, d;
+};
+
+/* a struct to hold untransformed Y video component values of a 2-by-2 block*/
+struct myYs {
+        float Y1, Y2, Y3, Y4;
+};
+
+/* a struct to hold quantized a, b, c, d values from a 2-by-2 block*/
+struct pack {
+        unsigned a;
+        int b, c, d;
+};
+
+/* a struct to hold a pack (quantized a, b, c, d values) and pb, pr 
+ * from a 2-by-2 block*/
+struct fullPack {
+        struct pack pack;
+        unsigned pb, pr;
+};
 
 A2 decode(A2 packed, A2Methods_T methods);
 A2 encode(A2 packArr, A2Methods_T methods);
 
+/* The two passes of encode and of decode, for callers that time them */
+A2 pack2by2(A2 vComp, A2Methods_T methods);
+
+/* What pack2by2Measured calls with every block it packs: its place among the
+   blocks and the four pixels it decompresses to */
+typedef void Pack2by2_measure(int col, int row, const struct Pnm_rgb pixels[4],
+                              void *cl);
+A2 pack2by2Measured(A2 vComp, A2Methods_T methods, Pack2by2_measure *measure,
+                    void *cl, int denominator);
+A2 packCodeWords(A2 packArr, A2Methods_T methods);
+A2 unEncode(A2 codeWords, A2Methods_T methods);
+A2 unPack2by2(A2 packArr, A2Methods_T methods);
+uint32_t encodeBlock(const struct vidComp *block);
+void decodeBlock(uint32_t codeWord, struct vidComp *block);
+
+/* The per-block kernels behind the passes above, for bench40 */
+struct pack quantabcd(struct abcd vals);
+struct pack discreteTrans(struct myYs y);
+struct myYs discreteDetrans(struct abcd vals);
+struct abcd unQuantabcd(struct pack quant);
+uint32_t packCodeword(struct fullPack block);
+struct fullPack unPackCodeword(uint32_t codeword);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,659 @@
+/*
+ * codec40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements the in-memory codec40 interface on top of the same stages
+ * compress40 and decompress40 use. Images are parsed from and written to
+ * caller-supplied buffers, and all state lives with the calling thread.
+ * Encoding and decoding of 8-bit pixels go block by block between the pixel
+ * buffer and the codewords, so no raster is built for them; only 16-bit
+ * images are compressed through heap-allocated rasters.
+ */
+
+#include "codec40.h"
+#include "readwrite.h"
+#include "blockPack.h"
+#include <string.h>
+#include <limits.h>
+
+/* The header every compressed image starts with */
+static const char COMP40_MAGIC[] = "COMP40 Compressed image format 2\n";
+
+/* A cursor over a buffer that is being parsed */
+struct cursor {
+        const unsigned char *pos;
+        const unsigned char *end;
+};
+
+/* A parsed image header */
+struct header {
+        unsigned width;
+        unsigned height;
+        unsigned maxval;
+        const unsigned char *data;
+};
+
+/* parseNumber
+ *
+ * Parses one unsigned decimal number, skipping any whitespace and `#`
+ * comments in front of it.
+ *
+ * Parameters
+ *      struct cursor *cur      the cursor to parse from; advanced past the
+ *                              number
+ *      unsigned *num           set to the number that was parsed
+ *
+ * Returns
+ *      bool                    true if a number was parsed, false if the
+ *                              buffer ends or holds something else
+ *
+ * Notes
+ *      Numbers over INT_MAX, the largest dimension an A2Methods array can
+ *      hold, are rejected.
+ */
+static bool parseNumber(struct cursor *cur, unsigned *num)
+{
+        while (cur->pos < cur->end && (*cur->pos == '#' ||
+               *cur->pos == ' ' || *cur->pos == '\t' ||
+               *cur->pos == '\n' || *cur->pos == '\r')) {
+                if (*cur->pos == '#') {
+                        while (cur->pos < cur->end && *cur->pos != '\n') {
+                                cur->pos++;
+                        }
+                } else {
+                        cur->pos++;
+                }
+        }
+
+        unsigned long long value = 0;
+        const unsigned char *start = cur->pos;
+        while (cur->pos < cur->end && *cur->pos >= '0' && *cur->pos <= '9') {
+                value = value * 10 + (*cur->pos - '0');
+                if (value > INT_MAX) {
+                        return false;
+                }
+                cur->pos++;
+        }
+        *num = value;
+        return cur->pos != start;
+}
+
+/* parsePPMHeader
+ *
+ * Parses the header of a raw (P6) PPM held in memory and checks that the
+ * buffer holds all of its pixels.
+ *
+ * Parameters
+ *      const void *ppm         the PPM image
+ *      size_t ppmSize          the number of bytes in ppm
+ *      struct header *hdr      set to the parsed header
+ *
+ * Returns
+ *      bool                    true if ppm is a complete raw PPM; false if
+ *                              not, or if the size of its pixels overflows a
+ *                              size_t
+ */
+static bool parsePPMHeader(const void *ppm, size_t ppmSize, struct header *hdr)
+{
+        if (ppm == NULL || ppmSize < 2) {
+                return false;
+        }
+        struct cursor cur = { ppm, (const unsigned char *)ppm + ppmSize };
+        if (cur.pos[0] != 'P' || cur.pos[1] != '6') {
+                return false;
+        }
+        cur.pos += 2;
+        if (!parseNumber(&cur, &hdr->width) ||
+            !parseNumber(&cur, &hdr->height) ||
+            !parseNumber(&cur, &hdr->maxval) ||
+            hdr->maxval == 0 || hdr->maxval > 65535 || cur.pos == cur.end) {
+                return false;
+        }
+        hdr->data = cur.pos + 1;      /* one whitespace follows the maxval */
+
+        size_t sampleBytes = hdr->maxval < 256 ? 1 : 2;
+        size_t available = cur.end - hdr->data;
+        size_t needed;
+        bool overflow =
+                __builtin_mul_overflow((size_t)hdr->width, hdr->height,
+                                       &needed) ||
+                __builtin_mul_overflow(needed, 3 * sampleBytes, &needed);
+        return !overflow && needed <= available;
+}
+
+/* parseCompressedHeader
+ *
+ * Parses the header of a compressed image held in memory and checks that the
+ * buffer holds all of its codewords.
+ *
+ * Parameters
+ *      const void *comp        the compressed image
+ *      size_t compSize         the number of bytes in comp
+ *      struct header *hdr      set to the parsed header
+ *
+ * Returns
+ *      bool                    true if comp is a complete compressed image
+ */
+static bool parseCompressedHeader(const void *comp, size_t compSize,
+                                  struct header *hdr)
+{
+        size_t magicLen = sizeof(COMP40_MAGIC) - 1;
+        if (comp == NULL || compSize < magicLen ||
+            memcmp(comp, COMP40_MAGIC, magicLen) != 0) {
+                return false;
+        }
+        struct cursor cur = { (const unsigned char *)comp + magicLen,
+                              (const unsigned char *)comp + compSize };
+        if (!parseNumber(&cur, &hdr->width) ||
+            !parseNumber(&cur, &hdr->height) ||
+            cur.pos == cur.end || *cur.pos != '\n') {
+                return false;
+        }
+        hdr->maxval = 255;
+        hdr->data = cur.pos + 1;
+
+        size_t available = cur.end - hdr->data;
+        return (size_t)(hdr->width / 2) * (hdr->height / 2) * 4 <= available;
+}
+
+/* compressedHeaderLength
+ *
+ * Gets the length of the header written for a compressed image.
+ *
+ * Parameters
+ *      unsigned width, height  the (even) dimensions of the image
+ *
+ * Returns
+ *      size_t                  the number of bytes in the header
+ */
+static size_t compressedHeaderLength(unsigned width, unsigned height)
+{
+        return snprintf(NULL, 0, "%s%u %u\n", COMP40_MAGIC, width, height);
+}
+
+/* writeCompressedHeader
+ *
+ * Writes the header of a compressed image.
+ *
+ * Parameters
+ *      void *out               the buffer to write to
+ *      unsigned width, height  the (even) dimensions of the image
+ *
+ * Returns
+ *      size_t                  the number of bytes written; no terminator is
+ *                              written after the header
+ */
+static size_t writeCompressedHeader(void *out, unsigned width, unsigned height)
+{
+        char header[sizeof(COMP40_MAGIC) + 32];
+        size_t headerLen = snprintf(header, sizeof(header), "%s%u %u\n",
+                                    COMP40_MAGIC, width, height);
+        memcpy(out, header, headerLen);
+        return headerLen;
+}
+
+/* ppmHeaderLength
+ *
+ * Gets the length of the header written for a decompressed image.
+ *
+ * Parameters
+ *      unsigned width, height  the dimensions of the image
+ *
+ * Returns
+ *      size_t                  the number of bytes in the header
+ */
+static size_t ppmHeaderLength(unsigned width, unsigned height)
+{
+        return snprintf(NULL, 0, "P6\n%u %u\n255\n", width, height);
+}
+
+/* Codec40_compressed_size
+ *
+ * Get the size of the compressed image Codec40_compress will produce.
+ *
+ * Parameters
+ *      const void *ppm         a raw (P6) PPM image
+ *      size_t ppmSize          the number of bytes in ppm
+ *
+ * Returns
+ *      size_t                  the number of bytes of the compressed image,
+ *                              header included; 0 if ppm is not a valid image
+ *
+ * Notes
+ *      Only the header of ppm is read.
+ */
+extern size_t Codec40_compressed_size(const void *ppm, size_t ppmSize)
+{
+        struct header hdr;
+        if (!parsePPMHeader(ppm, ppmSize, &hdr)) {
+                return 0;
+        }
+        return Codec40_encoded_size(hdr.width, hdr.height);
+}
+
+/* Codec40_decompressed_size
+ *
+ * Get the size of the raw PPM Codec40_decompress will produce.
+ *
+ * Parameters
+ *      const void *comp        a compressed image
+ *      size_t compSize         the number of bytes in comp
+ *
+ * Returns
+ *      size_t                  the number of bytes of the PPM image, header
+ *                              included; 0 if comp is not a valid image
+ *
+ * Notes
+ *      Only the header of comp is read.
+ */
+extern size_t Codec40_decompressed_size(const void *comp, size_t compSize)
+{
+        struct header hdr;
+        if (!parseCompressedHeader(comp, compSize, &hdr)) {
+                return 0;
+        }
+        unsigned width = hdr.width & ~1u;
+        unsigned height = hdr.height & ~1u;
+        return ppmHeaderLength(width, height) + (size_t)width * height * 3;
+}
+
+/* loadPixels
+ *
+ * Copies the pixels of a raw PPM into a new raster, leaving out the last
+ * column and/or row when the width and/or height are odd, so that no separate
+ * trimming pass is needed.
+ *
+ * Parameters
+ *      struct header *hdr      the parsed header of the PPM
+ *      A2Methods_T methods     the methods suite used to create the raster
+ *
+ * Returns
+ *      A2                      a raster of struct Pnm_rgb with even width and
+ *                              height
+ *
+ * Notes
+ *      Allocates memory for the returned raster; it is the responsibility of
+ *      the caller to free it.
+ */
+static A2 loadPixels(struct header *hdr, A2Methods_T methods)
+{
+        unsigned width = hdr->width & ~1u;
+        unsigned height = hdr->height & ~1u;
+        size_t sampleBytes = hdr->maxval < 256 ? 1 : 2;
+        size_t rowBytes = (size_t)hdr->width * 3 * sampleBytes;
+        A2 pixels = methods->new(width, height, sizeof(struct Pnm_rgb));
+
+        for (unsigned row = 0; row < height; row++) {
+                const unsigned char *sample = hdr->data + row * rowBytes;
+                for (unsigned col = 0; col < width; col++) {
+                        unsigned vals[3];
+                        for (int i = 0; i < 3; i++) {
+                                vals[i] = sample[0];
+                                if (sampleBytes == 2) {
+                                        vals[i] = (vals[i] << 8) | sample[1];
+                                }
+                                sample += sampleBytes;
+                        }
+                        struct Pnm_rgb *pixel = methods->at(pixels, col, row);
+                        pixel->red = vals[0];
+                        pixel->green = vals[1];
+                        pixel->blue = vals[2];
+                }
+        }
+        return pixels;
+}
+
+/* Codec40_compress
+ *
+ * Compress a raw PPM image held in memory.
+ *
+ * Parameters
+ *      const void *ppm         a raw (P6) PPM image
+ *      size_t ppmSize          the number of bytes in ppm
+ *      void *out               the buffer the compressed image is written to
+ *      size_t outCapacity      the number of bytes available in out
+ *
+ * Returns
+ *      size_t                  the number of bytes written to out; 0 if ppm
+ *                              is not a valid image or out is too small
+ *
+ * Notes
+ *      An odd width or height is trimmed by one, as compress40 does.
+ *      Images with a maxval below 256 are encoded in place with
+ *      Codec40_encode_from; others go through the rasters of the codec.
+ *      Will CRE if those rasters cannot be allocated; raises
+ *      Alloc40_Over_Budget if they would go over the memory budget.
+ */
+extern size_t Codec40_compress(const void *ppm, size_t ppmSize,
+                               void *out, size_t outCapacity)
+{
+        size_t outSize = Codec40_compressed_size(ppm, ppmSize);
+        if (outSize == 0 || out == NULL || outCapacity < outSize) {
+                return 0;
+        }
+        struct header hdr;
+        parsePPMHeader(ppm, ppmSize, &hdr);
+
+        /* 8-bit pixel data is already an RGB buffer; encode it in place */
+        if (hdr.maxval < 256) {
+                return Codec40_encode_from(hdr.data, hdr.width, hdr.height,
+                                           (size_t)hdr.width * 3, CODEC40_RGB,
+                                           hdr.maxval, out, outCapacity);
+        }
+
+        A2Methods_T methods = uarray2_methods_plain;
+        A2 pixels = loadPixels(&hdr, methods);
+        A2 vComp = RGBtoVC(pixels, methods, hdr.maxval);
+        methods->free(&pixels);
+        A2 codeWords = encode(vComp, methods);
+        methods->free(&vComp);
+
+        size_t headerLen = writeCompressedHeader(out, hdr.width & ~1u,
+                                                 hdr.height & ~1u);
+        writeCodeWords(codeWords, methods, (unsigned char *)out + headerLen);
+        methods->free(&codeWords);
+
+        return outSize;
+}
+
+/* Codec40_encoded_size
+ *
+ * Get the size of the compressed image Codec40_encode_from will produce.
+ *
+ * Parameters
+ *      unsigned width          the width of the source pixels
+ *      unsigned height         the height of the source pixels
+ *
+ * Returns
+ *      size_t                  the number of bytes of the compressed image,
+ *                              header included
+ */
+extern size_t Codec40_encoded_size(unsigned width, unsigned height)
+{
+        width &= ~1u;
+        height &= ~1u;
+        return compressedHeaderLength(width, height) +
+               (size_t)(width / 2) * (height / 2) * sizeof(uint32_t);
+}
+
+/* loadPixel
+ *
+ * Loads one pixel stored in the given 8-bit layout.
+ *
+ * Parameters
+ *      const unsigned char *src
+ *                              the first byte of the pixel
+ *      Codec40_format format   the layout of the source pixels
+ *
+ * Returns
+ *      struct Pnm_rgb          the pixel; any alpha or unused byte is ignored
+ */
+static inline struct Pnm_rgb loadPixel(const unsigned char *src,
+                                       Codec40_format format)
+{
+        struct Pnm_rgb rgb;
+        if (format == CODEC40_BGRX) {
+                rgb.red = src[2];
+                rgb.green = src[1];
+                rgb.blue = src[0];
+        } else {
+                rgb.red = src[0];
+                rgb.green = src[1];
+                rgb.blue = src[2];
+        }
+        return rgb;
+}
+
+/* Codec40_encode_from
+ *
+ * Compress pixels held in a caller-supplied buffer, reading them in place one
+ * 2-by-2 block at a time and without building any intermediate raster.
+ *
+ * Parameters
+ *      const void *pixels      the first byte of the top row of the source
+ *      unsigned width          the width of the source, in pixels
+ *      unsigned height         the height of the source, in pixels
+ *      size_t stride           the number of bytes from the start of one row
+ *                              of the source to the start of the next
+ *      Codec40_format format   the layout of the source pixels
+ *      unsigned maxval         the largest value a sample may take
+ *      void *out               the buffer the compressed image is written to
+ *      size_t outCapacity      the number of bytes available in out
+ *
+ * Returns
+ *      size_t                  the number of bytes written to out; 0 if an
+ *                              argument is invalid or out is too small
+ *
+ * Notes
+ *      Codewords are written in the same byte order printCodeWords uses.
+ *      An odd width or height is trimmed by one, as compress40 does.
+ */
+extern size_t Codec40_encode_from(const void *pixels, unsigned width,
+                                  unsigned height, size_t stride,
+                                  Codec40_format format, unsigned maxval,
+                                  void *out, size_t outCapacity)
+{
+        unsigned pixelBytes = Codec40_bytes_per_pixel(format);
+        size_t outSize = Codec40_encoded_size(width, height);
+        if (pixels == NULL || out == NULL || pixelBytes == 0 ||
+            maxval == 0 || maxval > 255 ||
+            stride < (size_t)width * pixelBytes || outCapacity < outSize) {
+                return 0;
+        }
+        unsigned blocksWide = width / 2;
+        unsigned blocksHigh = height / 2;
+        unsigned char *word = (unsigned char *)out + 
+                        writeCompressedHeader(out, width & ~1u, height & ~1u);
+
+        for (unsigned blockRow = 0; blockRow < blocksHigh; blockRow++) {
+                const unsigned char *top = (const unsigned char *)pixels +
+                                           (size_t)blockRow * 2 * stride;
+                const unsigned char *bottom = top + stride;
+                for (unsigned blockCol = 0; blockCol < blocksWide; blockCol++) {
+                        size_t left = (size_t)blockCol * 2 * pixelBytes;
+                        struct vidComp block[4] = {
+                                toVideoComponent(loadPixel(top + left,
+                                                           format), maxval),
+                                toVideoComponent(loadPixel(top + left +
+                                                           pixelBytes,
+                                                           format), maxval),
+                                toVideoComponent(loadPixel(bottom + left,
+                                                           format), maxval),
+                                toVideoComponent(loadPixel(bottom + left +
+                                                           pixelBytes,
+                                                           format), maxval)
+                        };
+
+                        uint32_t codeWord = encodeBlock(block);
+                        word[0] = codeWord;
+                        word[1] = codeWord >> 8;
+                        word[2] = codeWord >> 16;
+                        word[3] = codeWord >> 24;
+                        word += 4;
+                }
+        }
+        return outSize;
+}
+
+/* Codec40_decompress
+ *
+ * Decompress a compressed image held in memory into a raw PPM with a maxval
+ * of 255.
+ *
+ * Parameters
+ *      const void *comp        a compressed image
+ *      size_t compSize         the number of bytes in comp
+ *      void *out               the buffer the PPM image is written to
+ *      size_t outCapacity      the number of bytes available in out
+ *
+ * Returns
+ *      size_t                  the number of bytes written to out; 0 if comp
+ *                              is not a valid image or out is too small
+ *
+ * Notes
+ *      Decodes straight into out with Codec40_decode_into; allocates nothing.
+ */
+extern size_t Codec40_decompress(const void *comp, size_t compSize,
+                                 void *out, size_t outCapacity)
+{
+        size_t outSize = Codec40_decompressed_size(comp, compSize);
+        if (outSize == 0 || out == NULL || outCapacity < outSize) {
+                return 0;
+        }
+        unsigned width, height;
+        Codec40_dimensions(comp, compSize, &width, &height);
+
+        size_t headerLen = ppmHeaderLength(width, height);
+        char header[48];
+        snprintf(header, sizeof(header), "P6\n%u %u\n255\n", width, height);
+        memcpy(out, header, headerLen);
+        Codec40_decode_into(comp, compSize, (unsigned char *)out + headerLen,
+                            (size_t)width * 3, CODEC40_RGB);
+
+        return outSize;
+}
+
+/* Codec40_bytes_per_pixel
+ *
+ * Get the number of bytes one pixel takes in the given layout.
+ *
+ * Parameters
+ *      Codec40_format format   a pixel layout
+ *
+ * Returns
+ *      unsigned                3 or 4; 0 if format is not a known layout
+ */
+extern unsigned Codec40_bytes_per_pixel(Codec40_format format)
+{
+        switch (format) {
+        case CODEC40_RGB:
+                return 3;
+        case CODEC40_RGBA:
+        case CODEC40_BGRX:
+                return 4;
+        }
+        return 0;
+}
+
+/* Codec40_dimensions
+ *
+ * Get the dimensions of the image a compressed image decodes to.
+ *
+ * Parameters
+ *      const void *comp        a compressed image
+ *      size_t compSize         the number of bytes in comp
+ *      unsigned *width         set to the width of the image, in pixels
+ *      unsigned *height        set to the height of the image, in pixels
+ *
+ * Returns
+ *      int                     1 on success; 0 if comp is not a valid image
+ *
+ * Notes
+ *      Only the header of comp is read.
+ */
+extern int Codec40_dimensions(const void *comp, size_t compSize,
+                              unsigned *width, unsigned *height)
+{
+        struct header hdr;
+        if (width == NULL || height == NULL ||
+            !parseCompressedHeader(comp, compSize, &hdr)) {
+                return 0;
+        }
+        *width = hdr.width & ~1u;
+        *height = hdr.height & ~1u;
+        return 1;
+}
+
+/* storePixel
+ *
+ * Stores one decoded pixel in the given 8-bit layout.
+ *
+ * Parameters
+ *      unsigned char *dst      the first byte of the pixel
+ *      struct Pnm_rgb rgb      the pixel, with a denominator of 255
+ *      Codec40_format format   the layout of the destination pixels
+ *
+ * Returns
+ *      None (void)
+ */
+static inline void storePixel(unsigned char *dst, struct Pnm_rgb rgb,
+                              Codec40_format format)
+{
+        if (format == CODEC40_BGRX) {
+                dst[0] = rgb.blue;
+                dst[1] = rgb.green;
+                dst[2] = rgb.red;
+                dst[3] = 255;
+        } else {
+                dst[0] = rgb.red;
+                dst[1] = rgb.green;
+                dst[2] = rgb.blue;
+                if (format == CODEC40_RGBA) {
+                        dst[3] = 255;
+                }
+        }
+}
+
+/* Codec40_decode_into
+ *
+ * Decompress a compressed image straight into a caller-supplied pixel buffer,
+ * one 2-by-2 block at a time and without building any intermediate raster.
+ *
+ * Parameters
+ *      const void *comp        a compressed image
+ *      size_t compSize         the number of bytes in comp
+ *      void *pixels            the first byte of the top row of the
+ *                              destination
+ *      size_t stride           the number of bytes from the start of one row
+ *                              of the destination to the start of the next
+ *      Codec40_format format   the layout of the destination pixels
+ *
+ * Returns
+ *      int                     1 on success; 0 if comp is not a valid image,
+ *                              pixels is NULL, format is unknown or stride is
+ *                              too small
+ *
+ * Notes
+ *      Codewords are read in the same byte order readCompressed uses.
+ *      Bytes between the end of a row and the next stride are left untouched.
+ */
+extern int Codec40_decode_into(const void *comp, size_t compSize,
+                               void *pixels, size_t stride,
+                               Codec40_format format)
+{
+        struct header hdr;
+        unsigned pixelBytes = Codec40_bytes_per_pixel(format);
+        if (pixels == NULL || pixelBytes == 0 ||
+            !parseCompressedHeader(comp, compSize, &hdr) ||
+            stride < (size_t)(hdr.width & ~1u) * pixelBytes) {
+                return 0;
+        }
+        unsigned blocksWide = hdr.width / 2;
+        unsigned blocksHigh = hdr.height / 2;
+        const unsigned char *word = hdr.data;
+
+        for (unsigned blockRow = 0; blockRow < blocksHigh; blockRow++) {
+                unsigned char *top = (unsigned char *)pixels + 
+                                     (size_t)blockRow * 2 * stride;
+                unsigned char *bottom = top + stride;
+                for (unsigned blockCol = 0; blockCol < blocksWide; blockCol++) {
+                        uint32_t codeWord = (uint32_t)word[0] |
+                                            (uint32_t)word[1] << 8 |
+                                            (uint32_t)word[2] << 16 |
+                                            (uint32_t)word[3] << 24;
+                        word += 4;
+
+                        struct vidComp block[4];
+                        decodeBlock(codeWord, block);
+                        size_t left = (size_t)blockCol * 2 * pixelBytes;
+                        storePixel(top + left, toRGB(block[0], 255), format);
+                        storePixel(top + left + pixelBytes,
+                                   toRGB(block[1], 255), format);
+                        storePixel(bottom + left, toRGB(block[2], 255), format);
+                        storePixel(bottom + left + pixelBytes,
+                                   toRGB(block[3], 255), format);
+                }
+        }
+        return 1;
+}
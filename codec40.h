@@ -0,0 +1,225 @@
+/*
+ * codec40.h
+ * by Rigoberto Rodriguez-Anton (rrodri08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Defines the in-memory interface of the image compressor (libcodec40). It
+ * compresses a raw PPM held in a buffer into a caller-supplied buffer, and
+ * decompresses a compressed image back into a raw PPM the same way. Nothing is
+ * read from stdin or written to stdout, and the functions keep no global
+ * state of their own, so they may be called concurrently from any number of
+ * threads.
+ *
+ * Every function reports a bad argument by returning 0: when the input is not
+ * a valid image, its size overflows, or the output buffer is too small. The
+ * *_size functions give the exact number of bytes the matching call will
+ * write, so callers can size the output buffer up front.
+ *
+ * Running out of memory is not reported by a return value. Only
+ * Codec40_compress allocates, for images with a maxval over 255. It CREs if
+ * an allocation fails, as the rest of the codec does, and raises
+ * Alloc40_Over_Budget (see alloc40.h) if the allocation would go over a
+ * budget set with Alloc40_budget. CII keeps a single exception stack for the
+ * whole process, so a caller that catches either with TRY must not call the
+ * library from several threads at once.
+ *
+ * A thread that codes a stream of same-sized images can reuse the memory of
+ * the intermediate rasters from one image to the next by setting a limit with
+ * Pool40_limit (see pool40.h), which the library includes.
+ */
+
+#ifndef CODEC40_H
+#define CODEC40_H
+
+#include <stddef.h>
+
+/* The layouts of 8-bit pixels in caller-supplied buffers. The X byte of
+ * CODEC40_BGRX and the alpha byte of CODEC40_RGBA are written as 255. */
+typedef enum {
+        CODEC40_RGB,            /* 3 bytes per pixel: red, green, blue */
+        CODEC40_RGBA,           /* 4 bytes per pixel: red, green, blue, alpha */
+        CODEC40_BGRX            /* 4 bytes per pixel: blue, green, red, X */
+} Codec40_format;
+
+/* Codec40_bytes_per_pixel
+ *
+ * Get the number of bytes one pixel takes in the given layout.
+ *
+ * Parameters
+ *      Codec40_format format   a pixel layout
+ *
+ * Returns
+ *      unsigned                3 or 4; 0 if format is not a known layout
+ */
+extern unsigned Codec40_bytes_per_pixel(Codec40_format format);
+
+/* Codec40_compressed_size
+ *
+ * Get the size of the compressed image Codec40_compress will produce.
+ *
+ * Parameters
+ *      const void *ppm         a raw (P6) PPM image
+ *      size_t ppmSize          the number of bytes in ppm
+ *
+ * Returns
+ *      size_t                  the number of bytes of the compressed image,
+ *                              header included; 0 if ppm is not a valid image
+ *
+ * Notes
+ *      Only the header of ppm is read.
+ */
+extern size_t Codec40_compressed_size(const void *ppm, size_t ppmSize);
+
+/* Codec40_compress
+ *
+ * Compress a raw PPM image held in memory.
+ *
+ * Parameters
+ *      const void *ppm         a raw (P6) PPM image
+ *      size_t ppmSize          the number of bytes in ppm
+ *      void *out               the buffer the compressed image is written to
+ *      size_t outCapacity      the number of bytes available in out
+ *
+ * Returns
+ *      size_t                  the number of bytes written to out; 0 if ppm
+ *                              is not a valid image or out is too small
+ *
+ * Notes
+ *      An odd width or height is trimmed by one, as compress40 does.
+ *      Will CRE if the image has a maxval over 255 and its rasters cannot be
+ *      allocated; raises Alloc40_Over_Budget if they would go over the
+ *      memory budget.
+ */
+extern size_t Codec40_compress(const void *ppm, size_t ppmSize,
+                               void *out, size_t outCapacity);
+
+/* Codec40_decompressed_size
+ *
+ * Get the size of the raw PPM Codec40_decompress will produce.
+ *
+ * Parameters
+ *      const void *comp        a compressed image
+ *      size_t compSize         the number of bytes in comp
+ *
+ * Returns
+ *      size_t                  the number of bytes of the PPM image, header
+ *                              included; 0 if comp is not a valid image
+ *
+ * Notes
+ *      Only the header of comp is read.
+ */
+extern size_t Codec40_decompressed_size(const void *comp, size_t compSize);
+
+/* Codec40_decompress
+ *
+ * Decompress a compressed image held in memory into a raw PPM with a maxval
+ * of 255.
+ *
+ * Parameters
+ *      const void *comp        a compressed image
+ *      size_t compSize         the number of bytes in comp
+ *      void *out               the buffer the PPM image is written to
+ *      size_t outCapacity      the number of bytes available in out
+ *
+ * Returns
+ *      size_t                  the number of bytes written to out; 0 if comp
+ *                              is not a valid image or out is too small
+ */
+extern size_t Codec40_decompress(const void *comp, size_t compSize,
+                                 void *out, size_t outCapacity);
+
+/* Codec40_encoded_size
+ *
+ * Get the size of the compressed image Codec40_encode_from will produce.
+ *
+ * Parameters
+ *      unsigned width          the width of the source pixels
+ *      unsigned height         the height of the source pixels
+ *
+ * Returns
+ *      size_t                  the number of bytes of the compressed image,
+ *                              header included
+ */
+extern size_t Codec40_encoded_size(unsigned width, unsigned height);
+
+/* Codec40_encode_from
+ *
+ * Compress pixels held in a caller-supplied buffer, such as a frame in a
+ * shared-memory ring buffer, reading them in place one 2-by-2 block at a time
+ * and without building a Pnm_ppm or any intermediate raster.
+ *
+ * Parameters
+ *      const void *pixels      the first byte of the top row of the source
+ *      unsigned width          the width of the source, in pixels
+ *      unsigned height         the height of the source, in pixels
+ *      size_t stride           the number of bytes from the start of one row
+ *                              of the source to the start of the next; at
+ *                              least width times the bytes per pixel
+ *      Codec40_format format   the layout of the source pixels
+ *      unsigned maxval         the largest value a sample may take, between 1
+ *                              and 255; usually 255
+ *      void *out               the buffer the compressed image is written to
+ *      size_t outCapacity      the number of bytes available in out
+ *
+ * Returns
+ *      size_t                  the number of bytes written to out; 0 if an
+ *                              argument is invalid or out is too small
+ *
+ * Notes
+ *      An odd width or height is trimmed by one, as compress40 does.
+ *      Samples must not exceed maxval.
+ */
+extern size_t Codec40_encode_from(const void *pixels, unsigned width,
+                                  unsigned height, size_t stride,
+                                  Codec40_format format, unsigned maxval,
+                                  void *out, size_t outCapacity);
+
+/* Codec40_dimensions
+ *
+ * Get the dimensions of the image a compressed image decodes to.
+ *
+ * Parameters
+ *      const void *comp        a compressed image
+ *      size_t compSize         the number of bytes in comp
+ *      unsigned *width         set to the width of the image, in pixels
+ *      unsigned *height        set to the height of the image, in pixels
+ *
+ * Returns
+ *      int                     1 on success; 0 if comp is not a valid image
+ *
+ * Notes
+ *      Only the header of comp is read.
+ */
+extern int Codec40_dimensions(const void *comp, size_t compSize,
+                              unsigned *width, unsigned *height);
+
+/* Codec40_decode_into
+ *
+ * Decompress a compressed image straight into a caller-supplied pixel buffer,
+ * such as a framebuffer or a shared-memory image, one 2-by-2 block at a time
+ * and without building any intermediate raster.
+ *
+ * Parameters
+ *      const void *comp        a compressed image
+ *      size_t compSize         the number of bytes in comp
+ *      void *pixels            the first byte of the top row of the
+ *                              destination; must hold Codec40_dimensions'
+ *                              width by height pixels
+ *      size_t stride           the number of bytes from the start of one row
+ *                              of the destination to the start of the next;
+ *                              at least width times the bytes per pixel
+ *      Codec40_format format   the layout of the destination pixels
+ *
+ * Returns
+ *      int                     1 on success; 0 if comp is not a valid image,
+ *                              pixels is NULL, format is unknown or stride is
+ *                              too small
+ *
+ * Notes
+ *      Bytes between the end of a row and the next stride are left untouched.
+ */
+extern int Codec40_decode_into(const void *comp, size_t compSize,
+                               void *pixels, size_t stride,
+                               Codec40_format format);
+
+#endif
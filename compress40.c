@@ -11,13 +11,50 @@
 #include "pnm.h"
 #include "a2methods.h"
 #include "a2plain.h"
+#include "uarray2.h"
 #include "readwrite.h"
 #include "blockPack.h"
 #include "bitpack.h"
+#include "stats40.h"
+#include "locality40.h"
+#include "trace40.h"
+#include "alloc40.h"
+#include "diff40.h"
+#include "kernels40.h"
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+
+/* The statistics each stage is timed into; NULL unless enabled with
+   compress40_stats */
+static Stats40_T stats = NULL;
+
+/* The methods suite every raster is created with; NULL means the default,
+   uarray2_methods_plain, which cannot be a static initializer */
+static A2Methods_T chosenMethods = NULL;
+
+/* Whether to study a sample of each image for the fastest backend and map
+   orders, and the plan that study found for the image being processed */
+static bool autotune = false;
+static Locality40_T plan = NULL;
+
+/* The most pixels of an image the autotuning study runs on, and the fewest
+   an image must have to be worth studying: the study times some forty stage
+   runs on the sample, which only pays for itself on a much larger image */
+#define SAMPLE_PIXELS (1 << 16)
+#define TUNE_MIN_PIXELS (1 << 24)
+
+/* Whether to print the error the compressed image will decompress with */
+static bool reportError = false;
+
+/* The image being compressed and the comparison of it with its blocks, for
+   measuring that error */
+struct errorCl {
+        Pnm_ppm image;
+        Diff40_T diff;
+};
 
 /*A struct to hold the dimensions and pixels of a trimmed pixel raster
   that will be used to replace the original pixel raster*/
@@ -60,6 +97,11 @@ void applyTrim(int col, int row, A2 uarray2, void *element, void *cl)
 }
 
 
+/* The per-pixel operation of trim, specialized for each backend by
+   kernels40.h */
+#define TRIM(in, out, unused) (*(out) = *(in))
+KERNELS40_MAP(trim, struct Pnm_rgb, struct Pnm_rgb, TRIM)
+
  /* trim
   * 
   * Trims the height and/or width of a PPM image so that the resulting image has
@@ -75,6 +117,9 @@ void applyTrim(int col, int row, A2 uarray2, void *element, void *cl)
   *      Will CRE if image is NULL.
   *      No effect on image if both height and width are even. In the case where
   *      no trimming is needed, a pointer to the original image is returned. 
+  *      A plain UArray2 raster is cropped in place in constant time; any other
+  *      raster is copied into a new, smaller one, by the specialization of
+  *      kernels40.h for blocked suites.
   *      
   */
 void trim(Pnm_ppm *image, A2Methods_T methods)
@@ -92,15 +137,27 @@ void trim(Pnm_ppm *image, A2Methods_T methods)
                 sizechange = true;
         }
         
-        if (sizechange == true)
+        /* any suite built on the plain UArray2, whatever its map order */
+        if (sizechange == true && methods->at == uarray2_methods_plain->at)
+        {
+                /* narrow the plain raster in place; no pixel is copied */
+                UArray2_crop((*image)->pixels, 0, 0, width, height);
+                (*image)->width = width;
+                (*image)->height = height;
+        }
+        else if (sizechange == true)
         {
                 A2 newVelociraster = 
                             methods->new(width, height, sizeof(struct Pnm_rgb));
-                struct trimInfo trimInfo;
-                trimInfo.oldPixels = (*image)->pixels;
-                trimInfo.methods = methods;
-                
-                methods->map_default(newVelociraster, applyTrim, &trimInfo);
+                if (!trimKernel((*image)->pixels, newVelociraster, methods,
+                                0)) {
+                        struct trimInfo trimInfo;
+                        trimInfo.oldPixels = (*image)->pixels;
+                        trimInfo.methods = methods;
+
+                        methods->map_default(newVelociraster, applyTrim,
+                                             &trimInfo);
+                }
                 methods->free(&(*image)->pixels);
                 (*image)->pixels = newVelociraster;
                 (*image)->width = width;
@@ -109,55 +166,498 @@ void trim(Pnm_ppm *image, A2Methods_T methods)
 }
 
 
- /* compress40
+ /* rasterBytes
   * 
-  * Compresses a valid PPM image given from a filename or `stdin`
+  * Gets the number of bytes of element data held by a raster.
   * 
   * Parameters
-  *      FILE *input    a file pointer to a valid PPM image
+  *      A2 raster              a 2D array
+  *      A2Methods_T methods    the methods suite of the raster
+  *
+  * Returns
+  *      size_t                 width times height times element size
+  */
+static size_t rasterBytes(A2 raster, A2Methods_T methods)
+{
+        return (size_t)methods->width(raster) * methods->height(raster) *
+               methods->size(raster);
+}
+
+ /* compress40_stats
+  * 
+  * Turns timing of every stage of compress40 and decompress40 on or off.
+  * 
+  * Parameters
+  *      Stats40_T newStats     the statistics to time stages into, or NULL to
+  *                             stop timing
+  *
+  * Returns
+  *      None (void)
+  */
+extern void compress40_stats(Stats40_T newStats)
+{
+        stats = newStats;
+}
+
+ /* compress40_methods
+  * 
+  * Chooses the A2Methods suite, and so the raster layout, that compress40,
+  * compress40_rows and decompress40 use.
+  * 
+  * Parameters
+  *      A2Methods_T methods    the suite to use, or NULL for the default
+  *                             (uarray2_methods_plain)
   *
   * Returns
   *      None (void)
   *
   * Notes
-  *     Will CRE if input is NULL.
-  *     Will CRE if methods used to manipulate arrays is NULL.
-  *     Allocates memory for and frees memory for a Pnm_ppm struct.
+  *      The output does not depend on the suite.
+  */
+extern void compress40_methods(A2Methods_T methods)
+{
+        chosenMethods = methods;
+}
+
+ /* codecMethods
+  * 
+  * Gets the A2Methods suite chosen with compress40_methods.
+  * 
+  * Returns
+  *      A2Methods_T            the chosen suite, or uarray2_methods_plain
+  */
+static A2Methods_T codecMethods(void)
+{
+        return chosenMethods != NULL ? chosenMethods : uarray2_methods_plain;
+}
+
+ /* beginStage
+  * 
+  * Starts timing and tracing one stage, and counts the memory it allocates
+  * under its name.
+  * 
+  * Parameters
+  *      const char *stage      the name of the stage; "read" and "write" are
+  *                             traced as I/O
+  *
+  * Returns
+  *      None (void)
+  */
+static void beginStage(const char *stage)
+{
+        bool io = strcmp(stage, "read") == 0 || strcmp(stage, "write") == 0;
+        Trace40_begin(io ? "io" : "stage", stage);
+        Alloc40_tag(stage);
+        Stats40_start(stats, stage);
+}
+
+ /* endStage
+  * 
+  * Stops timing and tracing the stage begun last.
+  * 
+  * Parameters
+  *      size_t pixels          the number of image pixels the stage processed
+  *      size_t bytes           the number of bytes the stage produced
+  *
+  * Returns
+  *      None (void)
+  */
+static void endStage(size_t pixels, size_t bytes)
+{
+        Stats40_stop(stats, pixels, bytes);
+        Trace40_end();
+}
+
+ /* compress40_autotune
+  * 
+  * Turns autotuning of the backend and map orders on or off.
+  * 
+  * Parameters
+  *      bool on                true to study a sample of every image for the
+  *                             fastest backend and map order of each stage
+  *                             before processing it
+  *
+  * Returns
+  *      None (void)
+  *
+  * Notes
+  *      Overrides compress40_methods while on. The output does not change.
+  */
+extern void compress40_autotune(bool on)
+{
+        autotune = on;
+}
+
+ /* compress40_report_error
+  * 
+  * Turns reporting of the error of every compressed image on or off.
+  * 
+  * Parameters
+  *      bool on                true to print, to `stderr`, the difference
+  *                             ppmdiff would find between every image
+  *                             compressed and its decompression
+  *
+  * Returns
+  *      None (void)
+  */
+extern void compress40_report_error(bool on)
+{
+        reportError = on;
+}
+
+ /* stageMethods
+  * 
+  * Gets the methods suite a stage should run with.
+  * 
+  * Parameters
+  *      Locality40_stage stage the stage
+  *      A2Methods_T methods    the suite to use when not autotuning
+  *
+  * Returns
+  *      A2Methods_T            the suite the plan chose for the stage, or
+  *                             methods if there is no plan
+  */
+static A2Methods_T stageMethods(Locality40_stage stage, A2Methods_T methods)
+{
+        return plan != NULL ? Locality40_methods(plan, stage) : methods;
+}
+
+ /* sampleHeight
+  * 
+  * Gets how many rows of an image the autotuning study should run on.
+  * 
+  * Parameters
+  *      unsigned width         the width of the image
+  *      unsigned height        the height of the image
+  *
+  * Returns
+  *      unsigned               an even number of rows, at most height, that
+  *                             holds about SAMPLE_PIXELS pixels; 0 if the image
+  *                             has fewer than TUNE_MIN_PIXELS pixels
+  */
+static unsigned sampleHeight(unsigned width, unsigned height)
+{
+        if ((size_t)width * height < TUNE_MIN_PIXELS) {
+                return 0;
+        }
+        unsigned rows = SAMPLE_PIXELS / width;
+        if (rows < 2) {
+                rows = 2;
+        }
+        if (rows > height) {
+                rows = height;
+        }
+        return rows & ~1u;
+}
+
+ /* tuneCompress
+  * 
+  * Studies the top rows of an image for the fastest way to compress it, and
+  * moves the image's raster into the backend chosen.
+  * 
+  * Parameters
+  *      Pnm_ppm image          an image held in a plain UArray2
+  *
+  * Returns
+  *      None (void)
+  *
+  * Notes
+  *      Sets plan; leaves it NULL for an image too small to study.
+  *      The study reads the image through a view, so it copies nothing it
+  *      does not time.
+  */
+static void tuneCompress(Pnm_ppm image)
+{
+        unsigned rows = sampleHeight(image->width, image->height);
+        if (rows == 0) {
+                return;
+        }
+        struct Pnm_ppm sample = *image;
+        sample.height = rows;
+        sample.pixels = UArray2_view(image->pixels, 0, 0, image->width, rows);
+        plan = Locality40_study(&sample, LOCALITY40_TRIM, LOCALITY40_ENCODE,
+                                1, NULL);
+        UArray2_free((UArray2_T *)&sample.pixels);
+
+        A2Methods_T methods = Locality40_methods(plan, LOCALITY40_TRIM);
+        if (methods->at != image->methods->at) {
+                A2 moved = Locality40_copy(image->pixels, image->methods,
+                                           methods);
+                image->methods->free(&image->pixels);
+                image->pixels = moved;
+        }
+        image->methods = methods;
+}
+
+ /* tuneDecompress
+  * 
+  * Studies a synthetic image as wide as a compressed one for the fastest way
+  * to decompress it, and moves the codewords into the backend chosen.
+  * 
+  * Parameters
+  *      A2 *codeWords          the address of the codewords, held in a plain
+  *                             UArray2; replaced if they are moved
+  *
+  * Returns
+  *      None (void)
+  *
+  * Notes
+  *      Sets plan; leaves it NULL for an image too small to study.
+  *      No pixels are available before decompressing, so the sample is a
+  *      gradient; the stages do the same work whatever the pixel values.
+  */
+static void tuneDecompress(A2 *codeWords)
+{
+        A2Methods_T plain = uarray2_methods_plain;
+        unsigned width = plain->width(*codeWords) * 2;
+        unsigned rows = sampleHeight(width, plain->height(*codeWords) * 2);
+        if (rows == 0) {
+                return;
+        }
+        struct Pnm_ppm sample = {width, rows, 255, NULL, plain};
+        sample.pixels = plain->new(width, rows, sizeof(struct Pnm_rgb));
+        for (unsigned row = 0; row < rows; row++) {
+                for (unsigned col = 0; col < width; col++) {
+                        struct Pnm_rgb *pixel = plain->at(sample.pixels, col,
+                                                          row);
+                        pixel->red = col * 255 / width;
+                        pixel->green = row * 255 / rows;
+                        pixel->blue = 128;
+                }
+        }
+        plan = Locality40_study(&sample, LOCALITY40_UNENCODE,
+                                LOCALITY40_VCTORGB, 1, NULL);
+        plain->free(&sample.pixels);
+
+        A2Methods_T methods = Locality40_methods(plan, LOCALITY40_UNENCODE);
+        if (methods->at != plain->at) {
+                A2 moved = Locality40_copy(*codeWords, plain, methods);
+                plain->free(codeWords);
+                *codeWords = moved;
+        }
+}
+
+ /* compareBlock
+  * 
+  * Compares the pixels of one block of an image with those it decompresses
+  * to, as pack2by2Measured packs it.
+  * 
+  * Parameters
+  *      int col, row           the place of the block among the blocks
+  *      const struct Pnm_rgb pixels[4]
+  *                             the top-left, top-right, bottom-left and
+  *                             bottom-right pixels it decompresses to
+  *      void *cl               the struct errorCl of the image
+  *
+  * Returns
+  *      None (void)
+  *
+  * Notes
+  *      Each block is compared as an image two pixels wide and two high; the
+  *      squares are summed exactly, so E of all of them is the same, to the
+  *      last bit, as ppmdiff gives for the whole image.
+  */
+static void compareBlock(int col, int row, const struct Pnm_rgb pixels[4],
+                         void *cl)
+{
+        struct errorCl *error = cl;
+        A2Methods_T methods = error->image->methods;
+        A2 original = error->image->pixels;
+        struct Pnm_rgb top[2] = {
+                *(struct Pnm_rgb *)methods->at(original, 2 * col, 2 * row),
+                *(struct Pnm_rgb *)methods->at(original, 2 * col + 1, 2 * row)
+        };
+        struct Pnm_rgb bottom[2] = {
+                *(struct Pnm_rgb *)methods->at(original, 2 * col, 2 * row + 1),
+                *(struct Pnm_rgb *)methods->at(original, 2 * col + 1,
+                                               2 * row + 1)
+        };
+        const struct Pnm_rgb *rows1[2] = { top, bottom };
+        const struct Pnm_rgb *rows2[2] = { pixels, pixels + 2 };
+        Diff40_rows(error->diff, rows1, rows2, 2);
+}
+
+ /* compressImage
+  * 
+  * Compresses an image that has already been read into memory and prints the
+  * result to `stdout`
+  * 
+  * Parameters
+  *      Pnm_ppm image          the image to be compressed
+  *      A2Methods_T methods    the methods suite of the image's raster
+  *
+  * Returns
+  *      None (void)
+  *
+  * Notes
+  *     Will CRE if image or methods are NULL.
   *     Allocates memory for and frees memory for A2 vComp.
   *     Allocates memory for and frees memory for A2 codeWords.
-  *     Prints to `stdout`.
+  *     Frees the given image.
+  *     Prints to `stdout`, and the error of the image to `stderr` if
+  *     compress40_report_error is on.
   *      
   */
-extern void compress40(FILE *input)
+static void compressImage(Pnm_ppm image, A2Methods_T methods)
 {
-        assert(input != NULL);
-        /* default to UArray2 methods */
-        A2Methods_T methods = uarray2_methods_plain;
+        assert(image != NULL);
         assert(methods != NULL);
 
-        /* Reading the given image */
-        Pnm_ppm image = Pnm_ppmread(input, methods);
-
         /* trimmng the image to an even height and/or width */
-        trim(&image, methods);
+        beginStage("trim");
+        trim(&image, stageMethods(LOCALITY40_TRIM, methods));
+        size_t pixels = (size_t)image->width * image->height;
+        endStage(pixels, rasterBytes(image->pixels, methods));
 
         /* converting the image to video component */
-        A2 vComp = RGBtoVC(image->pixels, methods, image->denominator);
+        beginStage("RGBtoVC");
+        A2 vComp = RGBtoVC(image->pixels,
+                           stageMethods(LOCALITY40_RGBTOVC, methods),
+                           image->denominator);
+        endStage(pixels, rasterBytes(vComp, methods));
 
         /* 
          * prepares video component values to be packed into a 32-bit word and
          * packs a, b, c, d, pb, pr into 32-bit codewords
          */
-        A2 codeWords = encode(vComp, methods);
+        beginStage("pack2by2");
+        A2Methods_T packMethods = stageMethods(LOCALITY40_PACK2BY2, methods);
+        A2 packArr;
+        double error = 0;
+        if (reportError) {
+                struct errorCl measured = {
+                        image, Diff40_new(2, image->denominator, 255, 1)
+                };
+                packArr = pack2by2Measured(vComp, packMethods, compareBlock,
+                                           &measured, 255);
+                error = Diff40_rmse(measured.diff);
+                Diff40_free(&measured.diff);
+        } else {
+                packArr = pack2by2(vComp, packMethods);
+        }
+        endStage(pixels, rasterBytes(packArr, methods));
         methods->free(&vComp);
 
+        beginStage("encode");
+        A2 codeWords = packCodeWords(packArr,
+                                     stageMethods(LOCALITY40_ENCODE, methods));
+        endStage(pixels, rasterBytes(codeWords, methods));
+        methods->free(&packArr);
+
         /* prints the header and codewords of the compressed image to `stdout`*/
-        fprintf(stdout, "COMP40 Compressed image format 2\n%u %u\n", 
-                                                   image->width, image->height);
+        beginStage("write");
+        int headerLen = fprintf(stdout, 
+                                "COMP40 Compressed image format 2\n%u %u\n", 
+                                image->width, image->height);
         printCodeWords(codeWords, methods);
+        fflush(stdout);
+        endStage(pixels, headerLen + rasterBytes(codeWords, methods));
+        if (reportError) {
+                fprintf(stderr, "Diff is: %.4f\n", error);
+        }
 
         methods->free(&codeWords);
         Pnm_ppmfree(&image);
+        if (plan != NULL) {
+                Locality40_free(&plan);
+        }
+}
+
+ /* compress40
+  * 
+  * Compresses a valid PPM image given from a filename or `stdin`
+  * 
+  * Parameters
+  *      FILE *input    a file pointer to a valid PPM image
+  *
+  * Returns
+  *      None (void)
+  *
+  * Notes
+  *     Will CRE if input is NULL.
+  *     Will CRE if methods used to manipulate arrays is NULL.
+  *     Allocates memory for and frees memory for a Pnm_ppm struct.
+  *     Prints to `stdout`.
+  *      
+  */
+extern void compress40(FILE *input)
+{
+        assert(input != NULL);
+        /* default to UArray2 methods */
+        A2Methods_T methods = autotune ? uarray2_methods_plain :
+                                         codecMethods();
+        assert(methods != NULL);
+        Trace40_begin("run", "compress40");
+
+        /* Reading the given image */
+        beginStage("read");
+        Pnm_ppm image = Pnm_ppmread(input, methods);
+        endStage((size_t)image->width * image->height,
+                 rasterBytes(image->pixels, methods));
+
+        if (autotune) {
+                beginStage("tune");
+                tuneCompress(image);
+                endStage((size_t)image->width * image->height,
+                         rasterBytes(image->pixels, image->methods));
+        }
+        compressImage(image, image->methods);
+        Trace40_end();
+}
+
+ /* compress40_rows
+  * 
+  * Compresses only the pixel rows [first, last) of a raw PPM image given from
+  * a filename or `stdin`. The output is itself a valid compressed image of
+  * that band, so shards covering consecutive bands can be joined into the
+  * compressed whole image with 40merge.
+  * 
+  * Parameters
+  *      FILE *input    a file pointer to a valid raw (P6) PPM image
+  *      unsigned first the first pixel row of the band; must be even
+  *      unsigned last  one past the last pixel row of the band; clipped to the
+  *                     height of the image
+  *
+  * Returns
+  *      None (void)
+  *
+  * Notes
+  *     Will CRE if input is NULL or first is odd.
+  *     Will CRE if the band is empty, or if it holds an odd number of rows
+  *     without reaching the bottom of the image (that row would be trimmed
+  *     away and the merged image would be missing it).
+  *     Only the rows of the band are held in memory.
+  *     Prints to `stdout`.
+  *      
+  */
+extern void compress40_rows(FILE *input, unsigned first, unsigned last)
+{
+        assert(input != NULL);
+        assert(!(first & 1));
+        /* default to UArray2 methods */
+        A2Methods_T methods = autotune ? uarray2_methods_plain :
+                                         codecMethods();
+        assert(methods != NULL);
+        char band[32];
+        snprintf(band, sizeof(band), "band %u:%u", first, last);
+        Trace40_begin("band", band);
+
+        /* Reading only the requested band of the given image */
+        unsigned fullHeight;
+        beginStage("read");
+        Pnm_ppm image = readPPMRows(input, methods, first, last, &fullHeight);
+        endStage((size_t)image->width * image->height,
+                 rasterBytes(image->pixels, methods));
+        assert(!(image->height & 1) || first + image->height == fullHeight);
+
+        if (autotune) {
+                beginStage("tune");
+                tuneCompress(image);
+                endStage((size_t)image->width * image->height,
+                         rasterBytes(image->pixels, image->methods));
+        }
+        compressImage(image, image->methods);
+        Trace40_end();
 }
 
  /* decompress40
@@ -184,27 +684,89 @@ extern void decompress40(FILE *input)
 {
         assert(input != NULL);
         /* default to UArray2 methods */
-        A2Methods_T methods = uarray2_methods_plain;
+        A2Methods_T methods = autotune ? uarray2_methods_plain :
+                                         codecMethods();
         assert(methods != NULL);
+        Trace40_begin("run", "decompress40");
 
         /* Reading the given compressed image */
+        beginStage("read");
         A2 codeWords = readCompressed(input, methods);
 
         /* initialize an array and PPM struct to hold the unpacked raster */
         unsigned width = methods->width(codeWords) * 2;
         unsigned height = methods->height(codeWords) * 2;
         struct Pnm_ppm image = {width, height, 255, codeWords, methods};
+        size_t pixels = (size_t)width * height;
+        endStage(pixels, rasterBytes(codeWords, methods));
+
+        if (autotune) {
+                beginStage("tune");
+                tuneDecompress(&codeWords);
+                endStage(pixels, rasterBytes(codeWords, methods));
+                methods = stageMethods(LOCALITY40_UNENCODE, methods);
+                image.methods = methods;
+        }
 
         /* Convert from compressed codewords to video components */
-        A2 vComp = decode(codeWords, methods);
+        beginStage("unEncode");
+        A2 packArr = unEncode(codeWords,
+                              stageMethods(LOCALITY40_UNENCODE, methods));
+        endStage(pixels, rasterBytes(packArr, methods));
         methods->free(&codeWords);
 
+        beginStage("unPack2by2");
+        A2 vComp = unPack2by2(packArr,
+                              stageMethods(LOCALITY40_UNPACK2BY2, methods));
+        endStage(pixels, rasterBytes(vComp, methods));
+        methods->free(&packArr);
+
         /* converting the image to RGB */
-        image.pixels = VCtoRGB(vComp, methods, image.denominator);
+        beginStage("VCtoRGB");
+        image.pixels = VCtoRGB(vComp, stageMethods(LOCALITY40_VCTORGB, methods),
+                               image.denominator);
+        endStage(pixels, rasterBytes(image.pixels, methods));
         methods->free(&vComp);
 
         /* writes the decompressed image to `stdout`*/
+        beginStage("write");
         Pnm_ppmwrite(stdout, (struct Pnm_ppm *)&image);
+        fflush(stdout);
+        int headerLen = snprintf(NULL, 0, "P6\n%u %u\n%u\n", width, height,
+                                 image.denominator);
+        endStage(pixels, headerLen + pixels * 3);
         methods->free(&(image.pixels));
+        if (plan != NULL) {
+                Locality40_free(&plan);
+        }
+        Trace40_end();
 }
 
+ /* compress40_study
+  * 
+  * Times every stage of compressing and decompressing a PPM image given from
+  * a filename or `stdin` under every backend and map order, and prints the
+  * times, cache misses and fastest plan to `stdout`.
+  * 
+  * Parameters
+  *      FILE *input    a file pointer to a valid PPM image
+  *
+  * Returns
+  *      None (void)
+  *
+  * Notes
+  *     Will CRE if input is NULL.
+  *     Each combination is timed three times and the fastest time kept.
+  *     The whole image is studied, so this needs several copies of it in
+  *     memory.
+  */
+extern void compress40_study(FILE *input)
+{
+        assert(input != NULL);
+        A2Methods_T methods = uarray2_methods_plain;
+        Pnm_ppm image = Pnm_ppmread(input, methods);
+        Locality40_T fastest = Locality40_study(image, LOCALITY40_TRIM,
+                                                LOCALITY40_VCTORGB, 3, stdout);
+        Locality40_free(&fastest);
+        Pnm_ppmfree(&image);
+}
@@ -0,0 +1,47 @@
+/*
+ * compress40.h
+ * by Rigoberto Rodriguez-Anton (rrodri08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Defines the public entry points of the image compressor. compress40 and
+ * decompress40 take their input from the given file and write their output to
+ * stdout. compress40_rows compresses only a horizontal band of the image so
+ * that a very large image can be split into shards which are compressed
+ * separately and later joined back together with 40merge. compress40_stats
+ * turns on the per-stage timing behind `40image --stats`, and
+ * compress40_methods picks the raster layout behind `40image --methods`.
+ * compress40_autotune and compress40_study are behind `--methods auto` and
+ * `--study`: they time every stage under every backend and map order (see
+ * locality40.h), to pick the fastest or to report them all.
+ */
+
+#ifndef COMPRESS40_H
+#define COMPRESS40_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "a2methods.h"
+#include "stats40.h"
+
+extern void compress40  (FILE *input);  /* reads PPM, writes compressed image */
+extern void decompress40(FILE *input);  /* reads compressed image, writes PPM */
+
+/* reads pixel rows [first, last) of a PPM, writes a compressed shard */
+extern void compress40_rows(FILE *input, unsigned first, unsigned last);
+
+/* times every stage of the calls above into stats; NULL turns timing off */
+extern void compress40_stats(Stats40_T stats);
+
+/* builds every raster with methods; NULL restores uarray2_methods_plain */
+extern void compress40_methods(A2Methods_T methods);
+
+/* prints to stderr the difference ppmdiff would find after decompressing */
+extern void compress40_report_error(bool on);
+
+/* studies a sample of each image for the fastest backend and map orders */
+extern void compress40_autotune(bool on);
+
+/* reads PPM, prints the time of each stage under each backend and order */
+extern void compress40_study(FILE *input);
+
+#endif
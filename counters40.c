@@ -0,0 +1,252 @@
+/*
+ * counters40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements Counters40_T with the Linux perf_event_open system call. Each
+ * counter is opened on its own rather than as a group, so that one counter
+ * the hardware lacks (often the TLB one) does not take the others with it.
+ * On other systems, or when the kernel refuses (perf_event_paranoid,
+ * seccomp in containers), every counter is simply unavailable.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "assert.h"
+#include "mem.h"
+
+#include "counters40.h"
+
+#define T Counters40_T
+
+/* struct Counters40_T
+ *
+ * Holds private data for each set of counters.
+ *
+ * Components
+ *      int fds[]       the file descriptor of each counter; -1 if the
+ *                      counter is unavailable
+ */
+struct T {
+        int fds[COUNTERS40_NUM];
+};
+
+/* The names of the counters, in index order */
+static const char *const NAMES[COUNTERS40_NUM] = {
+        "cycles", "instructions", "cache-misses", "dTLB-misses",
+        "branch-misses"
+};
+
+#ifdef __linux__
+/* openCounter
+ *
+ * Open one counter for the calling thread, on any CPU, user space only.
+ *
+ * Parameters
+ *      uint32_t type   the perf event type
+ *      uint64_t config the perf event config
+ *
+ * Returns
+ *      int             the file descriptor of the counter; -1 on failure
+ */
+static int openCounter(uint32_t type, uint64_t config)
+{
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/* Counters40_new
+ *
+ * Open every counter that is available to the calling thread.
+ *
+ * Returns
+ *      T               the created counters, stopped
+ *
+ * Notes
+ *      Allocates memory; it is the responsibility of the client to free it
+ *      with Counters40_free().
+ */
+extern T Counters40_new(void)
+{
+        T counters;
+        NEW(counters);
+        for (int i = 0; i < COUNTERS40_NUM; i++) {
+                counters->fds[i] = -1;
+        }
+#ifdef __linux__
+        counters->fds[COUNTERS40_CYCLES] =
+                openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        counters->fds[COUNTERS40_INSTRUCTIONS] =
+                openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        counters->fds[COUNTERS40_CACHE_MISSES] =
+                openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+        counters->fds[COUNTERS40_DTLB_MISSES] =
+                openCounter(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                            PERF_COUNT_HW_CACHE_OP_READ << 8 |
+                            PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        counters->fds[COUNTERS40_BRANCH_MISSES] =
+                openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+        return counters;
+}
+
+/* Counters40_free
+ *
+ * Close the counters and deallocate them.
+ *
+ * Parameters
+ *      T *counters     the address of the counters to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `counters` or `*counters` is NULL.
+ *      Sets `*counters` to NULL.
+ */
+extern void Counters40_free(T *counters)
+{
+        assert(counters != NULL && *counters != NULL);
+        for (int i = 0; i < COUNTERS40_NUM; i++) {
+                if ((*counters)->fds[i] >= 0) {
+                        close((*counters)->fds[i]);
+                }
+        }
+        FREE(*counters);
+}
+
+/* Counters40_available
+ *
+ * Tell whether one counter could be opened.
+ *
+ * Parameters
+ *      T counters      a set of counters
+ *      int which       the index of the counter, such as COUNTERS40_CYCLES
+ *
+ * Returns
+ *      bool            true if the counter reports real values
+ *
+ * Notes
+ *      Will CRE if `counters` is NULL or `which` is out of range.
+ */
+extern bool Counters40_available(T counters, int which)
+{
+        assert(counters != NULL);
+        assert(which >= 0 && which < COUNTERS40_NUM);
+        return counters->fds[which] >= 0;
+}
+
+/* Counters40_start
+ *
+ * Reset every available counter to zero and start counting.
+ *
+ * Parameters
+ *      T counters      a set of counters
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `counters` is NULL.
+ */
+extern void Counters40_start(T counters)
+{
+        assert(counters != NULL);
+#ifdef __linux__
+        for (int i = 0; i < COUNTERS40_NUM; i++) {
+                if (counters->fds[i] >= 0) {
+                        ioctl(counters->fds[i], PERF_EVENT_IOC_RESET, 0);
+                        ioctl(counters->fds[i], PERF_EVENT_IOC_ENABLE, 0);
+                }
+        }
+#endif
+}
+
+/* Counters40_stop
+ *
+ * Stop counting and read every counter.
+ *
+ * Parameters
+ *      T counters      a set of counters
+ *      uint64_t values[COUNTERS40_NUM]
+ *                      set to the count of each counter since
+ *                      Counters40_start(); 0 for unavailable counters,
+ *                      COUNTERS40_NOT_COUNTED for those never scheduled
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `counters` or `values` is NULL.
+ *      When the kernel had to share the hardware between counters, the
+ *      counts are scaled up to the whole time counting was enabled.
+ */
+extern void Counters40_stop(T counters, uint64_t values[COUNTERS40_NUM])
+{
+        assert(counters != NULL);
+        assert(values != NULL);
+        for (int i = 0; i < COUNTERS40_NUM; i++) {
+                values[i] = 0;
+        }
+#ifdef __linux__
+        for (int i = 0; i < COUNTERS40_NUM; i++) {
+                if (counters->fds[i] >= 0) {
+                        ioctl(counters->fds[i], PERF_EVENT_IOC_DISABLE, 0);
+                }
+        }
+        for (int i = 0; i < COUNTERS40_NUM; i++) {
+                /* value, time enabled, time running */
+                uint64_t data[3];
+                if (counters->fds[i] < 0) {
+                        continue;
+                }
+                if (read(counters->fds[i], data, sizeof(data)) !=
+                                                        sizeof(data) ||
+                    data[2] == 0) {
+                        values[i] = COUNTERS40_NOT_COUNTED;
+                        continue;
+                }
+                values[i] = data[2] < data[1] ?
+                            (uint64_t)((double)data[0] * data[1] / data[2]) :
+                            data[0];
+        }
+#endif
+}
+
+/* Counters40_name
+ *
+ * Get a short name for a counter, for reports.
+ *
+ * Parameters
+ *      int which       the index of the counter
+ *
+ * Returns
+ *      const char *    the name of the counter
+ *
+ * Notes
+ *      Will CRE if `which` is out of range.
+ */
+extern const char *Counters40_name(int which)
+{
+        assert(which >= 0 && which < COUNTERS40_NUM);
+        return NAMES[which];
+}
+
+#undef T
@@ -0,0 +1,134 @@
+/*
+ * counters40.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Defines Counters40_T, a set of hardware performance counters (cycles,
+ * instructions, cache misses, data TLB misses and branch misses) for the
+ * calling thread. Counters the kernel or hardware will not provide, such as
+ * inside most containers, are simply marked unavailable; creating and using
+ * a Counters40_T never fails because of them.
+ */
+
+#ifndef COUNTERS40_H
+#define COUNTERS40_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define T Counters40_T
+typedef struct T *T;
+
+/* The counters in a Counters40_T, as indices into the values it reports */
+enum {
+        COUNTERS40_CYCLES,
+        COUNTERS40_INSTRUCTIONS,
+        COUNTERS40_CACHE_MISSES,
+        COUNTERS40_DTLB_MISSES,
+        COUNTERS40_BRANCH_MISSES,
+        COUNTERS40_NUM
+};
+
+/* The value Counters40_stop reports for an available counter the kernel never
+ * scheduled on the hardware, so that it measured nothing; perf prints these
+ * as "not counted" */
+#define COUNTERS40_NOT_COUNTED UINT64_MAX
+
+/* Counters40_new
+ *
+ * Open every counter that is available to the calling thread.
+ *
+ * Returns
+ *      T               the created counters, stopped
+ *
+ * Notes
+ *      Allocates memory; it is the responsibility of the client to free it
+ *      with Counters40_free().
+ */
+extern T Counters40_new(void);
+
+/* Counters40_free
+ *
+ * Close the counters and deallocate them.
+ *
+ * Parameters
+ *      T *counters     the address of the counters to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `counters` or `*counters` is NULL.
+ *      Sets `*counters` to NULL.
+ */
+extern void Counters40_free(T *counters);
+
+/* Counters40_available
+ *
+ * Tell whether one counter could be opened.
+ *
+ * Parameters
+ *      T counters      a set of counters
+ *      int which       the index of the counter, such as COUNTERS40_CYCLES
+ *
+ * Returns
+ *      bool            true if the counter reports real values
+ *
+ * Notes
+ *      Will CRE if `counters` is NULL or `which` is out of range.
+ */
+extern bool Counters40_available(T counters, int which);
+
+/* Counters40_start
+ *
+ * Reset every available counter to zero and start counting.
+ *
+ * Parameters
+ *      T counters      a set of counters
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `counters` is NULL.
+ */
+extern void Counters40_start(T counters);
+
+/* Counters40_stop
+ *
+ * Stop counting and read every counter.
+ *
+ * Parameters
+ *      T counters      a set of counters
+ *      uint64_t values[COUNTERS40_NUM]
+ *                      set to the count of each counter since
+ *                      Counters40_start(); 0 for unavailable counters,
+ *                      COUNTERS40_NOT_COUNTED for those never scheduled
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `counters` or `values` is NULL.
+ *      When the kernel had to share the hardware between counters, the
+ *      counts are scaled up to the whole time counting was enabled.
+ */
+extern void Counters40_stop(T counters, uint64_t values[COUNTERS40_NUM]);
+
+/* Counters40_name
+ *
+ * Get a short name for a counter, for reports.
+ *
+ * Parameters
+ *      int which       the index of the counter
+ *
+ * Returns
+ *      const char *    the name of the counter
+ *
+ * Notes
+ *      Will CRE if `which` is out of range.
+ */
+extern const char *Counters40_name(int which);
+
+#undef T
+#endif
@@ -0,0 +1,723 @@
+/*
+ * diff40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements Diff40_T. A sample s of an image with maxval m is the fraction
+ * s / m; two samples are compared as s1 * m2 - s2 * m1, which is exact in 64
+ * bits, and the squares are divided by (m1 * m2)^2 once, at the end. When the
+ * maxvals are equal the scale is just m, the differences are at most 65535,
+ * and a whole row of squares fits in a 64-bit sum per channel: that loop has
+ * no carried dependence but the sums and vectorizes. Rows of a batch are
+ * split among threads in contiguous runs; each thread's sums are added in
+ * thread order, but since integer addition is exact the order cannot change
+ * the result. When tiles are kept, runs are split on tile rows, so that no
+ * two threads add to the same tile.
+ *
+ * SSIM is measured on 8-by-8 windows that do not overlap, per channel. The
+ * sums a window needs are gathered, exactly, in a row of windows while its
+ * rows go by, so a row is read once for every measure; runs are split on
+ * window rows too. Only a window row cut by the end of a batch outlives it,
+ * carried to the next batch. Each window's SSIM is added in fixed point, so
+ * that the mean does not depend on the order windows finish in either.
+ */
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "assert.h"
+#include "mem.h"
+
+#include "diff40.h"
+
+#define T Diff40_T
+
+/* The most threads a comparison may use */
+#define MAX_THREADS 256
+
+/* The fewest pixels worth giving a thread of its own */
+#define MIN_PIXELS_PER_THREAD (1 << 16)
+
+/* The side of an SSIM window */
+#define WINDOW 8
+
+/* The constants that keep SSIM stable near 0, for samples between 0 and 1 */
+#define SSIM_C1 (0.01 * 0.01)
+#define SSIM_C2 (0.03 * 0.03)
+
+/* The fixed-point scale window SSIMs are summed in */
+#define SSIM_ONE 4294967296.0
+
+/* An exact sum of squares; __extension__ keeps -pedantic quiet */
+__extension__ typedef unsigned __int128 Sum;
+
+/* struct window
+ *
+ * Holds the sums of one SSIM window, per channel, of the first image's
+ * samples x and the second's y, unscaled.
+ */
+struct window {
+        uint64_t x[3], y[3], xx[3], yy[3], xy[3];
+        unsigned pixels;
+};
+
+/* struct Diff40_T
+ *
+ * Holds a comparison in progress.
+ *
+ * Components
+ *      unsigned width          the pixels compared in every row
+ *      int64_t scale1, scale2  what the samples of each image are multiplied
+ *                              by before they are subtracted
+ *      double denom            (m1 * m2), or m if the maxvals are equal: the
+ *                              scaled difference of samples 0 and 1
+ *      int threads             the most threads to compare a batch with
+ *      Sum sq[]                the sum of squared differences, per channel
+ *      uint64_t rows           the number of rows compared
+ *      bool bounded            whether a bound was set with Diff40_limit
+ *      double limit            the squared sum past which E exceeds that
+ *                              bound; 0 stops at the first difference
+ *      unsigned tileSize       the side of a tile; 0 if tiles are not kept
+ *      unsigned tilesWide, tilesHigh
+ *                              the number of tiles across and down
+ *      Sum *tiles              the sum of squared differences of each tile,
+ *                              row by row
+ *      unsigned align          the rows that runs must start on multiples of
+ *      unsigned windowsWide    the number of SSIM windows across; 0 if SSIM
+ *                              is not measured or the images have no columns
+ *      struct window *carry    the window row cut by the end of the last
+ *                              batch; NULL if SSIM is not measured
+ *      int64_t ssim            the sum of the SSIM of every finished window,
+ *                              in units of 1 / SSIM_ONE
+ *      uint64_t windows        the number of finished windows
+ */
+struct T {
+        unsigned width;
+        int64_t scale1, scale2;
+        double denom;
+        int threads;
+        Sum sq[3];
+        uint64_t rows;
+        bool bounded;
+        double limit;
+        unsigned tileSize;
+        unsigned tilesWide, tilesHigh;
+        Sum *tiles;
+        unsigned align;
+        unsigned windowsWide;
+        struct window *carry;
+        int64_t ssim;
+        uint64_t windows;
+};
+
+/* struct run
+ *
+ * Holds the rows of a batch one thread compares, and its sums.
+ */
+struct run {
+        T diff;
+        const struct Pnm_rgb *const *rows1;
+        const struct Pnm_rgb *const *rows2;
+        unsigned first, last;
+        Sum sq[3];
+        struct window *windows;
+        int64_t ssim;
+        uint64_t finished;
+};
+
+/* Diff40_new
+ *
+ * Allocate a comparison of two images.
+ *
+ * Parameters
+ *      unsigned width          the number of pixels compared in every row
+ *      unsigned denom1         the maxval of the first image
+ *      unsigned denom2         the maxval of the second image
+ *      int threads             the most threads to compare a batch with
+ *
+ * Returns
+ *      T                       the comparison, with no rows compared yet
+ *
+ * Notes
+ *      Will CRE if a maxval is 0 or over 65535.
+ *      Will CRE if threads is not between 1 and 256.
+ *      Allocates memory; it is the responsibility of the client to free it
+ *      with Diff40_free().
+ */
+extern T Diff40_new(unsigned width, unsigned denom1, unsigned denom2,
+                    int threads)
+{
+        assert(denom1 > 0 && denom1 <= 65535);
+        assert(denom2 > 0 && denom2 <= 65535);
+        assert(threads > 0 && threads <= MAX_THREADS);
+
+        T diff;
+        NEW0(diff);
+        diff->width = width;
+        diff->threads = threads;
+        diff->align = 1;
+        if (denom1 == denom2) {
+                diff->scale1 = diff->scale2 = 1;
+                diff->denom = denom1;
+        } else {
+                diff->scale1 = denom2;
+                diff->scale2 = denom1;
+                diff->denom = (double)denom1 * denom2;
+        }
+        return diff;
+}
+
+/* Diff40_free
+ *
+ * Deallocate and clear the given pointer to a comparison.
+ *
+ * Parameters
+ *      T *diff                 the address of the comparison to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `diff` or `*diff` is NULL.
+ */
+extern void Diff40_free(T *diff)
+{
+        assert(diff != NULL && *diff != NULL);
+        FREE((*diff)->tiles);
+        FREE((*diff)->carry);
+        FREE(*diff);
+}
+
+/* Diff40_limit
+ *
+ * Bound the error, so that Diff40_exceeded can tell as soon as the whole
+ * comparison is sure to exceed it.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      double maxError         the largest E that is acceptable
+ *      uint64_t height         the number of rows that will be compared
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if diff is NULL or maxError is negative.
+ *      A maxError of 0 is exceeded by the first difference found.
+ */
+extern void Diff40_limit(T diff, double maxError, uint64_t height)
+{
+        assert(diff != NULL);
+        assert(maxError >= 0);
+        double bound = maxError * diff->denom;
+        diff->bounded = true;
+        diff->limit = bound * bound * 3.0 * diff->width * height;
+}
+
+/* Diff40_exceeded
+ *
+ * Tell whether the rows compared so far already make E exceed the bound.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *
+ * Returns
+ *      bool                    true if no rows still to come can bring E
+ *                              back within the bound; false if there is no
+ *                              bound
+ *
+ * Notes
+ *      Will CRE if diff is NULL.
+ *      The squared error only grows, so once exceeded the bound stays so.
+ */
+extern bool Diff40_exceeded(T diff)
+{
+        assert(diff != NULL);
+        Sum total = diff->sq[0] + diff->sq[1] + diff->sq[2];
+        return diff->bounded && (double)total > diff->limit;
+}
+
+/* alignRuns
+ *
+ * Make runs start on multiples of a number of rows, as well as of those they
+ * already must start on.
+ */
+static void alignRuns(T diff, unsigned rows)
+{
+        unsigned a = diff->align, b = rows;
+        while (b != 0) {
+                unsigned r = a % b;
+                a = b;
+                b = r;
+        }
+        diff->align = diff->align / a * rows;
+}
+
+/* Diff40_tile
+ *
+ * Keep the error of every tile of the image as well as the whole.
+ *
+ * Parameters
+ *      T diff                  the comparison, with no rows compared yet
+ *      unsigned size           the side of a tile, in pixels
+ *      unsigned height         the number of rows that will be compared
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if diff is NULL, rows have been compared, or size is 0.
+ */
+extern void Diff40_tile(T diff, unsigned size, unsigned height)
+{
+        assert(diff != NULL);
+        assert(diff->rows == 0);
+        assert(size > 0);
+        diff->tileSize = size;
+        alignRuns(diff, size);
+        diff->tilesWide = diff->width / size + (diff->width % size != 0);
+        diff->tilesHigh = height / size + (height % size != 0);
+        FREE(diff->tiles);
+        diff->tiles = CALLOC((size_t)diff->tilesWide * diff->tilesHigh + 1,
+                             sizeof(Sum));
+}
+
+/* Diff40_tile_rmse
+ *
+ * Get the root mean square difference of one tile.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      unsigned col, row       the tile, counted in tiles from the top left
+ *
+ * Returns
+ *      double                  E over the pixels of the tile compared so far
+ *
+ * Notes
+ *      Will CRE if diff is NULL, keeps no tiles, or has no such tile.
+ */
+extern double Diff40_tile_rmse(T diff, unsigned col, unsigned row)
+{
+        assert(diff != NULL && diff->tiles != NULL);
+        assert(col < diff->tilesWide && row < diff->tilesHigh);
+        uint64_t size = diff->tileSize;
+        uint64_t left = col * size, top = row * size;
+        uint64_t wide = diff->width - left < size ? diff->width - left : size;
+        uint64_t high = diff->rows <= top ? 0
+                      : diff->rows - top < size ? diff->rows - top : size;
+        if (wide * high == 0) {
+                return 0;
+        }
+        Sum sum = diff->tiles[(size_t)row * diff->tilesWide + col];
+        return sqrt((double)sum / (3.0 * wide * high)) / diff->denom;
+}
+
+/* Diff40_window
+ *
+ * Measure the structural similarity (SSIM) of the images as well as their
+ * error.
+ *
+ * Parameters
+ *      T diff                  the comparison, with no rows compared yet
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if diff is NULL or rows have been compared.
+ */
+extern void Diff40_window(T diff)
+{
+        assert(diff != NULL);
+        assert(diff->rows == 0);
+        if (diff->carry != NULL) {
+                return;
+        }
+        diff->windowsWide = diff->width / WINDOW + (diff->width % WINDOW != 0);
+        diff->carry = CALLOC(diff->windowsWide + 1, sizeof(struct window));
+        alignRuns(diff, WINDOW);
+}
+
+/* sumSpan
+ *
+ * Add the squared differences of a span of pixels to a set of sums.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      const struct Pnm_rgb *a, *b
+ *                              the first pixel of the span in each image
+ *      unsigned width          the number of pixels in the span
+ *      Sum sq[]                the sums, per channel
+ *
+ * Returns
+ *      (Nothing.)
+ */
+static void sumSpan(T diff, const struct Pnm_rgb *a, const struct Pnm_rgb *b,
+                    unsigned width, Sum sq[3])
+{
+        if (diff->scale1 == diff->scale2) {
+                /* at most 65535^2 per sample and 2^31 samples: fits */
+                uint64_t red = 0, green = 0, blue = 0;
+                for (unsigned col = 0; col < width; col++) {
+                        int64_t dr = (int64_t)a[col].red - b[col].red;
+                        int64_t dg = (int64_t)a[col].green - b[col].green;
+                        int64_t db = (int64_t)a[col].blue - b[col].blue;
+                        red += dr * dr;
+                        green += dg * dg;
+                        blue += db * db;
+                }
+                sq[0] += red;
+                sq[1] += green;
+                sq[2] += blue;
+                return;
+        }
+
+        /* differences up to 65535^2, whose squares only fit unsigned */
+        int64_t s1 = diff->scale1, s2 = diff->scale2;
+        for (unsigned col = 0; col < width; col++) {
+                uint64_t dr = llabs(a[col].red * s1 - b[col].red * s2);
+                uint64_t dg = llabs(a[col].green * s1 - b[col].green * s2);
+                uint64_t db = llabs(a[col].blue * s1 - b[col].blue * s2);
+                sq[0] += dr * dr;
+                sq[1] += dg * dg;
+                sq[2] += db * db;
+        }
+}
+
+/* sumRow
+ *
+ * Add the squared differences of one row to a run's sums, and to its tiles.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      const struct Pnm_rgb *a, *b
+ *                              the row of each image
+ *      uint64_t row            the number of the row in the image
+ *      Sum sq[]                the sums, per channel
+ *
+ * Returns
+ *      (Nothing.)
+ */
+static void sumRow(T diff, const struct Pnm_rgb *a, const struct Pnm_rgb *b,
+                   uint64_t row, Sum sq[3])
+{
+        if (diff->tiles == NULL) {
+                sumSpan(diff, a, b, diff->width, sq);
+                return;
+        }
+
+        Sum *tiles = diff->tiles + (row / diff->tileSize) * diff->tilesWide;
+        for (unsigned tile = 0; tile < diff->tilesWide; tile++) {
+                unsigned left = tile * diff->tileSize;
+                unsigned wide = diff->width - left < diff->tileSize ?
+                                diff->width - left : diff->tileSize;
+                Sum span[3] = { 0, 0, 0 };
+                sumSpan(diff, a + left, b + left, wide, span);
+                for (int c = 0; c < 3; c++) {
+                        sq[c] += span[c];
+                        tiles[tile] += span[c];
+                }
+        }
+}
+
+/* addWindows
+ *
+ * Add one row of each image to the sums of a row of SSIM windows.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      const struct Pnm_rgb *a, *b
+ *                              the row of each image
+ *      struct window windows[] the row of windows
+ *
+ * Returns
+ *      (Nothing.)
+ */
+static void addWindows(T diff, const struct Pnm_rgb *a,
+                       const struct Pnm_rgb *b, struct window windows[])
+{
+        for (unsigned w = 0; w < diff->windowsWide; w++) {
+                unsigned left = w * WINDOW;
+                unsigned right = diff->width - left < WINDOW ? diff->width
+                                                             : left + WINDOW;
+                struct window *window = &windows[w];
+                for (unsigned col = left; col < right; col++) {
+                        uint64_t x[3] = { a[col].red, a[col].green,
+                                          a[col].blue };
+                        uint64_t y[3] = { b[col].red, b[col].green,
+                                          b[col].blue };
+                        for (int c = 0; c < 3; c++) {
+                                window->x[c] += x[c];
+                                window->y[c] += y[c];
+                                window->xx[c] += x[c] * x[c];
+                                window->yy[c] += y[c] * y[c];
+                                window->xy[c] += x[c] * y[c];
+                        }
+                }
+                window->pixels += right - left;
+        }
+}
+
+/* windowSsim
+ *
+ * Get the SSIM of one window, the mean over its channels, in fixed point.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      const struct window *window
+ *                              the window; must have pixels
+ *
+ * Returns
+ *      int64_t                 the SSIM, in units of 1 / SSIM_ONE
+ */
+static int64_t windowSsim(T diff, const struct window *window)
+{
+        double m1 = diff->scale2, m2 = diff->scale1;
+        if (diff->scale1 == diff->scale2) {
+                m1 = m2 = diff->denom;
+        }
+        double n = window->pixels;
+        double ssim = 0;
+        for (int c = 0; c < 3; c++) {
+                double mx = window->x[c] / (n * m1);
+                double my = window->y[c] / (n * m2);
+                double vx = window->xx[c] / (n * m1 * m1) - mx * mx;
+                double vy = window->yy[c] / (n * m2 * m2) - my * my;
+                double cov = window->xy[c] / (n * m1 * m2) - mx * my;
+                ssim += (2 * mx * my + SSIM_C1) * (2 * cov + SSIM_C2) /
+                        ((mx * mx + my * my + SSIM_C1) * (vx + vy + SSIM_C2));
+        }
+        return llround(ssim / 3 * SSIM_ONE);
+}
+
+/* finishWindows
+ *
+ * Add the SSIM of every window of a finished row of windows to a run's sum,
+ * and clear the row for the next.
+ */
+static void finishWindows(T diff, struct window windows[], struct run *run)
+{
+        for (unsigned w = 0; w < diff->windowsWide; w++) {
+                run->ssim += windowSsim(diff, &windows[w]);
+                run->finished++;
+        }
+        memset(windows, 0, diff->windowsWide * sizeof(struct window));
+}
+
+/* compareRun
+ *
+ * Thread body: compare the rows of one run.
+ */
+static void *compareRun(void *cl)
+{
+        struct run *run = cl;
+        T diff = run->diff;
+        for (unsigned row = run->first; row < run->last; row++) {
+                sumRow(diff, run->rows1[row], run->rows2[row],
+                       diff->rows + row, run->sq);
+                if (diff->windowsWide > 0) {
+                        addWindows(diff, run->rows1[row], run->rows2[row],
+                                   run->windows);
+                        if ((diff->rows + row + 1) % WINDOW == 0) {
+                                finishWindows(diff, run->windows, run);
+                        }
+                }
+        }
+        return NULL;
+}
+
+/* Diff40_rows
+ *
+ * Compare a batch of rows of the two images.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      const struct Pnm_rgb *const rows1[]
+ *                              the first pixel of each row of the first image
+ *      const struct Pnm_rgb *const rows2[]
+ *                              the first pixel of each row of the second image
+ *      unsigned count          the number of rows in the batch
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if diff is NULL, or rows1 or rows2 is NULL and count is not.
+ *      Reads the first `width` pixels of every row, which must be contiguous.
+ */
+extern void Diff40_rows(T diff, const struct Pnm_rgb *const rows1[],
+                        const struct Pnm_rgb *const rows2[], unsigned count)
+{
+        assert(diff != NULL);
+        assert(count == 0 || (rows1 != NULL && rows2 != NULL));
+
+        uint64_t pixels = (uint64_t)count * diff->width;
+        uint64_t most = pixels / MIN_PIXELS_PER_THREAD;
+        int threads = most < (uint64_t)diff->threads ? (int)most
+                                                      : diff->threads;
+        if (threads < 1) {
+                threads = 1;
+        }
+
+        struct run runs[threads];
+        pthread_t ids[threads];
+        unsigned first = 0;
+        for (int i = 0; i < threads; i++) {
+                unsigned last = (uint64_t)count * (i + 1) / threads;
+                if (diff->align > 1 && last < count) {
+                        /* end the run on a tile or window row of the image */
+                        uint64_t size = diff->align;
+                        uint64_t end = (diff->rows + last + size - 1) / size *
+                                       size - diff->rows;
+                        last = end < count ? end : count;
+                }
+                if (last < first) {
+                        last = first;
+                }
+                runs[i] = (struct run){ diff, rows1, rows2, first, last,
+                                        { 0, 0, 0 }, NULL, 0, 0 };
+                if (diff->windowsWide > 0) {
+                        runs[i].windows = CALLOC(diff->windowsWide + 1,
+                                                 sizeof(struct window));
+                }
+                first = last;
+                if (i > 0) {
+                        int failed = pthread_create(&ids[i], NULL, compareRun,
+                                                    &runs[i]);
+                        assert(!failed);
+                }
+        }
+        if (diff->windowsWide > 0) {
+                /* the first run finishes the window row the last batch cut */
+                memcpy(runs[0].windows, diff->carry,
+                       diff->windowsWide * sizeof(struct window));
+        }
+        compareRun(&runs[0]);
+
+        for (int i = 0; i < threads; i++) {
+                if (i > 0) {
+                        pthread_join(ids[i], NULL);
+                }
+                for (int c = 0; c < 3; c++) {
+                        diff->sq[c] += runs[i].sq[c];
+                }
+                diff->ssim += runs[i].ssim;
+                diff->windows += runs[i].finished;
+                if (runs[i].windows != NULL && runs[i].last > runs[i].first) {
+                        /* only the run that ends the batch leaves a cut row */
+                        memcpy(diff->carry, runs[i].windows,
+                               diff->windowsWide * sizeof(struct window));
+                }
+                FREE(runs[i].windows);
+        }
+        diff->rows += count;
+}
+
+/* Diff40_rmse
+ *
+ * Get the root mean square difference of the samples compared so far.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *
+ * Returns
+ *      double                  E, between 0 and 1; 0 if nothing was compared
+ *
+ * Notes
+ *      Will CRE if diff is NULL.
+ */
+extern double Diff40_rmse(T diff)
+{
+        assert(diff != NULL);
+        double samples = 3.0 * diff->width * diff->rows;
+        if (samples == 0) {
+                return 0;
+        }
+        Sum total = diff->sq[0] + diff->sq[1] + diff->sq[2];
+        return sqrt((double)total / samples) / diff->denom;
+}
+
+/* Diff40_channel_rmse
+ *
+ * Get the root mean square difference of one channel of the samples compared
+ * so far.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      int channel             0 for red, 1 for green, 2 for blue
+ *
+ * Returns
+ *      double                  E of that channel; 0 if nothing was compared
+ *
+ * Notes
+ *      Will CRE if diff is NULL or channel is not 0, 1 or 2.
+ */
+extern double Diff40_channel_rmse(T diff, int channel)
+{
+        assert(diff != NULL);
+        assert(channel >= 0 && channel < 3);
+        double samples = (double)diff->width * diff->rows;
+        if (samples == 0) {
+                return 0;
+        }
+        return sqrt((double)diff->sq[channel] / samples) / diff->denom;
+}
+
+/* Diff40_psnr
+ *
+ * Get the peak signal-to-noise ratio of the samples compared so far.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *
+ * Returns
+ *      double                  -20 log10(E), in decibels; INFINITY if the
+ *                              images are the same
+ *
+ * Notes
+ *      Will CRE if diff is NULL.
+ */
+extern double Diff40_psnr(T diff)
+{
+        double rmse = Diff40_rmse(diff);
+        return rmse == 0 ? INFINITY : -20 * log10(rmse);
+}
+
+/* Diff40_ssim
+ *
+ * Get the mean structural similarity of the windows compared so far.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *
+ * Returns
+ *      double                  the mean SSIM over windows and channels: at
+ *                              most 1, and 1 for the same images or if
+ *                              nothing was compared, as for images with no
+ *                              columns
+ *
+ * Notes
+ *      Will CRE if diff is NULL or does not measure SSIM.
+ *      A window row cut short by the rows compared so far counts as windows
+ *      of fewer rows, as does the last row of windows of an image whose
+ *      height is not a multiple of 8.
+ */
+extern double Diff40_ssim(T diff)
+{
+        assert(diff != NULL && diff->carry != NULL);
+        int64_t ssim = diff->ssim;
+        uint64_t windows = diff->windows;
+        for (unsigned w = 0; w < diff->windowsWide; w++) {
+                if (diff->carry[w].pixels > 0) {
+                        ssim += windowSsim(diff, &diff->carry[w]);
+                        windows++;
+                }
+        }
+        return windows == 0 ? 1 : ssim / SSIM_ONE / windows;
+}
+
+#undef T
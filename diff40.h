@@ -0,0 +1,251 @@
+/*
+ * diff40.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Defines Diff40_T, the engine ppmdiff uses to compare two images. It is
+ * given the rows of both images, in any number of batches, and accumulates
+ * the squared difference of every sample; at the end it gives the root mean
+ * square difference, E.
+ *
+ * Samples are compared in integers, scaled to a common denominator, and the
+ * squares summed exactly in 128 bits, so the result does not depend on how
+ * the rows are batched or on how many threads share the work. Each batch is
+ * split into contiguous runs of rows, one per thread, each walked in row-major
+ * order over contiguous pixels.
+ *
+ * A comparison can also be given a bound on E, and then tells as soon as the
+ * rows seen so far make the bound impossible to meet; and it can keep E for
+ * every square tile of the image, for finding where two images differ.
+ *
+ * Besides E it gives E per channel, the PSNR, and, if asked before the first
+ * batch, the mean SSIM over 8-by-8 windows, all from the same pass over the
+ * rows.
+ */
+
+#ifndef DIFF40_H
+#define DIFF40_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "pnm.h"
+
+#define T Diff40_T
+typedef struct T *T;
+
+/* Diff40_new
+ *
+ * Allocate a comparison of two images.
+ *
+ * Parameters
+ *      unsigned width          the number of pixels compared in every row
+ *      unsigned denom1         the maxval of the first image
+ *      unsigned denom2         the maxval of the second image
+ *      int threads             the most threads to compare a batch with
+ *
+ * Returns
+ *      T                       the comparison, with no rows compared yet
+ *
+ * Notes
+ *      Will CRE if a maxval is 0 or over 65535.
+ *      Will CRE if threads is not between 1 and 256.
+ *      Allocates memory; it is the responsibility of the client to free it
+ *      with Diff40_free().
+ */
+extern T Diff40_new(unsigned width, unsigned denom1, unsigned denom2,
+                    int threads);
+
+/* Diff40_free
+ *
+ * Deallocate and clear the given pointer to a comparison.
+ *
+ * Parameters
+ *      T *diff                 the address of the comparison to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `diff` or `*diff` is NULL.
+ */
+extern void Diff40_free(T *diff);
+
+/* Diff40_limit
+ *
+ * Bound the error, so that Diff40_exceeded can tell as soon as the whole
+ * comparison is sure to exceed it.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      double maxError         the largest E that is acceptable
+ *      uint64_t height         the number of rows that will be compared
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if diff is NULL or maxError is negative.
+ *      A maxError of 0 is exceeded by the first difference found.
+ */
+extern void Diff40_limit(T diff, double maxError, uint64_t height);
+
+/* Diff40_exceeded
+ *
+ * Tell whether the rows compared so far already make E exceed the bound.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *
+ * Returns
+ *      bool                    true if no rows still to come can bring E
+ *                              back within the bound; false if there is no
+ *                              bound
+ *
+ * Notes
+ *      Will CRE if diff is NULL.
+ *      The squared error only grows, so once exceeded the bound stays so.
+ */
+extern bool Diff40_exceeded(T diff);
+
+/* Diff40_tile
+ *
+ * Keep the error of every tile of the image as well as the whole.
+ *
+ * Parameters
+ *      T diff                  the comparison, with no rows compared yet
+ *      unsigned size           the side of a tile, in pixels
+ *      unsigned height         the number of rows that will be compared
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if diff is NULL, rows have been compared, or size is 0.
+ */
+extern void Diff40_tile(T diff, unsigned size, unsigned height);
+
+/* Diff40_tile_rmse
+ *
+ * Get the root mean square difference of one tile.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      unsigned col, row       the tile, counted in tiles from the top left
+ *
+ * Returns
+ *      double                  E over the pixels of the tile compared so far
+ *
+ * Notes
+ *      Will CRE if diff is NULL, keeps no tiles, or has no such tile.
+ */
+extern double Diff40_tile_rmse(T diff, unsigned col, unsigned row);
+
+/* Diff40_window
+ *
+ * Measure the structural similarity (SSIM) of the images as well as their
+ * error.
+ *
+ * Parameters
+ *      T diff                  the comparison, with no rows compared yet
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if diff is NULL or rows have been compared.
+ */
+extern void Diff40_window(T diff);
+
+/* Diff40_rows
+ *
+ * Compare a batch of rows of the two images.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      const struct Pnm_rgb *const rows1[]
+ *                              the first pixel of each row of the first image
+ *      const struct Pnm_rgb *const rows2[]
+ *                              the first pixel of each row of the second image
+ *      unsigned count          the number of rows in the batch
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if diff is NULL, or rows1 or rows2 is NULL and count is not.
+ *      Reads the first `width` pixels of every row, which must be contiguous.
+ */
+extern void Diff40_rows(T diff, const struct Pnm_rgb *const rows1[],
+                        const struct Pnm_rgb *const rows2[], unsigned count);
+
+/* Diff40_rmse
+ *
+ * Get the root mean square difference of the samples compared so far.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *
+ * Returns
+ *      double                  E, between 0 and 1; 0 if nothing was compared
+ *
+ * Notes
+ *      Will CRE if diff is NULL.
+ */
+extern double Diff40_rmse(T diff);
+
+/* Diff40_channel_rmse
+ *
+ * Get the root mean square difference of one channel of the samples compared
+ * so far.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *      int channel             0 for red, 1 for green, 2 for blue
+ *
+ * Returns
+ *      double                  E of that channel; 0 if nothing was compared
+ *
+ * Notes
+ *      Will CRE if diff is NULL or channel is not 0, 1 or 2.
+ */
+extern double Diff40_channel_rmse(T diff, int channel);
+
+/* Diff40_psnr
+ *
+ * Get the peak signal-to-noise ratio of the samples compared so far.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *
+ * Returns
+ *      double                  -20 log10(E), in decibels; INFINITY if the
+ *                              images are the same
+ *
+ * Notes
+ *      Will CRE if diff is NULL.
+ */
+extern double Diff40_psnr(T diff);
+
+/* Diff40_ssim
+ *
+ * Get the mean structural similarity of the windows compared so far.
+ *
+ * Parameters
+ *      T diff                  the comparison
+ *
+ * Returns
+ *      double                  the mean SSIM over windows and channels: at
+ *                              most 1, and 1 for the same images or if
+ *                              nothing was compared, as for images with no
+ *                              columns
+ *
+ * Notes
+ *      Will CRE if diff is NULL or does not measure SSIM.
+ *      A window row cut short by the rows compared so far counts as windows
+ *      of fewer rows, as does the last row of windows of an image whose
+ *      height is not a multiple of 8.
+ */
+extern double Diff40_ssim(T diff);
+
+#undef T
+#endif
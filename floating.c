@@ -7,6 +7,7 @@
 * component video representation.
 */
 #include "floating.h"
+#include "kernels40.h"
 
 
 /* A struct to use in our apply functions */
@@ -170,6 +171,13 @@ void applyRGBtoVC(int col, int row, A2 uarray2, void *element, void *cl)
                            toVideoComponent(*(struct Pnm_rgb *) element, denom);
 }
 
+/* The per-pixel operations of RGBtoVC and VCtoRGB, specialized for each
+   backend by kernels40.h */
+#define RGBTOVC(in, out, denom) (*(out) = toVideoComponent(*(in), (denom)))
+#define VCTORGB(in, out, denom) (*(out) = toRGB(*(in), (denom)))
+KERNELS40_MAP(RGBtoVC, struct Pnm_rgb, struct vidComp, RGBTOVC)
+KERNELS40_MAP(VCtoRGB, struct vidComp, struct Pnm_rgb, VCTORGB)
+
  /* RGBtoVC
   * 
   * Takes a uarray2 with image data formated in rgb and returns a uarray2 
@@ -190,6 +198,7 @@ void applyRGBtoVC(int col, int row, A2 uarray2, void *element, void *cl)
   *     pixels is NULL
   *     methods is NULL
   *     denominator is less than 1
+  *     Uses the specialization of kernels40.h for plain and blocked suites.
   *
   */
  A2 RGBtoVC(A2 pixels, A2Methods_T methods, int denominator)
@@ -200,11 +209,13 @@ void applyRGBtoVC(int col, int row, A2 uarray2, void *element, void *cl)
          int width = methods->width(pixels);
          int height = methods->height(pixels);
          A2 vComp = methods->new(width, height, sizeof(struct vidComp));
-         struct mappingCl bundle;
-         bundle.array = vComp;
-         bundle.methods = methods;
-         bundle.denom = denominator;
-         methods->map_default(pixels, applyRGBtoVC, &bundle);
+         if (!RGBtoVCKernel(pixels, vComp, methods, denominator)) {
+                 struct mappingCl bundle;
+                 bundle.array = vComp;
+                 bundle.methods = methods;
+                 bundle.denom = denominator;
+                 methods->map_default(pixels, applyRGBtoVC, &bundle);
+         }
  
          return vComp;
  }
@@ -263,6 +274,7 @@ void applyVCtoRGB(int col, int row, A2 uarray2, void *element, void *cl)
   * Notes
   *     Will CRE if any of the following occur:
   *     vComp is NULL, methods is NULL, denominator is less than 1.
+  *     Uses the specialization of kernels40.h for plain and blocked suites.
   *
   */
  A2 VCtoRGB(A2 vComp, A2Methods_T methods, int denominator)
@@ -273,11 +285,13 @@ void applyVCtoRGB(int col, int row, A2 uarray2, void *element, void *cl)
          int width = methods->width(vComp);
          int height = methods->height(vComp);
          A2 pixels = methods->new(width, height, sizeof(struct Pnm_rgb));
-         struct mappingCl bundle;
-         bundle.array = pixels;
-         bundle.methods = methods;
-         bundle.denom = denominator;
-         methods->map_default(vComp, applyVCtoRGB, &bundle);
+         if (!VCtoRGBKernel(vComp, pixels, methods, denominator)) {
+                 struct mappingCl bundle;
+                 bundle.array = pixels;
+                 bundle.methods = methods;
+                 bundle.denom = denominator;
+                 methods->map_default(vComp, applyVCtoRGB, &bundle);
+         }
  
          return pixels;
  }
\ No newline at end of file
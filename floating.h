@@ -30,5 +30,7 @@ struct vidComp {
 
 A2 RGBtoVC(A2 pixels, A2Methods_T methods, int denominator);
 A2 VCtoRGB(A2 vComp, A2Methods_T methods, int denominator);
+struct vidComp toVideoComponent(struct Pnm_rgb rgb, int denom);
+struct Pnm_rgb toRGB(struct vidComp vComp, int denom);
 
 #endif
\ No newline at end of file
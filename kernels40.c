@@ -0,0 +1,73 @@
+/*
+ * kernels40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements the choice between a stage's specializations and its generic
+ * A2Methods version. A suite is taken to be a backend when its `at` is that
+ * backend's, as trim already does to crop plain rasters in place, and it
+ * maps in the backend's native order when its `map_default` is the
+ * backend's own.
+ */
+
+#include "assert.h"
+
+#include "kernels40.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+
+/* Whether stages may use their specializations */
+static bool enabled = true;
+
+/* Kernels40_enable
+ *
+ * Turn the specialized stages on or off.
+ *
+ * Parameters
+ *      bool on                 whether stages may use their specializations;
+ *                              they do by default
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      With kernels off, every stage maps through A2Methods, for comparing
+ *      the two.
+ */
+extern void Kernels40_enable(bool on)
+{
+        enabled = on;
+}
+
+/* Kernels40_select
+ *
+ * Get the specialization a stage may use with a methods suite.
+ *
+ * Parameters
+ *      A2Methods_T methods     the suite the stage was given
+ *
+ * Returns
+ *      Kernels40_backend       KERNELS40_PLAIN or KERNELS40_BLOCKED if the
+ *                              suite is that backend mapping in its native
+ *                              order and kernels are on; KERNELS40_GENERIC
+ *                              otherwise
+ *
+ * Notes
+ *      Will CRE if methods is NULL.
+ */
+extern Kernels40_backend Kernels40_select(A2Methods_T methods)
+{
+        assert(methods != NULL);
+        if (!enabled) {
+                return KERNELS40_GENERIC;
+        }
+        if (methods->at == uarray2_methods_plain->at &&
+            methods->map_default == uarray2_methods_plain->map_default) {
+                return KERNELS40_PLAIN;
+        }
+        if (methods->at == uarray2_methods_blocked->at &&
+            methods->map_default == uarray2_methods_blocked->map_default) {
+                return KERNELS40_BLOCKED;
+        }
+        return KERNELS40_GENERIC;
+}
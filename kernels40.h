@@ -0,0 +1,331 @@
+/*
+ * kernels40.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Generates the codec's stages once per A2Methods backend at compile time.
+ * A stage written against A2Methods calls `map_default` and `at` through
+ * function pointers for every pixel, which the compiler can neither inline
+ * nor vectorize. The macros here instead expand a stage's per-element
+ * operation into loops specialized for the plain UArray2 and the blocked
+ * UArray2b backends. The loops walk each raster a run at a time: a run is
+ * the part of a row that is contiguous in memory, which is the whole row of
+ * a plain raster and the width of a block of a blocked one. Only finding
+ * the start of a run is a call; within a run, elements are reached through
+ * typed pointers, so the operation can be inlined and vectorized.
+ *
+ * A stage uses its specialization when its suite is plain or blocked and
+ * maps in that backend's native order (as Locality40 plans do for that
+ * order); otherwise, and when kernels are turned off with Kernels40_enable,
+ * it falls back to mapping through A2Methods as before. Both walk the same
+ * elements with the same operation, so the output is the same either way.
+ *
+ * Usage, in the file defining the operation:
+ *
+ *      #define RGBTOVC(in, out, denom) \
+ *              (*(out) = toVideoComponent(*(in), (denom)))
+ *      KERNELS40_MAP(RGBtoVC, struct Pnm_rgb, struct vidComp, RGBTOVC)
+ *      ...
+ *      if (!RGBtoVCKernel(pixels, vComp, methods, denominator)) {
+ *              methods->map_default(pixels, applyRGBtoVC, &bundle);
+ *      }
+ */
+
+#ifndef KERNELS40_H
+#define KERNELS40_H
+
+#include <stdbool.h>
+#include "a2methods.h"
+#include "uarray2.h"
+#include "uarray2b.h"
+
+/* The backends a stage can be specialized for */
+typedef enum {
+        KERNELS40_GENERIC,
+        KERNELS40_PLAIN,
+        KERNELS40_BLOCKED
+} Kernels40_backend;
+
+/* Kernels40_enable
+ *
+ * Turn the specialized stages on or off.
+ *
+ * Parameters
+ *      bool on                 whether stages may use their specializations;
+ *                              they do by default
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      With kernels off, every stage maps through A2Methods, for comparing
+ *      the two.
+ */
+extern void Kernels40_enable(bool on);
+
+/* Kernels40_select
+ *
+ * Get the specialization a stage may use with a methods suite.
+ *
+ * Parameters
+ *      A2Methods_T methods     the suite the stage was given
+ *
+ * Returns
+ *      Kernels40_backend       KERNELS40_PLAIN or KERNELS40_BLOCKED if the
+ *                              suite is that backend mapping in its native
+ *                              order and kernels are on; KERNELS40_GENERIC
+ *                              otherwise
+ *
+ * Notes
+ *      Will CRE if methods is NULL.
+ */
+extern Kernels40_backend Kernels40_select(A2Methods_T methods);
+
+/* struct Kernels40_raster
+ *
+ * A raster as the generated loops walk it.
+ *
+ * Components
+ *      A2Methods_UArray2 array the raster
+ *      int width, height       its size, in elements
+ *      int tile                the side of the squares it is stored in; runs
+ *                              end at multiples of it and at the width
+ */
+struct Kernels40_raster {
+        A2Methods_UArray2 array;
+        int width, height;
+        int tile;
+};
+
+/*
+ * The backends. For each there is a function describing a raster and one
+ * finding the start of a run; the macros paste the backend's name onto
+ * `Kernels40_raster_` and `Kernels40_run_`.
+ */
+
+static inline struct Kernels40_raster Kernels40_raster_plain(
+        A2Methods_UArray2 array)
+{
+        struct Kernels40_raster raster = {
+                array, UArray2_width(array), UArray2_height(array), 0
+        };
+        raster.tile = raster.width;
+        return raster;
+}
+
+static inline struct Kernels40_raster Kernels40_raster_blocked(
+        A2Methods_UArray2 array)
+{
+        struct Kernels40_raster raster = {
+                array, UArray2b_width(array), UArray2b_height(array),
+                UArray2b_blocksize(array)
+        };
+        return raster;
+}
+
+/* Kernels40_run_plain, Kernels40_run_blocked
+ *
+ * Get the start of the run holding an element.
+ *
+ * Parameters
+ *      struct Kernels40_raster *raster
+ *                              the raster
+ *      int col, row            the element, which must be in the raster
+ *      int *run                set to the number of elements from it to the
+ *                              end of its run
+ *
+ * Returns
+ *      char *                  the address of the element; the rest of the
+ *                              run follows it
+ */
+static inline char *Kernels40_run_plain(struct Kernels40_raster *raster,
+                                        int col, int row, int *run)
+{
+        *run = raster->width - col;
+        return UArray2_at(raster->array, col, row);
+}
+
+static inline char *Kernels40_run_blocked(struct Kernels40_raster *raster,
+                                          int col, int row, int *run)
+{
+        int end = (col / raster->tile + 1) * raster->tile;
+        *run = (end < raster->width ? end : raster->width) - col;
+        return UArray2b_at(raster->array, col, row);
+}
+
+/*
+ * KERNELS40_MAP_BACKEND(NAME, BACKEND, SRC_T, DST_T, OP)
+ *
+ * Defines `static void NAME##Kernel_##BACKEND(A2Methods_UArray2 src,
+ * A2Methods_UArray2 dst, int arg)`, which does `OP(in, out, arg)` for every
+ * element of dst, where `in` is a `const SRC_T *` to the element of src at
+ * the same place and `out` a `DST_T *` to that of dst. src must be at least
+ * as large as dst. The tiles of src are walked in memory order, as its
+ * `map_default` would.
+ */
+#define KERNELS40_MAP_BACKEND(NAME, BACKEND, SRC_T, DST_T, OP)                 \
+static void NAME##Kernel_##BACKEND(A2Methods_UArray2 src,                      \
+                                   A2Methods_UArray2 dst, int arg)             \
+{                                                                              \
+        struct Kernels40_raster from = Kernels40_raster_##BACKEND(src);        \
+        struct Kernels40_raster to = Kernels40_raster_##BACKEND(dst);          \
+        int tile = from.tile;                                                  \
+        (void)arg;                                                             \
+        if (to.width == 0 || to.height == 0) {                                 \
+                return;                                                        \
+        }                                                                      \
+        for (int top = 0; top < to.height; top += tile) {                      \
+                int bottom = to.height - top < tile ? to.height : top + tile;  \
+                for (int left = 0; left < to.width; left += tile) {            \
+                        int right = to.width - left < tile ? to.width          \
+                                                           : left + tile;      \
+                        for (int row = top; row < bottom; row++) {             \
+                                for (int col = left; col < right; ) {          \
+                                        int inRun, outRun;                     \
+                                        const SRC_T *in = (const SRC_T *)      \
+                                                Kernels40_run_##BACKEND(       \
+                                                &from, col, row, &inRun);      \
+                                        DST_T *out = (DST_T *)                 \
+                                                Kernels40_run_##BACKEND(       \
+                                                &to, col, row, &outRun);       \
+                                        int n = right - col;                   \
+                                        n = inRun < n ? inRun : n;             \
+                                        n = outRun < n ? outRun : n;           \
+                                        for (int i = 0; i < n; i++) {          \
+                                                OP(&in[i], &out[i], arg);      \
+                                        }                                      \
+                                        col += n;                              \
+                                }                                              \
+                        }                                                      \
+                }                                                              \
+        }                                                                      \
+}
+
+/*
+ * KERNELS40_BLOCKS_BACKEND(NAME, BACKEND, SMALL_T, BIG_T, OP)
+ *
+ * Defines `static void NAME##Kernel_##BACKEND(A2Methods_UArray2 small,
+ * A2Methods_UArray2 big, void *cl)` for the stages between a raster of
+ * pixels (big) and one of 2-by-2 blocks (small). It does `OP(block, pixels,
+ * col, row, cl)` for every element of small, where `block` is a `SMALL_T *`
+ * to it, `pixels` a `BIG_T *[4]` to the top-left, top-right, bottom-left and
+ * bottom-right pixels of its block in big, and col and row its place in
+ * small. big must be twice as wide and high as small. The tiles of small
+ * are walked in memory order. A block split between two tiles of big, which
+ * odd blocksizes make, is found a pixel at a time.
+ */
+#define KERNELS40_BLOCKS_BACKEND(NAME, BACKEND, SMALL_T, BIG_T, OP)            \
+static void NAME##Kernel_##BACKEND(A2Methods_UArray2 small,                    \
+                                   A2Methods_UArray2 big, void *cl)            \
+{                                                                              \
+        struct Kernels40_raster blocks = Kernels40_raster_##BACKEND(small);    \
+        struct Kernels40_raster image = Kernels40_raster_##BACKEND(big);       \
+        int tile = blocks.tile;                                                \
+        (void)cl;                                                              \
+        if (blocks.width == 0 || blocks.height == 0) {                         \
+                return;                                                        \
+        }                                                                      \
+        for (int top = 0; top < blocks.height; top += tile) {                  \
+                int bottom = blocks.height - top < tile ? blocks.height        \
+                                                        : top + tile;          \
+                for (int left = 0; left < blocks.width; left += tile) {        \
+                        int right = blocks.width - left < tile ? blocks.width  \
+                                                               : left + tile;  \
+                        for (int row = top; row < bottom; row++) {             \
+                                for (int col = left; col < right; ) {          \
+                                        int run, upperRun, lowerRun;           \
+                                        SMALL_T *block = (SMALL_T *)           \
+                                                Kernels40_run_##BACKEND(       \
+                                                &blocks, col, row, &run);      \
+                                        BIG_T *upper = (BIG_T *)               \
+                                                Kernels40_run_##BACKEND(       \
+                                                &image, 2 * col, 2 * row,      \
+                                                &upperRun);                    \
+                                        BIG_T *lower = (BIG_T *)               \
+                                                Kernels40_run_##BACKEND(       \
+                                                &image, 2 * col, 2 * row + 1,  \
+                                                &lowerRun);                    \
+                                        int n = right - col;                   \
+                                        n = run < n ? run : n;                 \
+                                        n = upperRun / 2 < n ? upperRun / 2    \
+                                                             : n;              \
+                                        n = lowerRun / 2 < n ? lowerRun / 2    \
+                                                             : n;              \
+                                        if (n == 0) {                          \
+                                                int one;                       \
+                                                BIG_T *pixels[4] = {           \
+                                                        upper,                 \
+                                                        (BIG_T *)              \
+                                                        Kernels40_run_##BACKEND\
+                                                        (&image, 2 * col + 1,  \
+                                                         2 * row, &one),       \
+                                                        lower,                 \
+                                                        (BIG_T *)              \
+                                                        Kernels40_run_##BACKEND\
+                                                        (&image, 2 * col + 1,  \
+                                                         2 * row + 1, &one)    \
+                                                };                             \
+                                                OP(block, pixels, col, row,    \
+                                                   cl);                        \
+                                                col++;                         \
+                                                continue;                      \
+                                        }                                      \
+                                        for (int i = 0; i < n; i++) {          \
+                                                BIG_T *pixels[4] = {           \
+                                                        &upper[2 * i],         \
+                                                        &upper[2 * i + 1],     \
+                                                        &lower[2 * i],         \
+                                                        &lower[2 * i + 1]      \
+                                                };                             \
+                                                OP(&block[i], pixels, col + i, \
+                                                   row, cl);                   \
+                                        }                                      \
+                                        col += n;                              \
+                                }                                              \
+                        }                                                      \
+                }                                                              \
+        }                                                                      \
+}
+
+/*
+ * KERNELS40_DISPATCH(NAME, ARG_T)
+ *
+ * Defines `static bool NAME##Kernel(A2Methods_UArray2 a, A2Methods_UArray2 b,
+ * A2Methods_T methods, ARG_T arg)`, which runs the specialization of NAME for
+ * the backend of methods and returns true, or returns false, doing nothing,
+ * if there is none.
+ */
+#define KERNELS40_DISPATCH(NAME, ARG_T)                                        \
+static bool NAME##Kernel(A2Methods_UArray2 a, A2Methods_UArray2 b,             \
+                         A2Methods_T methods, ARG_T arg)                       \
+{                                                                              \
+        switch (Kernels40_select(methods)) {                                   \
+        case KERNELS40_PLAIN:                                                  \
+                NAME##Kernel_plain(a, b, arg);                                 \
+                return true;                                                   \
+        case KERNELS40_BLOCKED:                                                \
+                NAME##Kernel_blocked(a, b, arg);                               \
+                return true;                                                   \
+        default:                                                               \
+                return false;                                                  \
+        }                                                                      \
+}
+
+/*
+ * KERNELS40_MAP(NAME, SRC_T, DST_T, OP), KERNELS40_BLOCKS(NAME, SMALL_T,
+ * BIG_T, OP)
+ *
+ * Define the specializations of a stage for every backend and
+ * `NAME##Kernel`, which picks one.
+ */
+#define KERNELS40_MAP(NAME, SRC_T, DST_T, OP)                                  \
+        KERNELS40_MAP_BACKEND(NAME, plain, SRC_T, DST_T, OP)                   \
+        KERNELS40_MAP_BACKEND(NAME, blocked, SRC_T, DST_T, OP)                 \
+        KERNELS40_DISPATCH(NAME, int)
+
+#define KERNELS40_BLOCKS(NAME, SMALL_T, BIG_T, OP)                             \
+        KERNELS40_BLOCKS_BACKEND(NAME, plain, SMALL_T, BIG_T, OP)              \
+        KERNELS40_BLOCKS_BACKEND(NAME, blocked, SMALL_T, BIG_T, OP)            \
+        KERNELS40_DISPATCH(NAME, void *)
+
+#endif
@@ -0,0 +1,633 @@
+/*
+ * locality40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements Locality40_T. The study copies the image into each backend,
+ * then runs the pipeline one stage at a time: every order of a stage is
+ * timed (and its cache misses counted, where the hardware allows) on the
+ * same input, and the output of the fastest order becomes the input of the
+ * next stage. The blocked UArray2b only maps block-major natively, so its
+ * row- and column-major orders walk the raster with UArray2b_at.
+ */
+
+#include <float.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "assert.h"
+#include "mem.h"
+#include "a2plain.h"
+#include "a2blocked.h"
+#include "a2morton.h"
+#include "uarray2b.h"
+
+#include "locality40.h"
+#include "counters40.h"
+#include "blockPack.h"
+
+#define T Locality40_T
+
+/* from compress40.c */
+extern void trim(Pnm_ppm *image, A2Methods_T methods);
+
+/* The map orders a stage can use */
+enum order { ROW, COL, BLOCK, NUM_ORDERS };
+static const char *const ORDER_NAMES[NUM_ORDERS] = { "row", "col", "block" };
+
+static const char *const STAGE_NAMES[LOCALITY40_NUM_STAGES] = {
+        "trim", "RGBtoVC", "pack2by2", "encode", "unEncode", "unPack2by2",
+        "VCtoRGB"
+};
+
+/* newBlocked8
+ *
+ * Make a blocked raster with 8-by-8 blocks, for the "blocked/8" backend.
+ *
+ * Parameters
+ *      int width               the width (number of columns) of the raster
+ *      int height              the height (number of rows) of the raster
+ *      int size                the size of each element, in bytes
+ *
+ * Returns
+ *      A2Methods_UArray2       a new UArray2b, all zeros
+ *
+ * Notes
+ *      Will CRE if width or height is negative, or size is not positive.
+ *      Will CRE if the raster cannot be allocated.
+ *      It is the responsibility of the caller to free it with
+ *      uarray2_methods_blocked->free().
+ */
+static A2Methods_UArray2 newBlocked8(int width, int height, int size)
+{
+        return UArray2b_new(width, height, size, 8);
+}
+
+/* newBlocked32
+ *
+ * Make a blocked raster with 32-by-32 blocks, for the "blocked/32" backend.
+ *
+ * Parameters
+ *      int width               the width (number of columns) of the raster
+ *      int height              the height (number of rows) of the raster
+ *      int size                the size of each element, in bytes
+ *
+ * Returns
+ *      A2Methods_UArray2       a new UArray2b, all zeros
+ *
+ * Notes
+ *      Will CRE if width or height is negative, or size is not positive.
+ *      Will CRE if the raster cannot be allocated.
+ *      It is the responsibility of the caller to free it with
+ *      uarray2_methods_blocked->free().
+ */
+static A2Methods_UArray2 newBlocked32(int width, int height, int size)
+{
+        return UArray2b_new(width, height, size, 32);
+}
+
+/* A backend a plan may use
+ *
+ * Components
+ *      const char *name        how reports name it
+ *      A2Methods_T *base       the suite it is built on
+ *      A2Methods_UArray2 (*new)(int, int, int)
+ *                              how it makes rasters, if not base's own
+ */
+struct backend {
+        const char *name;
+        A2Methods_T *base;
+        A2Methods_UArray2 (*new)(int width, int height, int size);
+};
+
+static const struct backend BACKENDS[] = {
+        { "plain", &uarray2_methods_plain, NULL },
+        { "blocked/8", &uarray2_methods_blocked, newBlocked8 },
+        { "blocked/32", &uarray2_methods_blocked, newBlocked32 },
+        { "blocked/64K", &uarray2_methods_blocked, NULL },
+        { "morton", &uarray2_methods_morton, NULL },
+};
+#define NUM_BACKENDS (int)(sizeof(BACKENDS) / sizeof(BACKENDS[0]))
+
+/* struct Locality40_T
+ *
+ * Holds private data for each plan.
+ *
+ * Components
+ *      const struct backend *backend   the backend of every raster
+ *      enum order orders[]             the order of each stage
+ *      struct A2Methods_T suites[]     the suite of each stage: the
+ *                                      backend, mapping in that order
+ */
+struct T {
+        const struct backend *backend;
+        enum order orders[LOCALITY40_NUM_STAGES];
+        struct A2Methods_T suites[LOCALITY40_NUM_STAGES];
+};
+
+/*******************************************************************************
+ * Orders
+ ******************************************************************************/
+
+/* blockedMapRowMajor
+ *
+ * Row-major map function for a blocked raster.
+ */
+static void blockedMapRowMajor(A2Methods_UArray2 array,
+                               A2Methods_applyfun apply, void *cl)
+{
+        int width = UArray2b_width(array);
+        int height = UArray2b_height(array);
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        apply(col, row, array, UArray2b_at(array, col, row),
+                              cl);
+                }
+        }
+}
+
+/* blockedMapColMajor
+ *
+ * Column-major map function for a blocked raster.
+ */
+static void blockedMapColMajor(A2Methods_UArray2 array,
+                               A2Methods_applyfun apply, void *cl)
+{
+        int width = UArray2b_width(array);
+        int height = UArray2b_height(array);
+        for (int col = 0; col < width; col++) {
+                for (int row = 0; row < height; row++) {
+                        apply(col, row, array, UArray2b_at(array, col, row),
+                              cl);
+                }
+        }
+}
+
+/* orderMap
+ *
+ * Get the map function of a backend for an order.
+ *
+ * Parameters
+ *      const struct backend *backend   a backend
+ *      enum order order                an order
+ *
+ * Returns
+ *      A2Methods_mapfun *      the map function; NULL if the backend cannot
+ *                              map in that order
+ */
+static A2Methods_mapfun *orderMap(const struct backend *backend,
+                                  enum order order)
+{
+        A2Methods_T base = *backend->base;
+        bool blocked = base == uarray2_methods_blocked;
+        switch (order) {
+        case ROW:
+                return blocked ? blockedMapRowMajor : base->map_row_major;
+        case COL:
+                return blocked ? blockedMapColMajor : base->map_col_major;
+        default:
+                return base->map_block_major;
+        }
+}
+
+/* defaultOrder
+ *
+ * Get the first order a backend can map in.
+ */
+static enum order defaultOrder(const struct backend *backend)
+{
+        enum order order = ROW;
+        while (orderMap(backend, order) == NULL) {
+                order++;
+        }
+        return order;
+}
+
+/* setOrder
+ *
+ * Set the order of one stage of a plan and rebuild its suite.
+ *
+ * Parameters
+ *      T plan                  the plan
+ *      int stage               the stage
+ *      enum order order        an order the plan's backend can map in
+ *
+ * Returns
+ *      (Nothing.)
+ */
+static void setOrder(T plan, int stage, enum order order)
+{
+        struct A2Methods_T *suite = &plan->suites[stage];
+        *suite = **plan->backend->base;
+        if (plan->backend->new != NULL) {
+                suite->new = plan->backend->new;
+        }
+        /* so that callers wanting row-major, such as writers, always can */
+        if (suite->map_row_major == NULL) {
+                suite->map_row_major = orderMap(plan->backend, ROW);
+                suite->map_col_major = orderMap(plan->backend, COL);
+        }
+        suite->map_default = orderMap(plan->backend, order);
+        plan->orders[stage] = order;
+}
+
+/* newPlan
+ *
+ * Allocate a plan for a backend with every stage in its default order.
+ */
+static T newPlan(const struct backend *backend)
+{
+        T plan;
+        NEW(plan);
+        plan->backend = backend;
+        for (int stage = 0; stage < LOCALITY40_NUM_STAGES; stage++) {
+                setOrder(plan, stage, defaultOrder(backend));
+        }
+        return plan;
+}
+
+/*******************************************************************************
+ * Study
+ ******************************************************************************/
+
+/* nowMs
+ *
+ * Read the monotonic clock, in milliseconds.
+ */
+static double nowMs(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/* runStage
+ *
+ * Run one stage of the pipeline.
+ *
+ * Parameters
+ *      int stage               the stage
+ *      Pnm_ppm image           the image being studied; for trim, its raster
+ *                              is replaced by the trimmed one
+ *      A2Methods_UArray2 in    the output of the stage before; unused by trim
+ *      A2Methods_T methods     the suite to run the stage with
+ *
+ * Returns
+ *      A2Methods_UArray2       the output of the stage; for trim, the
+ *                              trimmed raster, which the image now owns
+ */
+static A2Methods_UArray2 runStage(int stage, Pnm_ppm image,
+                                  A2Methods_UArray2 in, A2Methods_T methods)
+{
+        switch (stage) {
+        case LOCALITY40_TRIM:
+                trim(&image, methods);
+                return image->pixels;
+        case LOCALITY40_RGBTOVC:
+                return RGBtoVC(in, methods, image->denominator);
+        case LOCALITY40_PACK2BY2:
+                return pack2by2(in, methods);
+        case LOCALITY40_ENCODE:
+                return packCodeWords(in, methods);
+        case LOCALITY40_UNENCODE:
+                return unEncode(in, methods);
+        case LOCALITY40_UNPACK2BY2:
+                return unPack2by2(in, methods);
+        default:
+                return VCtoRGB(in, methods, 255);
+        }
+}
+
+/* timeStage
+ *
+ * Run one stage once in one order, timing it.
+ *
+ * Parameters
+ *      T plan                  the plan, whose suite for the stage is used
+ *      int stage               the stage
+ *      Pnm_ppm image           the image in the plan's backend; trim works on
+ *                              a copy of its raster
+ *      A2Methods_UArray2 in    the output of the stage before
+ *      Counters40_T counters   counters for cache misses
+ *      double *ms              set to the wall time of the stage
+ *      uint64_t *misses        set to the cache misses of the stage
+ *
+ * Returns
+ *      A2Methods_UArray2       the output of the stage, owned by the caller
+ */
+static A2Methods_UArray2 timeStage(T plan, int stage, Pnm_ppm image,
+                                   A2Methods_UArray2 in,
+                                   Counters40_T counters, double *ms,
+                                   uint64_t *misses)
+{
+        A2Methods_T methods = &plan->suites[stage];
+        struct Pnm_ppm trimmed = *image;
+        if (stage == LOCALITY40_TRIM) {
+                trimmed.pixels = Locality40_copy(image->pixels, methods,
+                                                 methods);
+                trimmed.methods = methods;
+        }
+
+        uint64_t counts[COUNTERS40_NUM];
+        double start = nowMs();
+        Counters40_start(counters);
+        A2Methods_UArray2 out = runStage(stage, &trimmed, in, methods);
+        Counters40_stop(counters, counts);
+        *ms = nowMs() - start;
+        *misses = counts[COUNTERS40_CACHE_MISSES];
+        return out;
+}
+
+/* studyBackend
+ *
+ * Time the stages of the pipeline under one backend, choosing the fastest
+ * order of each.
+ *
+ * Parameters
+ *      T plan                  a new plan for the backend; its orders are set
+ *      Pnm_ppm source          the image to study
+ *      int first, last         the stages to time
+ *      int trials              the number of times to time each order
+ *      Counters40_T counters   counters for cache misses
+ *      FILE *report            where to print every timing, or NULL
+ *
+ * Returns
+ *      double                  the total time of the timed stages, in their
+ *                              chosen orders, in milliseconds
+ */
+static double studyBackend(T plan, Pnm_ppm source, int first, int last,
+                           int trials, Counters40_T counters, FILE *report)
+{
+        A2Methods_T base = &plan->suites[0];
+        struct Pnm_ppm image = *source;
+        image.pixels = Locality40_copy(source->pixels, source->methods, base);
+        image.methods = base;
+
+        double total = 0;
+        A2Methods_UArray2 in = image.pixels;
+        for (int stage = 0; stage <= last; stage++) {
+                double bestMs = DBL_MAX;
+                enum order bestOrder = plan->orders[stage];
+                A2Methods_UArray2 best = NULL;
+                for (enum order order = ROW; order < NUM_ORDERS; order++) {
+                        if (orderMap(plan->backend, order) == NULL ||
+                            (stage < first && order != bestOrder)) {
+                                continue;
+                        }
+                        setOrder(plan, stage, order);
+                        double minMs = DBL_MAX;
+                        uint64_t minMisses = 0;
+                        for (int t = 0; t < (stage < first ? 1 : trials); t++) {
+                                double ms;
+                                uint64_t misses;
+                                A2Methods_UArray2 out = timeStage(plan, stage,
+                                        &image, in, counters, &ms, &misses);
+                                if (ms < minMs) {
+                                        minMs = ms;
+                                        minMisses = misses;
+                                }
+                                if (ms < bestMs) {
+                                        bestMs = ms;
+                                        bestOrder = order;
+                                        if (best != NULL) {
+                                                base->free(&best);
+                                        }
+                                        best = out;
+                                } else {
+                                        base->free(&out);
+                                }
+                        }
+                        if (report != NULL && stage >= first) {
+                                fprintf(report, "%-11s %-12s %-6s %10.3f",
+                                        STAGE_NAMES[stage],
+                                        plan->backend->name,
+                                        ORDER_NAMES[order], minMs);
+                                if (!Counters40_available(counters,
+                                                COUNTERS40_CACHE_MISSES)) {
+                                        fprintf(report, " %14s\n", "n/a");
+                                } else if (minMisses ==
+                                           COUNTERS40_NOT_COUNTED) {
+                                        fprintf(report, " %14s\n",
+                                                "not counted");
+                                } else {
+                                        fprintf(report, " %14llu\n",
+                                                (unsigned long long)minMisses);
+                                }
+                        }
+                }
+                setOrder(plan, stage, bestOrder);
+                if (stage >= first) {
+                        total += bestMs;
+                }
+
+                /* trim's output is the image's new raster */
+                if (stage == LOCALITY40_TRIM) {
+                        base->free(&image.pixels);
+                        image.pixels = best;
+                        image.width = base->width(best);
+                        image.height = base->height(best);
+                } else if (in != image.pixels) {
+                        base->free(&in);
+                }
+                in = best;
+        }
+        if (in != image.pixels) {
+                base->free(&in);
+        }
+        base->free(&image.pixels);
+        return total;
+}
+
+/* Locality40_study
+ *
+ * Time the stages [first, last] of the codec on an image under every backend
+ * and map order, and plan the fastest.
+ *
+ * Parameters
+ *      Pnm_ppm image           the image to study; its raster may be of any
+ *                              backend and is not changed
+ *      Locality40_stage first  the first stage to time
+ *      Locality40_stage last   the last stage to time
+ *      int trials              how many times to time each combination; the
+ *                              fastest trial counts
+ *      FILE *report            where to print the time and cache misses of
+ *                              every combination, or NULL for no report
+ *
+ * Returns
+ *      T                       the backend with the smallest total time over
+ *                              the timed stages, and the fastest order of
+ *                              each stage in that backend
+ *
+ * Notes
+ *      Will CRE if image is NULL, the stages are out of order or trials is
+ *      less than 1.
+ *      Stages before `first` are run once, untimed, to make the input of
+ *      `first`; stages after `last` keep the backend's default order.
+ *      Allocates memory; it is the responsibility of the client to free it
+ *      with Locality40_free().
+ */
+extern T Locality40_study(Pnm_ppm image, Locality40_stage first,
+                          Locality40_stage last, int trials, FILE *report)
+{
+        assert(image != NULL);
+        assert(first <= last && last < LOCALITY40_NUM_STAGES);
+        assert(trials >= 1);
+
+        Counters40_T counters = Counters40_new();
+        if (report != NULL) {
+                fprintf(report, "%-11s %-12s %-6s %10s %14s\n", "stage",
+                        "backend", "order", "ms", "cache-misses");
+        }
+
+        T bestPlan = NULL;
+        double bestTotal = DBL_MAX;
+        for (int b = 0; b < NUM_BACKENDS; b++) {
+                T plan = newPlan(&BACKENDS[b]);
+                double total = studyBackend(plan, image, first, last, trials,
+                                            counters, report);
+                if (total < bestTotal) {
+                        if (bestPlan != NULL) {
+                                Locality40_free(&bestPlan);
+                        }
+                        bestPlan = plan;
+                        bestTotal = total;
+                } else {
+                        Locality40_free(&plan);
+                }
+        }
+
+        if (report != NULL) {
+                fprintf(report, "fastest (%.3f ms): ", bestTotal);
+                Locality40_describe(bestPlan, report);
+        }
+        Counters40_free(&counters);
+        return bestPlan;
+}
+
+/*******************************************************************************
+ * Plans
+ ******************************************************************************/
+
+/* Locality40_free
+ *
+ * Deallocate and clear the given pointer to a plan.
+ *
+ * Parameters
+ *      T *plan                 the address of the plan to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `plan` or `*plan` is NULL.
+ *      Rasters made with the plan's suites must be freed first.
+ */
+extern void Locality40_free(T *plan)
+{
+        assert(plan != NULL && *plan != NULL);
+        FREE(*plan);
+}
+
+/* Locality40_methods
+ *
+ * Get the methods suite a stage should make and map its rasters with.
+ *
+ * Parameters
+ *      T plan                  a plan
+ *      Locality40_stage stage  the stage
+ *
+ * Returns
+ *      A2Methods_T             the plan's backend, mapping in the order
+ *                              chosen for the stage; valid as long as the plan
+ *
+ * Notes
+ *      Will CRE if plan is NULL or stage is out of range.
+ */
+extern A2Methods_T Locality40_methods(T plan, Locality40_stage stage)
+{
+        assert(plan != NULL);
+        assert(stage < LOCALITY40_NUM_STAGES);
+        return &plan->suites[stage];
+}
+
+/* The closure of applyCopy: the raster being copied into, its suite and the
+   size of an element */
+struct copyCl {
+        A2Methods_UArray2 dst;
+        A2Methods_T to;
+        int size;
+};
+
+/* applyCopy
+ *
+ * Apply function for Locality40_copy: copies one element to the same place
+ * in the destination raster.
+ */
+static void applyCopy(int col, int row, A2Methods_UArray2 array,
+                      A2Methods_Object *element, void *cl)
+{
+        (void)array;
+        struct copyCl *copy = cl;
+        memcpy(copy->to->at(copy->dst, col, row), element, copy->size);
+}
+
+/* Locality40_copy
+ *
+ * Copy a raster into a raster of another backend.
+ *
+ * Parameters
+ *      A2Methods_UArray2 src   the raster to copy
+ *      A2Methods_T from        the methods suite of src
+ *      A2Methods_T to          the methods suite of the copy
+ *
+ * Returns
+ *      A2Methods_UArray2       a raster of `to` with the same dimensions and
+ *                              elements as src
+ *
+ * Notes
+ *      Will CRE if any argument is NULL.
+ *      Allocates memory; free it with to->free().
+ */
+extern A2Methods_UArray2 Locality40_copy(A2Methods_UArray2 src,
+                                         A2Methods_T from, A2Methods_T to)
+{
+        assert(src != NULL);
+        assert(from != NULL);
+        assert(to != NULL);
+        struct copyCl copy;
+        copy.size = from->size(src);
+        copy.dst = to->new(from->width(src), from->height(src), copy.size);
+        copy.to = to;
+        from->map_default(src, applyCopy, &copy);
+        return copy.dst;
+}
+
+/* Locality40_describe
+ *
+ * Print a plan on one line, such as "blocked/32: trim=block RGBtoVC=row ...".
+ *
+ * Parameters
+ *      T plan                  a plan
+ *      FILE *out               where to print it
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if plan or out is NULL.
+ */
+extern void Locality40_describe(T plan, FILE *out)
+{
+        assert(plan != NULL);
+        assert(out != NULL);
+        fprintf(out, "%s:", plan->backend->name);
+        for (int stage = 0; stage < LOCALITY40_NUM_STAGES; stage++) {
+                fprintf(out, " %s=%s", STAGE_NAMES[stage],
+                        ORDER_NAMES[plan->orders[stage]]);
+        }
+        fprintf(out, "\n");
+}
+
+#undef T
@@ -0,0 +1,142 @@
+/*
+ * locality40.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Defines Locality40_T, a plan saying how each stage of the codec walks its
+ * rasters: which A2Methods backend (plain UArray2, blocked UArray2b with
+ * some blocksize, or Z-order) holds every raster, and which map order
+ * (row-major, column-major or block-major) each stage maps with. A plan is
+ * found by Locality40_study, which times every stage under every combination
+ * and keeps the fastest.
+ *
+ * Every stage of the codec maps with `methods->map_default`, so a plan hands
+ * each stage its own copy of the backend's methods suite with map_default
+ * replaced by the chosen order. All suites of a plan share one backend, so a
+ * raster made by one stage can be read by the next.
+ */
+
+#ifndef LOCALITY40_H
+#define LOCALITY40_H
+
+#include <stdio.h>
+#include "pnm.h"
+#include "a2methods.h"
+
+#define T Locality40_T
+typedef struct T *T;
+
+/* The stages of the codec a plan covers, in pipeline order */
+typedef enum {
+        LOCALITY40_TRIM,
+        LOCALITY40_RGBTOVC,
+        LOCALITY40_PACK2BY2,
+        LOCALITY40_ENCODE,
+        LOCALITY40_UNENCODE,
+        LOCALITY40_UNPACK2BY2,
+        LOCALITY40_VCTORGB,
+        LOCALITY40_NUM_STAGES
+} Locality40_stage;
+
+/* Locality40_study
+ *
+ * Time the stages [first, last] of the codec on an image under every backend
+ * and map order, and plan the fastest.
+ *
+ * Parameters
+ *      Pnm_ppm image           the image to study; its raster may be of any
+ *                              backend and is not changed
+ *      Locality40_stage first  the first stage to time
+ *      Locality40_stage last   the last stage to time
+ *      int trials              how many times to time each combination; the
+ *                              fastest trial counts
+ *      FILE *report            where to print the time and cache misses of
+ *                              every combination, or NULL for no report
+ *
+ * Returns
+ *      T                       the backend with the smallest total time over
+ *                              the timed stages, and the fastest order of
+ *                              each stage in that backend
+ *
+ * Notes
+ *      Will CRE if image is NULL, the stages are out of order or trials is
+ *      less than 1.
+ *      Stages before `first` are run once, untimed, to make the input of
+ *      `first`; stages after `last` keep the backend's default order.
+ *      Allocates memory; it is the responsibility of the client to free it
+ *      with Locality40_free().
+ */
+extern T Locality40_study(Pnm_ppm image, Locality40_stage first,
+                          Locality40_stage last, int trials, FILE *report);
+
+/* Locality40_free
+ *
+ * Deallocate and clear the given pointer to a plan.
+ *
+ * Parameters
+ *      T *plan                 the address of the plan to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `plan` or `*plan` is NULL.
+ *      Rasters made with the plan's suites must be freed first.
+ */
+extern void Locality40_free(T *plan);
+
+/* Locality40_methods
+ *
+ * Get the methods suite a stage should make and map its rasters with.
+ *
+ * Parameters
+ *      T plan                  a plan
+ *      Locality40_stage stage  the stage
+ *
+ * Returns
+ *      A2Methods_T             the plan's backend, mapping in the order
+ *                              chosen for the stage; valid as long as the plan
+ *
+ * Notes
+ *      Will CRE if plan is NULL or stage is out of range.
+ */
+extern A2Methods_T Locality40_methods(T plan, Locality40_stage stage);
+
+/* Locality40_copy
+ *
+ * Copy a raster into a raster of another backend.
+ *
+ * Parameters
+ *      A2Methods_UArray2 src   the raster to copy
+ *      A2Methods_T from        the methods suite of src
+ *      A2Methods_T to          the methods suite of the copy
+ *
+ * Returns
+ *      A2Methods_UArray2       a raster of `to` with the same dimensions and
+ *                              elements as src
+ *
+ * Notes
+ *      Will CRE if any argument is NULL.
+ *      Allocates memory; free it with to->free().
+ */
+extern A2Methods_UArray2 Locality40_copy(A2Methods_UArray2 src,
+                                         A2Methods_T from, A2Methods_T to);
+
+/* Locality40_describe
+ *
+ * Print a plan on one line, such as "blocked/32: trim=block RGBtoVC=row ...".
+ *
+ * Parameters
+ *      T plan                  a plan
+ *      FILE *out               where to print it
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if plan or out is NULL.
+ */
+extern void Locality40_describe(T plan, FILE *out);
+
+#undef T
+#endif
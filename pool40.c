@@ -0,0 +1,293 @@
+/*
+ * pool40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements the raster pool. Each thread's cache is a small table of bins,
+ * one per buffer size, each holding a list threaded through the free buffers
+ * themselves; it lives in thread-local storage, so no operation locks. A
+ * pthread key whose destructor drains the cache is set on a thread the first
+ * time it caches a buffer, so that memory is not lost when threads exit.
+ *
+ * Fresh small buffers come from posix_memalign. Fresh large ones come from
+ * mmap, whose memory is already zero, with their length rounded up to a whole
+ * huge page; since that rule depends only on the size, Pool40_free can tell
+ * munmap buffers from free ones without a header. Ordinary pages are mapped
+ * without reserving swap, so they are committed only as they are touched and
+ * a sparse raster larger than memory can still be made.
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "assert.h"
+
+#include "pool40.h"
+
+/* The most different buffer sizes a thread caches at once */
+#define BINS 16
+
+/* The size of a huge page on x86-64; buffers this big or bigger are mapped */
+#define HUGE_PAGE ((size_t)2 << 20)
+
+/* struct node
+ *
+ * Overlays the first bytes of a cached buffer, linking it to the next one.
+ */
+struct node {
+        struct node *next;
+};
+
+/* struct bin
+ *
+ * Holds the cached buffers of one size.
+ *
+ * Components
+ *      size_t bytes            the size of every buffer in the bin
+ *      struct node *head       the buffers; NULL if there are none
+ */
+struct bin {
+        size_t bytes;
+        struct node *head;
+};
+
+/* struct cache
+ *
+ * Holds the cached buffers of one thread.
+ *
+ * Components
+ *      struct bin bins[]       the buffers, by size
+ *      size_t bytes            the bytes of every buffer cached
+ *      bool registered         whether the thread's exit will drain it
+ */
+struct cache {
+        struct bin bins[BINS];
+        size_t bytes;
+        bool registered;
+};
+
+static size_t limit = 0;
+static pthread_key_t drainKey;
+static pthread_once_t drainOnce = PTHREAD_ONCE_INIT;
+static __thread struct cache cache;
+
+/* Pool40_limit
+ *
+ * Set how many bytes of freed buffers each thread may keep for reuse.
+ *
+ * Parameters
+ *      size_t bytes            the limit per thread; 0 turns pooling off
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Buffers already cached are kept until reused or drained.
+ */
+extern void Pool40_limit(size_t bytes)
+{
+        __atomic_store_n(&limit, bytes, __ATOMIC_RELAXED);
+}
+
+/* mappedLength
+ *
+ * Get the length of the mapping that holds a large buffer.
+ */
+static size_t mappedLength(size_t bytes)
+{
+        return (bytes + HUGE_PAGE - 1) & ~(HUGE_PAGE - 1);
+}
+
+/* freshBuffer
+ *
+ * Get a new zeroed buffer from the system.
+ *
+ * Parameters
+ *      size_t bytes            the size of the buffer; not 0
+ *      bool huge               ask for huge pages, if bytes is large
+ *
+ * Returns
+ *      void *                  the buffer
+ *
+ * Notes
+ *      Will CRE if the allocation fails.
+ */
+static void *freshBuffer(size_t bytes, bool huge)
+{
+        if (bytes < HUGE_PAGE) {
+                void *buffer;
+                int failed = posix_memalign(&buffer, POOL40_ALIGN, bytes);
+                assert(!failed);
+                memset(buffer, 0, bytes);
+                return buffer;
+        }
+
+        size_t length = mappedLength(bytes);
+        void *buffer = MAP_FAILED;
+#ifdef MAP_HUGETLB
+        if (huge) {
+                buffer = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                              -1, 0);
+        }
+#endif
+        if (buffer == MAP_FAILED) {
+                buffer = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                              -1, 0);
+                assert(buffer != MAP_FAILED);
+#ifdef MADV_HUGEPAGE
+                if (huge) {
+                        madvise(buffer, length, MADV_HUGEPAGE);
+                }
+#endif
+        }
+        return buffer;
+}
+
+/* releaseBuffer
+ *
+ * Give a buffer from freshBuffer back to the system.
+ */
+static void releaseBuffer(void *buffer, size_t bytes)
+{
+        if (bytes < HUGE_PAGE) {
+                free(buffer);
+        } else {
+                munmap(buffer, mappedLength(bytes));
+        }
+}
+
+/* Pool40_alloc
+ *
+ * Get a zeroed buffer, reusing one the calling thread freed if one of the
+ * same size is cached.
+ *
+ * Parameters
+ *      size_t bytes            the size of the buffer
+ *      bool huge               ask for huge pages, if bytes is 2 MB or more
+ *
+ * Returns
+ *      void *                  the buffer, aligned to POOL40_ALIGN bytes;
+ *                              NULL if bytes is 0
+ *
+ * Notes
+ *      Will CRE if the allocation fails.
+ *      Falls back to ordinary pages when huge pages are unavailable; a
+ *      cached buffer is reused whatever pages back it.
+ *      Give the buffer back with Pool40_free(), with the same size.
+ */
+extern void *Pool40_alloc(size_t bytes, bool huge)
+{
+        if (bytes == 0) {
+                return NULL;
+        }
+        for (int i = 0; i < BINS; i++) {
+                struct bin *bin = &cache.bins[i];
+                if (bin->bytes == bytes && bin->head != NULL) {
+                        struct node *buffer = bin->head;
+                        bin->head = buffer->next;
+                        cache.bytes -= bytes;
+                        memset(buffer, 0, bytes);
+                        return buffer;
+                }
+        }
+
+        return freshBuffer(bytes, huge);
+}
+
+/* drainCache
+ *
+ * Destructor of drainKey: drains the cache of a thread that is exiting.
+ */
+static void drainCache(void *unused)
+{
+        (void)unused;
+        Pool40_drain();
+}
+
+/* makeDrainKey
+ *
+ * Create drainKey; run once.
+ */
+static void makeDrainKey(void)
+{
+        pthread_key_create(&drainKey, drainCache);
+}
+
+/* Pool40_free
+ *
+ * Give back a buffer from Pool40_alloc, caching it for the calling thread if
+ * there is room under the limit.
+ *
+ * Parameters
+ *      void *ptr               the buffer, or NULL
+ *      size_t bytes            the size it was allocated with
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      May be called from a thread other than the one that allocated it.
+ */
+extern void Pool40_free(void *ptr, size_t bytes)
+{
+        if (ptr == NULL) {
+                return;
+        }
+        size_t most = __atomic_load_n(&limit, __ATOMIC_RELAXED);
+        if (bytes < sizeof(struct node) || cache.bytes + bytes > most) {
+                releaseBuffer(ptr, bytes);
+                return;
+        }
+
+        struct bin *bin = NULL;
+        for (int i = 0; i < BINS && bin == NULL; i++) {
+                if (cache.bins[i].bytes == bytes) {
+                        bin = &cache.bins[i];
+                }
+        }
+        for (int i = 0; i < BINS && bin == NULL; i++) {
+                if (cache.bins[i].head == NULL) {
+                        bin = &cache.bins[i];
+                        bin->bytes = bytes;
+                }
+        }
+        if (bin == NULL) {
+                releaseBuffer(ptr, bytes);
+                return;
+        }
+
+        if (!cache.registered) {
+                pthread_once(&drainOnce, makeDrainKey);
+                pthread_setspecific(drainKey, &cache);
+                cache.registered = true;
+        }
+        struct node *buffer = ptr;
+        buffer->next = bin->head;
+        bin->head = buffer;
+        cache.bytes += bytes;
+}
+
+/* Pool40_drain
+ *
+ * Free every buffer the calling thread has cached.
+ *
+ * Returns
+ *      (Nothing.)
+ */
+extern void Pool40_drain(void)
+{
+        for (int i = 0; i < BINS; i++) {
+                struct bin *bin = &cache.bins[i];
+                while (bin->head != NULL) {
+                        struct node *buffer = bin->head;
+                        bin->head = buffer->next;
+                        releaseBuffer(buffer, bin->bytes);
+                }
+        }
+        cache.bytes = 0;
+}
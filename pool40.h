@@ -0,0 +1,96 @@
+/*
+ * pool40.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Pools the backing storage of rasters so that a thread compressing or
+ * decompressing a stream of same-sized images reuses the memory, already
+ * faulted in, of the rasters it freed for the last image instead of going
+ * back to malloc and the kernel. UArray2 (and so both A2Methods backends,
+ * since every UArray2b block is a UArray2) gets its elements here.
+ *
+ * Each thread keeps its own cache of freed buffers, grouped by their exact
+ * size, so neither taking nor returning a buffer takes a lock. A thread's
+ * cache is released when the thread exits. Pooling is off until a limit is
+ * set with Pool40_limit; until then every buffer goes straight back to the
+ * system.
+ *
+ * Every buffer starts on a 64-byte (cache line) boundary. Buffers of 2 MB or
+ * more are mapped from the kernel directly, whole huge pages at a time, and
+ * may be asked to be backed by huge pages: explicit ones (MAP_HUGETLB) where
+ * the system has reserved some, else transparent ones (MADV_HUGEPAGE), else
+ * ordinary pages.
+ */
+
+#ifndef POOL40_H
+#define POOL40_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/* The alignment of every buffer, in bytes */
+#define POOL40_ALIGN 64
+
+/* Pool40_limit
+ *
+ * Set how many bytes of freed buffers each thread may keep for reuse.
+ *
+ * Parameters
+ *      size_t bytes            the limit per thread; 0 turns pooling off
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Buffers already cached are kept until reused or drained.
+ */
+extern void Pool40_limit(size_t bytes);
+
+/* Pool40_alloc
+ *
+ * Get a zeroed buffer, reusing one the calling thread freed if one of the
+ * same size is cached.
+ *
+ * Parameters
+ *      size_t bytes            the size of the buffer
+ *      bool huge               ask for huge pages, if bytes is 2 MB or more
+ *
+ * Returns
+ *      void *                  the buffer, aligned to POOL40_ALIGN bytes;
+ *                              NULL if bytes is 0
+ *
+ * Notes
+ *      Will CRE if the allocation fails.
+ *      Falls back to ordinary pages when huge pages are unavailable; a
+ *      cached buffer is reused whatever pages back it.
+ *      Give the buffer back with Pool40_free(), with the same size.
+ */
+extern void *Pool40_alloc(size_t bytes, bool huge);
+
+/* Pool40_free
+ *
+ * Give back a buffer from Pool40_alloc, caching it for the calling thread if
+ * there is room under the limit.
+ *
+ * Parameters
+ *      void *ptr               the buffer, or NULL
+ *      size_t bytes            the size it was allocated with
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      May be called from a thread other than the one that allocated it.
+ */
+extern void Pool40_free(void *ptr, size_t bytes);
+
+/* Pool40_drain
+ *
+ * Free every buffer the calling thread has cached.
+ *
+ * Returns
+ *      (Nothing.)
+ */
+extern void Pool40_drain(void);
+
+#endif
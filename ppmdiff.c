@@ -5,17 +5,53 @@
 *
 * Implements the ppmdiff program, which compares two images to get a
 * quantitative estimate of how different they are
+*
+* Usage: `./ppmdiff [-j threads] [--stream] [--max-error T] [--tile N]
+*                  [--json] image1 image2`
+* where either image may be `-` for standard input. The comparison is shared
+* among `threads` threads (by default, one per processor); the result is the
+* same for any number.
+*
+* Either image may also be a compressed image, from `40image -c`, which is
+* compared as it would decompress: it is held compressed, in a twelfth of the
+* memory, and decoded a few tiles at a time as it is compared (see
+* a2compressed.h).
+*
+* `--stream` compares two raw (P6) PPMs a batch of rows at a time, as they are
+* read, instead of loading both first, so memory stays a few megabytes however
+* large the images are; e.g. `./40image -d x | ./ppmdiff --stream - ref.ppm`.
+* Both must be PPMs.
+*
+* `--max-error T` exits with code 1 if the difference is over T, and stops
+* comparing (and, with `--stream`, reading) as soon as the rows seen so far
+* put it over T, printing `Diff exceeds T` instead of the difference.
+*
+* `--tile N` also prints the difference of every N-by-N tile of the images,
+* after the whole: one line per row of tiles, the tiles of a row separated
+* by commas.
+*
+* `--json` prints, instead, one JSON object holding every measure, taken in
+* the same pass: E, E per channel, the PSNR in decibels (null for the same
+* images), and the mean SSIM over 8-by-8 windows; and the tiles, if any, as
+* an array of rows, and whether E exceeded `--max-error`, if given. When it
+* is exceeded before the end only the bound is printed.
 */
 
 #include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
 #include "compress40.h"
 #include "pnm.h"
 #include "a2methods.h"
 #include "a2plain.h"
+#include "a2compressed.h"
 #include "assert.h"
+#include "mem.h"
+#include "diff40.h"
+#include "readwrite.h"
 
 
 
@@ -26,28 +62,139 @@ struct dimensions {
         int height;
 };
 
+/* The number of pixels of each image compared in one batch; `--max-error`
+ * is checked after each */
+#define BATCH_PIXELS (1 << 20)
 
-
+static FILE *open_input(char *input_file_name);
 static Pnm_ppm read_from_input(char *input_file_name, A2Methods_T methods);
-static void compare_image(Pnm_ppm image1, Pnm_ppm image2);
-float find_E(Pnm_ppm image1, Pnm_ppm image2, struct dimensions limits);
+static struct dimensions smaller_size(unsigned width1, unsigned height1,
+                                      unsigned width2, unsigned height2);
+static Diff40_T new_diff(struct dimensions smaller, unsigned maxval1,
+                         unsigned maxval2);
+static unsigned batch_rows(unsigned width);
+static void get_rows(Pnm_ppm image, int first, unsigned count,
+                     const struct Pnm_rgb **rows, struct Pnm_rgb *buffer);
+static int report(Diff40_T diff, struct dimensions smaller, bool finished);
+static int compare_image(Pnm_ppm image1, Pnm_ppm image2);
+static int compare_streams(FILE *input1, FILE *input2);
+
+/* The number of threads the comparison may use; set with `-j` */
+static int threads = 1;
+
+/* The largest acceptable difference, or a negative number for no bound; set
+ * with `--max-error` */
+static double max_error = -1;
 
+/* The side of the tiles whose differences are printed, or 0 for none; set
+ * with `--tile` */
+static unsigned tile_size = 0;
+
+/* Whether to print every measure as JSON; set with `--json` */
+static bool json = false;
 
 int main(int argc, char *argv[]) 
 {
-        assert(argc == 3);
-        assert((strcmp(argv[1], "-") != 0) || (strcmp(argv[2], "-") != 0));
-        Pnm_ppm image1 = read_from_input(argv[1], uarray2_methods_plain);
-        Pnm_ppm image2 = read_from_input(argv[2], uarray2_methods_plain);
-        compare_image(image1, image2);
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online < 1 ? 1 : online > 256 ? 256 : online;
+        bool stream = false;
+
+        int i;
+        for (i = 1; i < argc - 2; i++) {
+                if (strcmp(argv[i], "-j") == 0) {
+                        threads = atoi(argv[++i]);
+                        if (threads < 1 || threads > 256) {
+                                fprintf(stderr, "%s: -j takes 1 to 256 "
+                                        "threads\n", argv[0]);
+                                exit(EXIT_FAILURE);
+                        }
+                } else if (strcmp(argv[i], "--stream") == 0) {
+                        stream = true;
+                } else if (strcmp(argv[i], "--json") == 0) {
+                        json = true;
+                } else if (strcmp(argv[i], "--max-error") == 0) {
+                        char *end;
+                        max_error = strtod(argv[++i], &end);
+                        if (*end != '\0' || max_error < 0) {
+                                fprintf(stderr, "%s: bad --max-error '%s'\n",
+                                        argv[0], argv[i]);
+                                exit(EXIT_FAILURE);
+                        }
+                } else if (strcmp(argv[i], "--tile") == 0) {
+                        int size = atoi(argv[++i]);
+                        if (size < 1) {
+                                fprintf(stderr, "%s: bad --tile '%s'\n",
+                                        argv[0], argv[i]);
+                                exit(EXIT_FAILURE);
+                        }
+                        tile_size = size;
+                } else {
+                        fprintf(stderr, "Usage: %s [-j threads] [--stream] "
+                                "[--max-error T] [--tile N] [--json] "
+                                "image1 image2\n", argv[0]);
+                        exit(EXIT_FAILURE);
+                }
+        }
+        assert(argc - i == 2);
+        assert((strcmp(argv[i], "-") != 0) || (strcmp(argv[i + 1], "-") != 0));
+
+        if (stream) {
+                FILE *input1 = open_input(argv[i]);
+                FILE *input2 = open_input(argv[i + 1]);
+                int status = compare_streams(input1, input2);
+                fclose(input1);
+                fclose(input2);
+                return status;
+        }
+
+        Pnm_ppm image1 = read_from_input(argv[i], uarray2_methods_plain);
+        Pnm_ppm image2 = read_from_input(argv[i + 1], uarray2_methods_plain);
+        int status = compare_image(image1, image2);
         Pnm_ppmfree(&image1);
         Pnm_ppmfree(&image2);
+        return status;
+}
+
+/* open_input
+ * 
+ * Opens the file specified, or standard input if it is `-`.
+ *
+ * Parameters
+ *      char *input_file_name
+ *                      the file name of a PPM image, or `-`
+ *
+ * Returns
+ *      FILE *          the open file
+ *
+ * Notes
+ *      Prints a message to `stderr` and exits with code 1 (`EXIT_FAILURE`) if
+ *              the file could not be opened.
+ */
+static FILE *open_input(char *input_file_name)
+{
+        assert(input_file_name != NULL);
+        FILE *fp = NULL;
+        if ((strcmp(input_file_name, "-") != 0)) {
+                fp = fopen(input_file_name, "r");
+        } else {
+                fp = stdin;
+        }
+ 
+        if (fp == NULL) {
+                fprintf(stderr,
+                        "Error: file %s could not be opened.\n",
+                        input_file_name);
+                exit(EXIT_FAILURE);
+        }
+        return fp;
 }
 
 /* read_from_input
  * 
  * Returns the single PPM image contained in the file specified.
  * If `input_file_name` is NULL, reads from standard input.
+ * A compressed image is read into uarray2_methods_compressed instead, at
+ * maxval 255, whatever `methods` is.
  *
  * Parameters
  *      char *input_file_name
@@ -71,24 +218,21 @@ int main(int argc, char *argv[])
  */
 static Pnm_ppm read_from_input(char *input_file_name, A2Methods_T methods)
 {
-        assert(input_file_name != NULL);
-        // assert(*input_file_name != NULL);
-        FILE *fp = NULL;
-        if ((strcmp(input_file_name, "-") != 0)) {
-                fp = fopen(input_file_name, "r");
+        FILE *fp = open_input(input_file_name);
+        Pnm_ppm imagep;
+        int first = getc(fp);
+        ungetc(first, fp);
+        if (first == 'C') {
+                NEW(imagep);
+                imagep->pixels = A2Compressed_read(fp, 0);
+                imagep->methods = uarray2_methods_compressed;
+                imagep->width = imagep->methods->width(imagep->pixels);
+                imagep->height = imagep->methods->height(imagep->pixels);
+                imagep->denominator = 255;
         } else {
-                fp = stdin;
-        }
- 
-        if (fp == NULL) {
-                fprintf(stderr,
-                        "Error: file %s could not be opened.\n",
-                        input_file_name);
-                exit(EXIT_FAILURE);
+                imagep = Pnm_ppmread(fp, methods);
         }
  
-        Pnm_ppm imagep = Pnm_ppmread(fp, methods);
- 
         if (input_file_name != NULL) {
                 fclose(fp);
         }
@@ -96,104 +240,314 @@ static Pnm_ppm read_from_input(char *input_file_name, A2Methods_T methods)
         return imagep;
 }
 
-/* compare_image
+/* smaller_size
  * 
  * Asserts that the difference in width and height between the two images is at
  * at most 1 and prints an error message to standard error otherwise.
  *
  * Parameters
- *      Pnm_ppm image1
- *                      an image in the ppm format to be compared to another
-                        image
- *      Pnm_ppm image2
- *                      an image in the ppm format to be compared to another
-                        image
+ *      unsigned width1, height1
+ *                      the size of one image
+ *      unsigned width2, height2
+ *                      the size of the other image
  *
  * Returns
- *      int             returns float 1.0 if the width or height of the images
- *                      differ by more than 1.
+ *      struct dimensions
+ *                      the smaller width and height of the two images
  *
  * Notes
- *      Prints a message to `stderr` and prints the number 1.0 to `stdout`
+ *      Prints a message to `stderr`, prints the number 1.0 to `stdout` and
+ *      exits with code 1 if the width or height of the images differ by more
+ *      than 1.
  */
-static void compare_image(Pnm_ppm image1, Pnm_ppm image2)
+static struct dimensions smaller_size(unsigned width1, unsigned height1,
+                                      unsigned width2, unsigned height2)
 {
-        if ((abs((int)image1->width - (int)image2->width) > 1) || 
-            (abs((int)image1->height - (int)image2->height) > 1)) {
+        if ((abs((int)width1 - (int)width2) > 1) || 
+            (abs((int)height1 - (int)height2) > 1)) {
                 fprintf(stderr, "Image size differs by more than 1\n");
                 fprintf(stdout, "1.0\n");
                 exit(EXIT_FAILURE);
         }
         
         struct dimensions smaller;
-        if ((image1->width > image2->width)) {
-                smaller.width = image2->width;
-        } else {
-                smaller.width = image1->width;
+        smaller.width = width1 > width2 ? width2 : width1;
+        smaller.height = height1 > height2 ? height2 : height1;
+        return smaller;
+}
+
+/* new_diff
+ * 
+ * Starts comparing two images as the command line asks.
+ *
+ * Parameters
+ *      struct dimensions smaller
+ *                      the part of the images compared
+ *      unsigned maxval1, maxval2
+ *                      the maxvals of the images
+ *
+ * Returns
+ *      Diff40_T        the comparison, bounded by `--max-error`, keeping
+ *                      the tiles of `--tile`, and measuring SSIM for
+ *                      `--json`, if given
+ */
+static Diff40_T new_diff(struct dimensions smaller, unsigned maxval1,
+                         unsigned maxval2)
+{
+        Diff40_T diff = Diff40_new(smaller.width, maxval1, maxval2, threads);
+        if (max_error >= 0) {
+                Diff40_limit(diff, max_error, smaller.height);
         }
+        if (tile_size > 0) {
+                Diff40_tile(diff, tile_size, smaller.height);
+        }
+        if (json) {
+                Diff40_window(diff);
+        }
+        return diff;
+}
+
+/* batch_rows
+ * 
+ * Gets the number of rows of the given width that make one batch.
+ */
+static unsigned batch_rows(unsigned width)
+{
+        unsigned batch = width == 0 ? 1 : BATCH_PIXELS / width;
+        return batch < 1 ? 1 : batch;
+}
+
+/* report
+ * 
+ * Prints the result of a comparison: the difference, or that it exceeds
+ * `--max-error`, and then the difference of every tile; or, for `--json`,
+ * every measure.
+ *
+ * Parameters
+ *      Diff40_T diff   the comparison
+ *      struct dimensions smaller
+ *                      the part of the images compared
+ *      bool finished   whether every row was compared
+ *
+ * Returns
+ *      int             the exit code: 1 if the difference is over
+ *                      `--max-error`, else 0
+ */
+static int report(Diff40_T diff, struct dimensions smaller, bool finished)
+{
+        double rmsd = finished ? Diff40_rmse(diff) : 0;
+        bool exceeded = !finished || (max_error >= 0 && rmsd > max_error);
 
-        if ((image1->height > image2->height)) {
-                smaller.height = image2->height;
+        if (json) {
+                fprintf(stdout, "{\"width\": %d, \"height\": %d",
+                        smaller.width, smaller.height);
+                if (finished) {
+                        double psnr = Diff40_psnr(diff);
+                        fprintf(stdout, ", \"rmse\": %.6f, \"rmse_red\": %.6f, "
+                                "\"rmse_green\": %.6f, \"rmse_blue\": %.6f",
+                                rmsd, Diff40_channel_rmse(diff, 0),
+                                Diff40_channel_rmse(diff, 1),
+                                Diff40_channel_rmse(diff, 2));
+                        if (isinf(psnr)) {
+                                fprintf(stdout, ", \"psnr\": null");
+                        } else {
+                                fprintf(stdout, ", \"psnr\": %.4f", psnr);
+                        }
+                        fprintf(stdout, ", \"ssim\": %.6f", Diff40_ssim(diff));
+                }
+                if (max_error >= 0) {
+                        fprintf(stdout, ", \"max_error\": %.6f, "
+                                "\"exceeded\": %s", max_error,
+                                exceeded ? "true" : "false");
+                }
+        } else if (!finished) {
+                fprintf(stdout, "Diff exceeds %.4f\n", max_error);
         } else {
-                smaller.height = image1->height;
+                fprintf(stdout, "Diff is: %.4f\n", rmsd);
         }
 
-        fprintf(stdout, "Diff is: %.4f\n", find_E(image1, image2, smaller));
+        if (finished && tile_size > 0) {
+                unsigned wide = (smaller.width + tile_size - 1) / tile_size;
+                unsigned high = (smaller.height + tile_size - 1) / tile_size;
+                const char *open = json ? "[" : "";
+                const char *close = json ? "]" : "\n";
+                if (json) {
+                        fprintf(stdout, ", \"tiles\": [");
+                }
+                for (unsigned row = 0; row < high; row++) {
+                        fprintf(stdout, "%s%s", json && row > 0 ? "," : "",
+                                open);
+                        for (unsigned col = 0; col < wide; col++) {
+                                fprintf(stdout, "%s%.4f", col > 0 ? "," : "",
+                                        Diff40_tile_rmse(diff, col, row));
+                        }
+                        fprintf(stdout, "%s", close);
+                }
+                if (json) {
+                        fprintf(stdout, "]");
+                }
+        }
+        if (json) {
+                fprintf(stdout, "}\n");
+        }
+        return exceeded ? EXIT_FAILURE : 0;
 }
 
-/* find_E
+/* get_rows
  * 
- * Calculates the root mean square difference of the pixel values in two images
- * and prints it out to `stdout` with four digits after the decimal point.
+ * Gets the first pixel of each of a batch of rows of a loaded image, whose
+ * pixels must then be contiguous.
  *
  * Parameters
- *      Pnm_ppm image1, image2
- *                      
- *                      images whose root mean square difference in pixel values
- *                      will be calculated
- *       
- *      struct dimensions
- *                      the struct containing the smaller width and height of 
- *                      the two images
+ *      Pnm_ppm image   the image
+ *      int first       the first row of the batch
+ *      unsigned count  the number of rows in the batch
+ *      const struct Pnm_rgb **rows
+ *                      set to the first pixel of each row
+ *      struct Pnm_rgb *buffer
+ *                      room for `count` rows of the image, which the rows are
+ *                      copied into unless the image is a plain UArray2
+ *
+ * Returns
+ *      None (void)
+ */
+static void get_rows(Pnm_ppm image, int first, unsigned count,
+                     const struct Pnm_rgb **rows, struct Pnm_rgb *buffer)
+{
+        A2Methods_T methods = image->methods;
+        for (unsigned row = 0; row < count; row++) {
+                /* a row with no columns has no first pixel to point at */
+                if (methods == uarray2_methods_plain && image->width > 0) {
+                        rows[row] = methods->at(image->pixels, 0, first + row);
+                        continue;
+                }
+                struct Pnm_rgb *copy = buffer + (size_t)row * image->width;
+                for (unsigned col = 0; col < image->width; col++) {
+                        copy[col] = *(struct Pnm_rgb *)methods->at(
+                                image->pixels, col, first + row);
+                }
+                rows[row] = copy;
+        }
+}
+
+/* compare_image
+ * 
+ * Compares two images loaded in full and reports the result.
+ *
+ * Parameters
+ *      Pnm_ppm image1
+ *                      an image in the ppm format to be compared to another
+ *                      image
+ *      Pnm_ppm image2
+ *                      an image in the ppm format to be compared to another
+ *                      image
+ *
+ * Returns
+ *      int             the exit code report() gives
+ *
+ * Notes
+ *      Exits as smaller_size() does if the sizes differ by more than 1.
+ *      A batch of rows of an image held in a plain UArray2 is compared in
+ *      place; of any other, a copy.
+ */
+static int compare_image(Pnm_ppm image1, Pnm_ppm image2)
+{
+        struct dimensions smaller = smaller_size(image1->width, image1->height,
+                                                 image2->width, image2->height);
+        Diff40_T diff = new_diff(smaller, image1->denominator,
+                                 image2->denominator);
+        unsigned batch = batch_rows(smaller.width);
+        const struct Pnm_rgb **rows1 = CALLOC(batch, sizeof(*rows1));
+        const struct Pnm_rgb **rows2 = CALLOC(batch, sizeof(*rows2));
+        struct Pnm_rgb *buffer1 = NULL, *buffer2 = NULL;
+        if (image1->methods != uarray2_methods_plain) {
+                buffer1 = CALLOC((size_t)batch * image1->width + 1,
+                                 sizeof(struct Pnm_rgb));
+        }
+        if (image2->methods != uarray2_methods_plain) {
+                buffer2 = CALLOC((size_t)batch * image2->width + 1,
+                                 sizeof(struct Pnm_rgb));
+        }
+
+        bool finished = true;
+        for (int done = 0; done < smaller.height && finished; ) {
+                unsigned count = smaller.height - done < (int)batch ?
+                                 (unsigned)(smaller.height - done) : batch;
+                get_rows(image1, done, count, rows1, buffer1);
+                get_rows(image2, done, count, rows2, buffer2);
+                Diff40_rows(diff, rows1, rows2, count);
+                done += count;
+                finished = !Diff40_exceeded(diff);
+        }
+        FREE(rows1);
+        FREE(rows2);
+        FREE(buffer1);
+        FREE(buffer2);
+
+        int status = report(diff, smaller, finished);
+        Diff40_free(&diff);
+        return status;
+}
+
+/* compare_streams
+ * 
+ * Compares two raw PPMs, reading them a batch of rows at a time, and reports
+ * the result.
+ *
+ * Parameters
+ *      FILE *input1, *input2
+ *                      files positioned at the start of a P6 image each
  *
  * Returns
- *      float           the root mean square difference
+ *      int             the exit code report() gives
  *
  * Notes
- *      Prints the root mean square difference (E) to `stdout` with four digits
- *      after the decimal point
+ *      Exits as smaller_size() does if the sizes differ by more than 1.
+ *      Will CRE if either image is not a raw PPM or ends early.
+ *      Rows past the height of the shorter image, or past the batch that
+ *      exceeds `--max-error`, are never read.
  */
-float find_E(Pnm_ppm image1, Pnm_ppm image2, struct dimensions limits)
+static int compare_streams(FILE *input1, FILE *input2)
 {
-        A2Methods_T methods = uarray2_methods_plain; 
-        float msdNum = 0;
-        float denom1 = image1->denominator;
-        float denom2 = image2->denominator;
-
-        for (int i = 0; i < limits.width; i++)
-        {
-                for (int j = 0; j < limits.height; j++)
-                {
-                        struct Pnm_rgb *rgb1 = 
-                                              methods->at(image1->pixels, i, j);
-                        struct Pnm_rgb *rgb2 = 
-                                              methods->at(image2->pixels, i, j);
-
-                        float dred = (rgb1->red / denom1) - (rgb2->red / denom2);
-                        float dgreen = (rgb1->green / denom1) - (rgb2->green / denom2);
-                        float dblue = (rgb1->blue / denom1) - (rgb2->blue / denom2);
-
-                        //fprintf(stderr, "[%d, %d, %d]\n", dred, dgreen, dblue);
-                        //fprintf(stderr, "[%d, %d]\n", rgb1->red, rgb2->red);
-
-                        msdNum += pow(dred, 2) + pow(dgreen, 2) + pow(dblue, 2);
+        unsigned width1, height1, maxval1, width2, height2, maxval2;
+        readPPMHeader(input1, &width1, &height1, &maxval1);
+        readPPMHeader(input2, &width2, &height2, &maxval2);
+        struct dimensions smaller = smaller_size(width1, height1,
+                                                 width2, height2);
+
+        unsigned batch = batch_rows(width1 > width2 ? width1 : width2);
+        struct Pnm_rgb *pixels1 = CALLOC((size_t)batch * width1 + 1,
+                                         sizeof(struct Pnm_rgb));
+        struct Pnm_rgb *pixels2 = CALLOC((size_t)batch * width2 + 1,
+                                         sizeof(struct Pnm_rgb));
+        const struct Pnm_rgb **rows1 = CALLOC(batch, sizeof(*rows1));
+        const struct Pnm_rgb **rows2 = CALLOC(batch, sizeof(*rows2));
+        for (unsigned row = 0; row < batch; row++) {
+                rows1[row] = pixels1 + (size_t)row * width1;
+                rows2[row] = pixels2 + (size_t)row * width2;
+        }
+
+        Diff40_T diff = new_diff(smaller, maxval1, maxval2);
+        bool finished = true;
+        for (int done = 0; done < smaller.height && finished; ) {
+                unsigned count = smaller.height - done < (int)batch ?
+                                 (unsigned)(smaller.height - done) : batch;
+                for (unsigned row = 0; row < count; row++) {
+                        readPPMRow(input1, width1, maxval1,
+                                   pixels1 + (size_t)row * width1);
+                        readPPMRow(input2, width2, maxval2,
+                                   pixels2 + (size_t)row * width2);
                 }
-                
+                Diff40_rows(diff, rows1, rows2, count);
+                done += count;
+                finished = !Diff40_exceeded(diff);
         }
-        
-        //fprintf(stderr, "width = %d, height = %d\n", limits.width, limits.height);
-        float msdDenom = 3 * limits.width * limits.height;
-        float rmsd = sqrt(msdNum / msdDenom);
-        //fprintf(stderr, "[msdNum, msdDenom, msd] : [%ld, %.0f, %f]\n", msdNum, msdDenom, msd);
-        return rmsd;
-}
\ No newline at end of file
+
+        int status = report(diff, smaller, finished);
+        Diff40_free(&diff);
+        FREE(rows1);
+        FREE(rows2);
+        FREE(pixels1);
+        FREE(pixels2);
+        return status;
+}
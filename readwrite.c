@@ -7,6 +7,10 @@
 * them to stdout.
 */
 #include "readwrite.h"
+#include "mem.h"
+#include "alloc40.h"
+#include <sys/types.h>
+#include <limits.h>
 
 /* applyPrintCodewords
  * 
@@ -37,6 +41,42 @@ void applyPrintCodewords(int col, int row, A2Methods_UArray2 uarray2,
         }
 }
 
+/* mapRowMajor
+ * 
+ * Visits every element of an array in row-major order, whatever the order of
+ * the array's default map, since codewords are stored row-major.
+ * 
+ * Parameters
+ *      A2Methods_UArray2 array the array to visit
+ *      A2Methods_T methods     the methods suite of array
+ *      A2Methods_applyfun apply
+ *                              the function applied to each element
+ *      void *cl                the closure passed to apply
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Uses the suite's own row-major map when it has one; otherwise (as with
+ *      the blocked suite) walks the rows with `at`.
+ */
+static void mapRowMajor(A2Methods_UArray2 array, A2Methods_T methods,
+                        A2Methods_applyfun apply, void *cl)
+{
+        if (methods->map_row_major != NULL) {
+                methods->map_row_major(array, apply, cl);
+                return;
+        }
+        int width = methods->width(array);
+        int height = methods->height(array);
+        for (int row = 0; row < height; row++) {
+                for (int col = 0; col < width; col++) {
+                        apply(col, row, array, methods->at(array, col, row),
+                              cl);
+                }
+        }
+}
+
 /* printCodeWords
  * 
  * TODO: Description
@@ -53,7 +93,67 @@ void applyPrintCodewords(int col, int row, A2Methods_UArray2 uarray2,
  */
 void printCodeWords(A2Methods_UArray2 codeWords, A2Methods_T methods)
 {
-        methods->map_default(codeWords, applyPrintCodewords, NULL);
+        mapRowMajor(codeWords, methods, applyPrintCodewords, NULL);
+}
+
+/* applyWriteCodeWord
+ * 
+ * Apply function that stores one codeword in a byte buffer, in the same byte
+ * order printCodeWords uses.
+ * 
+ * Parameters
+ *      int col, row            the position of the codeword (unused)
+ *      A2Methods_UArray2 uarray2
+ *                              the array of codewords (unused)
+ *      void *element           a pointer to the codeword to store
+ *      void *cl                a pointer to the buffer cursor, which is
+ *                              advanced past the stored codeword
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Will CRE if element or cl are NULL.
+ */
+static void applyWriteCodeWord(int col, int row, A2Methods_UArray2 uarray2,
+                               void *element, void *cl)
+{
+        (void) col;
+        (void) row;
+        (void) uarray2;
+        assert(element != NULL);
+        assert(cl != NULL);
+        unsigned char **cursor = cl;
+        for (int i = 0; i < 4; i++)
+        {
+                *(*cursor)++ = Bitpack_getu(*(uint32_t *) element, 8, i << 3);
+        }
+}
+
+/* writeCodeWords
+ * 
+ * Stores every codeword of a compressed image in a caller-supplied buffer
+ * instead of printing them to stdout.
+ * 
+ * Parameters
+ *      A2Methods_UArray2 codeWords
+ *                              the codewords of a compressed image
+ *      A2Methods_T methods     the methods suite of codeWords
+ *      unsigned char *out      a buffer with room for 4 bytes per codeword
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Will CRE if any argument is NULL.
+ */
+void writeCodeWords(A2Methods_UArray2 codeWords, A2Methods_T methods,
+                    unsigned char *out)
+{
+        assert(codeWords != NULL);
+        assert(methods != NULL);
+        assert(out != NULL);
+        mapRowMajor(codeWords, methods, applyWriteCodeWord, &out);
 }
 
 /* applyRead
@@ -89,6 +189,44 @@ void applyRead(int col, int row, A2Methods_UArray2 uarray2, void *element,
 }
 
 
+/* readCompressedHeader
+ * 
+ * Reads the header of a compressed image, leaving `input` positioned at the
+ * first byte of the first codeword.
+ * 
+ * Parameters
+ *      FILE *input             a file positioned at the start of a compressed
+ *                              image
+ *      unsigned *width         set to the width of the image, in pixels
+ *      unsigned *height        set to the height of the image, in pixels
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Will CRE if input, width or height are NULL.
+ *      Will CRE if the header is not a valid format 2 header.
+ *      Will CRE if the width or height is over INT_MAX, the largest dimension
+ *      an A2Methods array can hold.
+ */
+void readCompressedHeader(FILE *input, unsigned *width, unsigned *height)
+{
+        assert(input != NULL);
+        assert(width != NULL);
+        assert(height != NULL);
+        /* read wide, so that numbers past UINT_MAX do not wrap */
+        unsigned long wide, high;
+        int read = fscanf(input, "COMP40 Compressed image format 2\n%lu %lu",
+                                  &wide,
+                                  &high);
+        assert(read == 2);
+        assert(wide <= INT_MAX && high <= INT_MAX);
+        *width = wide;
+        *height = high;
+        int c = getc(input);
+        assert(c == '\n');
+}
+
 /* readCompressed
  * 
  * TODO: Description
@@ -108,14 +246,248 @@ void applyRead(int col, int row, A2Methods_UArray2 uarray2, void *element,
         assert(input != NULL);
         assert(methods != NULL);
         unsigned height, width;
-        int read = fscanf(input, "COMP40 Compressed image format 2\n%u %u",
-                                  &width,
-                                  &height);
-        assert(read == 2);
-        int c = getc(input);
-        assert(c == '\n');
+        readCompressedHeader(input, &width, &height);
         A2Methods_UArray2 inputData = 
                           methods->new(width / 2, height / 2, sizeof(uint32_t));
-        methods->map_default(inputData, applyRead, input);
+        mapRowMajor(inputData, methods, applyRead, input);
         return inputData;
-}
\ No newline at end of file
+}
+
+/* readHeaderNumber
+ * 
+ * Reads one unsigned decimal number from the header of a PPM image, skipping
+ * any whitespace and `#` comments in front of it.
+ * 
+ * Parameters
+ *      FILE *input     a file positioned inside the header of a PPM image
+ *
+ * Returns
+ *      unsigned        the number that was read
+ *
+ * Notes
+ *      Will CRE if the next token is not a number.
+ *      Will CRE if the number is over INT_MAX, the largest dimension an
+ *      A2Methods array can hold.
+ *      Leaves the character that ends the number unread, so that a `#`
+ *      comment right after the number is skipped with the next field.
+ */
+static unsigned readHeaderNumber(FILE *input)
+{
+        int c = getc(input);
+        while (c == '#' || c == ' ' || c == '\t' || c == '\n' || c == '\r') {
+                if (c == '#') {
+                        while (c != '\n' && c != EOF) {
+                                c = getc(input);
+                        }
+                }
+                c = getc(input);
+        }
+        assert(c >= '0' && c <= '9');
+
+        unsigned num = 0;
+        while (c >= '0' && c <= '9') {
+                assert(num <= (unsigned)(INT_MAX - (c - '0')) / 10);
+                num = num * 10 + (c - '0');
+                c = getc(input);
+        }
+        if (c != EOF) {
+                ungetc(c, input);
+        }
+        return num;
+}
+
+/* skipBytes
+ * 
+ * Advances `input` by `count` bytes, seeking when the file allows it and
+ * reading and discarding bytes otherwise (e.g. when reading from a pipe).
+ * 
+ * Parameters
+ *      FILE *input     the file to advance
+ *      off_t count     the number of bytes to skip
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Will CRE if the file ends before `count` bytes have been skipped.
+ */
+static void skipBytes(FILE *input, off_t count)
+{
+        if (count == 0 || fseeko(input, count, SEEK_CUR) == 0) {
+                return;
+        }
+
+        char discard[4096];
+        while (count > 0) {
+                size_t chunk = count < (off_t)sizeof(discard) ? 
+                                       (size_t)count : sizeof(discard);
+                size_t got = fread(discard, 1, chunk, input);
+                assert(got == chunk);
+                count -= got;
+        }
+}
+
+/* readPPMHeader
+ * 
+ * Reads the header of a raw (P6) PPM image, leaving `input` at its first
+ * pixel.
+ * 
+ * Parameters
+ *      FILE *input             a file positioned at the start of a P6 image
+ *      unsigned *width         set to the width of the image
+ *      unsigned *height        set to the height of the image
+ *      unsigned *maxval        set to the largest value a sample may take
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Will CRE if any argument is NULL.
+ *      Will CRE if the image is not a raw PPM, or its maxval is not between 1
+ *      and 65535 or not followed by a whitespace character.
+ *      `#` comments may come anywhere before the maxval.
+ */
+void readPPMHeader(FILE *input, unsigned *width, unsigned *height,
+                   unsigned *maxval)
+{
+        assert(input != NULL);
+        assert(width != NULL && height != NULL && maxval != NULL);
+        int magic1 = getc(input);
+        int magic2 = getc(input);
+        assert(magic1 == 'P' && magic2 == '6');
+
+        *width = readHeaderNumber(input);
+        *height = readHeaderNumber(input);
+        *maxval = readHeaderNumber(input);
+        assert(*maxval > 0 && *maxval < 65536);
+
+        /* a single whitespace character separates the maxval from the
+         * first pixel */
+        int c = getc(input);
+        assert(c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+/* readPPMRow
+ * 
+ * Reads the next pixel row of a raw (P6) PPM image into an array of pixels.
+ * 
+ * Parameters
+ *      FILE *input             a file positioned at the start of a row
+ *      unsigned width          the width of the image
+ *      unsigned maxval         the maxval of the image
+ *      struct Pnm_rgb *row     the `width` pixels to set
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Will CRE if input or row is NULL, or the image ends early.
+ *      Needs no buffer: the raw samples, at most half the size of the
+ *      pixels, are read into the end of `row` and widened front to back, so
+ *      no pixel is written before its samples have been read.
+ */
+void readPPMRow(FILE *input, unsigned width, unsigned maxval,
+                struct Pnm_rgb *row)
+{
+        assert(input != NULL);
+        assert(row != NULL);
+        size_t sampleBytes = maxval < 256 ? 1 : 2;
+        size_t rowBytes = (size_t)width * 3 * sampleBytes;
+        unsigned char *sample = (unsigned char *)(row + width) - rowBytes;
+        size_t got = fread(sample, 1, rowBytes, input);
+        assert(got == rowBytes);
+
+        for (unsigned col = 0; col < width; col++) {
+                unsigned vals[3];
+                for (int i = 0; i < 3; i++) {
+                        vals[i] = sample[0];
+                        if (sampleBytes == 2) {
+                                vals[i] = (vals[i] << 8) | sample[1];
+                        }
+                        sample += sampleBytes;
+                }
+                row[col].red = vals[0];
+                row[col].green = vals[1];
+                row[col].blue = vals[2];
+        }
+}
+
+/* readPPMRows
+ * 
+ * Reads only the pixel rows [first, last) of a raw (P6) PPM image, without
+ * ever holding the rest of the image in memory. Rows in front of `first` are
+ * seeked over when possible, and rows after `last` are never read.
+ * 
+ * Parameters
+ *      FILE *input             a file positioned at the start of a P6 image
+ *      A2Methods_T methods     the methods suite used to create the pixel
+ *                              raster of the returned image
+ *      unsigned first          the first pixel row to read
+ *      unsigned last           one past the last pixel row to read; clipped to
+ *                              the height of the image
+ *      unsigned *fullHeight    set to the height of the whole image
+ *
+ * Returns
+ *      Pnm_ppm                 an image holding the requested band of rows,
+ *                              whose height is the number of rows read
+ *
+ * Notes
+ *      Will CRE if input, methods or fullHeight are NULL.
+ *      Will CRE if the image is not a raw PPM or ends early.
+ *      Will CRE if the band is empty once clipped to the image.
+ *      Allocates memory for the returned image; it is the responsibility of
+ *      the caller to free it with Pnm_ppmfree.
+ */
+Pnm_ppm readPPMRows(FILE *input, A2Methods_T methods, unsigned first,
+                    unsigned last, unsigned *fullHeight)
+{
+        assert(input != NULL);
+        assert(methods != NULL);
+        assert(fullHeight != NULL);
+        unsigned width, height, maxval;
+        readPPMHeader(input, &width, &height, &maxval);
+        *fullHeight = height;
+        if (last > height) {
+                last = height;
+        }
+        assert(first < last);
+
+        size_t sampleBytes = maxval < 256 ? 1 : 2;
+        size_t rowBytes = (size_t)width * 3 * sampleBytes;
+        skipBytes(input, (off_t)first * (off_t)rowBytes);
+
+        Pnm_ppm image;
+        NEW(image);
+        image->width = width;
+        image->height = last - first;
+        image->denominator = maxval;
+        image->methods = methods;
+        image->pixels = methods->new(width, last - first, 
+                                     sizeof(struct Pnm_rgb));
+
+        unsigned char *rowBuf = Alloc40_malloc(rowBytes);
+        assert(rowBuf != NULL || rowBytes == 0);
+        for (unsigned row = 0; row < last - first; row++) {
+                size_t got = fread(rowBuf, 1, rowBytes, input);
+                assert(got == rowBytes);
+                unsigned char *sample = rowBuf;
+                for (unsigned col = 0; col < width; col++) {
+                        unsigned vals[3];
+                        for (int i = 0; i < 3; i++) {
+                                vals[i] = sample[0];
+                                if (sampleBytes == 2) {
+                                        vals[i] = (vals[i] << 8) | sample[1];
+                                }
+                                sample += sampleBytes;
+                        }
+                        struct Pnm_rgb *pixel = methods->at(image->pixels, 
+                                                            col, row);
+                        pixel->red = vals[0];
+                        pixel->green = vals[1];
+                        pixel->blue = vals[2];
+                }
+        }
+        Alloc40_free(rowBuf);
+
+        return image;
+}
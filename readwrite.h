@@ -7,6 +7,7 @@
 #include "bitpack.h"
 #include "a2methods.h"
 #include "a2plain.h"
+#include "pnm.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <assert.h>
@@ -14,6 +15,15 @@
 
 void printCodeWords(A2Methods_UArray2 codeWords, A2Methods_T methods);
 A2Methods_UArray2 readCompressed(FILE *input, A2Methods_T methods);
+void writeCodeWords(A2Methods_UArray2 codeWords, A2Methods_T methods,
+                    unsigned char *out);
+void readCompressedHeader(FILE *input, unsigned *width, unsigned *height);
+void readPPMHeader(FILE *input, unsigned *width, unsigned *height,
+                   unsigned *maxval);
+void readPPMRow(FILE *input, unsigned width, unsigned maxval,
+                struct Pnm_rgb *row);
+Pnm_ppm readPPMRows(FILE *input, A2Methods_T methods, unsigned first,
+                    unsigned last, unsigned *fullHeight);
 
 
 #endif
\ No newline at end of file
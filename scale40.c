@@ -0,0 +1,480 @@
+/*
+ * scale40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * End-to-end scaling benchmark for 40image
+ *
+ * Usage: `./scale40 [-m maxside] [-w maxworkers] [-b bindir] [-t tmpdir]`
+ *
+ * Generates synthetic square PPM images (noise, a smooth gradient, and large
+ * flat tiles) with sides from 64 doubling up to `maxside` (default 2048;
+ * 32768 is a gigapixel), then compresses and decompresses each one with
+ * every A2Methods backend 40image offers and every worker count from 1
+ * doubling up to `maxworkers` (default: the number of online CPUs). One
+ * CSV row per run is printed to `stdout`.
+ *
+ * The codec itself is single-threaded, so N workers means N `40image -c
+ * --rows` processes compressing bands of the image at once, joined with
+ * 40merge, exactly as a fleet would shard a large image. Decompression has
+ * no row ranges and always runs as one process. Each run is timed over wall
+ * clock, and the peak resident set size is the largest of any process in
+ * the step. The RMS error is found once per image with ppmdiff, since every
+ * backend and worker count produces the same bytes.
+ *
+ * The programs are run from `bindir` (default `.`) and the images are written
+ * to `tmpdir` (default `/tmp`), which needs room for about three times the
+ * largest image (3 bytes per pixel each).
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+/* C standard library */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+/* POSIX */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/* CS 40 */
+#include "assert.h"
+
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+/* The most workers a run may use */
+#define MAX_WORKERS 256
+
+/* The room for a path built by this program */
+#define PATH_LEN 4096
+
+/* The synthetic images */
+enum pattern { NOISE, GRADIENT, FLAT, NUM_PATTERNS };
+static const char *const PATTERN_NAMES[NUM_PATTERNS] = {
+        "noise", "gradient", "flat"
+};
+
+/* The backends 40image accepts with --methods */
+static const char *const METHODS[] = { "plain", "blocked" };
+#define NUM_METHODS (sizeof(METHODS) / sizeof(METHODS[0]))
+
+/* Where the programs live and where the images go */
+static const char *binDir = ".";
+static const char *tmpDir = "/tmp";
+
+/*******************************************************************************
+ * Images
+ ******************************************************************************/
+
+/* pixelOf
+ *
+ * Gets one pixel of a synthetic image.
+ *
+ * Parameters
+ *      enum pattern pattern    the image
+ *      unsigned side           the width and height of the image
+ *      unsigned col, row       the pixel
+ *      uint64_t *seed          the state of the noise generator
+ *      unsigned char rgb[3]    set to the pixel
+ *
+ * Returns
+ *      None (void)
+ */
+static void pixelOf(enum pattern pattern, unsigned side, unsigned col,
+                    unsigned row, uint64_t *seed, unsigned char rgb[3])
+{
+        switch (pattern) {
+        case NOISE:
+                /* xorshift64; rand() is too slow for a gigapixel */
+                *seed ^= *seed << 13;
+                *seed ^= *seed >> 7;
+                *seed ^= *seed << 17;
+                rgb[0] = *seed;
+                rgb[1] = *seed >> 8;
+                rgb[2] = *seed >> 16;
+                break;
+        case GRADIENT:
+                rgb[0] = (uint64_t)col * 255 / (side - 1);
+                rgb[1] = (uint64_t)row * 255 / (side - 1);
+                rgb[2] = ((uint64_t)col + row) * 255 / (2 * side - 2);
+                break;
+        default:
+                /* one color per 256 x 256 tile */
+                rgb[0] = (col >> 8) * 53 + 40;
+                rgb[1] = (row >> 8) * 97 + 20;
+                rgb[2] = ((col >> 8) ^ (row >> 8)) * 31;
+                break;
+        }
+}
+
+/* writeImage
+ *
+ * Writes a synthetic raw PPM image to a file, one row at a time, so that
+ * even a gigapixel image needs only one row of memory.
+ *
+ * Parameters
+ *      const char *path        the file to write
+ *      enum pattern pattern    the image
+ *      unsigned side           the width and height of the image
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Will CRE if the file cannot be written.
+ */
+static void writeImage(const char *path, enum pattern pattern, unsigned side)
+{
+        FILE *fp = fopen(path, "wb");
+        assert(fp != NULL);
+        unsigned char *line = malloc((size_t)side * 3);
+        assert(line != NULL);
+        uint64_t seed = 0x9e3779b97f4a7c15ULL;
+
+        fprintf(fp, "P6\n%u %u\n255\n", side, side);
+        for (unsigned row = 0; row < side; row++) {
+                for (unsigned col = 0; col < side; col++) {
+                        pixelOf(pattern, side, col, row, &seed,
+                                line + (size_t)col * 3);
+                }
+                size_t wrote = fwrite(line, 3, side, fp);
+                assert(wrote == side);
+        }
+
+        free(line);
+        int closed = fclose(fp);
+        assert(closed == 0);
+}
+
+/*******************************************************************************
+ * Processes
+ ******************************************************************************/
+
+/* spawn
+ *
+ * Starts one of the programs with its standard output sent to a file.
+ *
+ * Parameters
+ *      char *argv[]            the program name (looked up in binDir) and
+ *                              its arguments, ending with NULL
+ *      const char *outPath     the file standard output is written to
+ *
+ * Returns
+ *      pid_t                   the process started
+ *
+ * Notes
+ *      Will CRE if the process cannot be started. If the program cannot be
+ *      run, the child prints an error and exits with failure.
+ */
+static pid_t spawn(char *argv[], const char *outPath)
+{
+        char program[PATH_LEN];
+        snprintf(program, sizeof(program), "%s/%s", binDir, argv[0]);
+
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (pid == 0) {
+                int fd = open(outPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd < 0 || dup2(fd, STDOUT_FILENO) < 0) {
+                        perror(outPath);
+                        _exit(EXIT_FAILURE);
+                }
+                close(fd);
+                execv(program, argv);
+                perror(program);
+                _exit(EXIT_FAILURE);
+        }
+        return pid;
+}
+
+/* finish
+ *
+ * Waits for a process started with spawn.
+ *
+ * Parameters
+ *      pid_t pid               the process
+ *      long *peakRssKB         raised to the peak resident set size of the
+ *                              process, in kilobytes, if that is larger
+ *
+ * Returns
+ *      None (void)
+ *
+ * Notes
+ *      Prints an error and exits with failure if the process failed, since
+ *      every later number would be meaningless.
+ */
+static void finish(pid_t pid, long *peakRssKB)
+{
+        int status;
+        struct rusage usage;
+        pid_t done = wait4(pid, &status, 0, &usage);
+        assert(done == pid);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) {
+                fprintf(stderr, "scale40: a child process failed\n");
+                exit(EXIT_FAILURE);
+        }
+        if (usage.ru_maxrss > *peakRssKB) {
+                *peakRssKB = usage.ru_maxrss;
+        }
+}
+
+/* nowSec
+ *
+ * Reads the monotonic clock.
+ *
+ * Returns
+ *      double                  the time in seconds
+ */
+static double nowSec(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* fileSize
+ *
+ * Gets the size of a file.
+ *
+ * Parameters
+ *      const char *path        the file
+ *
+ * Returns
+ *      long                    its size in bytes
+ *
+ * Notes
+ *      Will CRE if the file cannot be opened.
+ */
+static long fileSize(const char *path)
+{
+        FILE *fp = fopen(path, "rb");
+        assert(fp != NULL);
+        fseek(fp, 0, SEEK_END);
+        long size = ftell(fp);
+        fclose(fp);
+        return size;
+}
+
+/*******************************************************************************
+ * Runs
+ ******************************************************************************/
+
+/* compressSharded
+ *
+ * Compresses an image with a number of `40image -c --rows` processes running
+ * at once, then joins their shards with 40merge.
+ *
+ * Parameters
+ *      const char *input       the image
+ *      unsigned side           the width and height of the image
+ *      const char *methods     the backend given to --methods
+ *      int workers             the number of processes
+ *      const char *output      the file the compressed image is written to
+ *      long *peakRssKB         set to the largest peak resident set size of
+ *                              any of the processes
+ *
+ * Returns
+ *      None (void)
+ */
+static void compressSharded(const char *input, unsigned side,
+                            const char *methods, int workers,
+                            const char *output, long *peakRssKB)
+{
+        *peakRssKB = 0;
+        if (workers == 1) {
+                char *argv[] = { "40image", "-c", "--methods", (char *)methods,
+                                 (char *)input, NULL };
+                finish(spawn(argv, output), peakRssKB);
+                return;
+        }
+
+        /* even bands, so that only the last may hold an odd row */
+        unsigned band = (side + workers - 1) / workers;
+        band += band & 1;
+        static char shards[MAX_WORKERS][PATH_LEN];
+        static char ranges[MAX_WORKERS][32];
+        pid_t pids[MAX_WORKERS];
+        int count = 0;
+        for (unsigned first = 0; first < side; first += band) {
+                unsigned last = first + band < side ? first + band : side;
+                snprintf(shards[count], PATH_LEN, "%s/scale40.shard%d",
+                         tmpDir, count);
+                snprintf(ranges[count], 32, "%u:%u", first, last);
+                char *argv[] = { "40image", "-c", "--rows", ranges[count],
+                                 "--methods", (char *)methods, (char *)input,
+                                 NULL };
+                pids[count] = spawn(argv, shards[count]);
+                count++;
+        }
+        for (int i = 0; i < count; i++) {
+                finish(pids[i], peakRssKB);
+        }
+
+        char *argv[MAX_WORKERS + 2] = { "40merge" };
+        for (int i = 0; i < count; i++) {
+                argv[i + 1] = shards[i];
+        }
+        argv[count + 1] = NULL;
+        finish(spawn(argv, output), peakRssKB);
+        for (int i = 0; i < count; i++) {
+                remove(shards[i]);
+        }
+}
+
+/* rmsError
+ *
+ * Finds the RMS error between two images with ppmdiff.
+ *
+ * Parameters
+ *      const char *original    the image that was compressed
+ *      const char *restored    the image after decompression
+ *
+ * Returns
+ *      double                  the root mean square difference ppmdiff
+ *                              reports
+ *
+ * Notes
+ *      Will CRE if ppmdiff does not report a difference.
+ */
+static double rmsError(const char *original, const char *restored)
+{
+        char report[PATH_LEN];
+        snprintf(report, sizeof(report), "%s/scale40.diff", tmpDir);
+        char *argv[] = { "ppmdiff", (char *)original, (char *)restored, NULL };
+        long unused = 0;
+        finish(spawn(argv, report), &unused);
+
+        FILE *fp = fopen(report, "r");
+        assert(fp != NULL);
+        double rmse;
+        int read = fscanf(fp, "Diff is: %lf", &rmse);
+        assert(read == 1);
+        fclose(fp);
+        remove(report);
+        return rmse;
+}
+
+/* runImage
+ *
+ * Generates one synthetic image and prints a CSV row for every backend and
+ * worker count.
+ *
+ * Parameters
+ *      enum pattern pattern    the image
+ *      unsigned side           the width and height of the image
+ *      int maxWorkers          the largest worker count to try
+ *
+ * Returns
+ *      None (void)
+ */
+static void runImage(enum pattern pattern, unsigned side, int maxWorkers)
+{
+        char original[PATH_LEN], compressed[PATH_LEN], restored[PATH_LEN];
+        snprintf(original, PATH_LEN, "%s/scale40.ppm", tmpDir);
+        snprintf(compressed, PATH_LEN, "%s/scale40.comp", tmpDir);
+        snprintf(restored, PATH_LEN, "%s/scale40.out.ppm", tmpDir);
+        writeImage(original, pattern, side);
+
+        double pixels = (double)side * side;
+        double rmse = -1;
+        for (unsigned m = 0; m < NUM_METHODS; m++) {
+                for (int workers = 1; workers <= maxWorkers; workers *= 2) {
+                        long compressRssKB, decompressRssKB = 0;
+                        double start = nowSec();
+                        compressSharded(original, side, METHODS[m], workers,
+                                        compressed, &compressRssKB);
+                        double compressSec = nowSec() - start;
+
+                        char *argv[] = { "40image", "-d", "--methods",
+                                         (char *)METHODS[m], compressed,
+                                         NULL };
+                        start = nowSec();
+                        finish(spawn(argv, restored), &decompressRssKB);
+                        double decompressSec = nowSec() - start;
+
+                        if (rmse < 0) {
+                                rmse = rmsError(original, restored);
+                        }
+                        printf("%s,%u,%u,%.0f,%s,%d,%.6f,%.3f,%.6f,%.3f,"
+                               "%ld,%ld,%ld,%.6f\n",
+                               PATTERN_NAMES[pattern], side, side, pixels,
+                               METHODS[m], workers, compressSec,
+                               pixels / compressSec / 1e6, decompressSec,
+                               pixels / decompressSec / 1e6,
+                               fileSize(compressed), compressRssKB,
+                               decompressRssKB, rmse);
+                        fflush(stdout);
+                }
+        }
+
+        remove(original);
+        remove(compressed);
+        remove(restored);
+}
+
+/*******************************************************************************
+ * Main
+ ******************************************************************************/
+
+/* main
+ *
+ * Entry point for scale40; reads the options and runs every image.
+ *
+ * Parameters
+ *      int argc        (number of command-line arguments, including the
+ *                      program name)
+ *      char **argv     (array of strings representing command-line arguments)
+ *
+ * Returns
+ *      int             0 (EXIT_SUCCESS) if every run succeeded
+ *                      1 (EXIT_FAILURE) otherwise
+ */
+int main(int argc, char *argv[])
+{
+        unsigned maxSide = 2048;
+        long maxWorkers = sysconf(_SC_NPROCESSORS_ONLN);
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+                        maxSide = strtoul(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+                        maxWorkers = strtol(argv[++i], NULL, 10);
+                } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+                        binDir = argv[++i];
+                } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+                        tmpDir = argv[++i];
+                } else {
+                        fprintf(stderr, "Usage: %s [-m maxside] "
+                                "[-w maxworkers] [-b bindir] [-t tmpdir]\n",
+                                argv[0]);
+                        exit(EXIT_FAILURE);
+                }
+        }
+        if (maxSide < 64 || maxWorkers < 1 || maxWorkers > MAX_WORKERS) {
+                fprintf(stderr, "%s: need maxside >= 64 and 1 <= maxworkers "
+                        "<= %d\n", argv[0], MAX_WORKERS);
+                exit(EXIT_FAILURE);
+        }
+
+        printf("pattern,width,height,pixels,methods,workers,compress_s,"
+               "compress_mpix_s,decompress_s,decompress_mpix_s,"
+               "compressed_bytes,compress_peak_rss_kb,"
+               "decompress_peak_rss_kb,rmse\n");
+        for (unsigned side = 64; side <= maxSide; side *= 2) {
+                for (int p = 0; p < NUM_PATTERNS; p++) {
+                        runImage(p, side, maxWorkers);
+                }
+        }
+
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,447 @@
+/*
+ * stats40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements Stats40_T. Wall time comes from CLOCK_MONOTONIC and CPU time
+ * from CLOCK_PROCESS_CPUTIME_ID (both from the "real time" library the
+ * Makefile already links); the peak resident set size comes from getrusage.
+ * Hardware counters are started after the clocks are read and stopped before
+ * they are read again, so they count as little of our own bookkeeping as
+ * possible.
+ */
+
+#include <time.h>
+#include <sys/resource.h>
+
+#include "assert.h"
+#include "mem.h"
+
+#include "stats40.h"
+#include "counters40.h"
+#include "alloc40.h"
+
+#define T Stats40_T
+
+/* The most stages one set of statistics can hold */
+#define MAX_STAGES 16
+
+/* struct stage
+ *
+ * Holds the measurements of one stage.
+ *
+ * Components
+ *      const char *name        the name of the stage
+ *      double wallSec          the wall-clock time the stage took, in seconds
+ *      double cpuSec           the CPU time the stage took, in seconds
+ *      size_t pixels           the number of image pixels it processed
+ *      size_t bytes            the number of bytes it produced
+ *      long maxRssKB           the peak resident set size when it finished
+ *      uint64_t counts[]       the hardware counts of the stage, if counted
+ */
+struct stage {
+        const char *name;
+        double wallSec;
+        double cpuSec;
+        size_t pixels;
+        size_t bytes;
+        long maxRssKB;
+        uint64_t counts[COUNTERS40_NUM];
+};
+
+/* struct Stats40_T
+ *
+ * Holds private data for each set of statistics.
+ *
+ * Components
+ *      const char *mode        a name for the run
+ *      int count               the number of stages recorded so far
+ *      bool running            whether stage `count` is being timed
+ *      double wallStart        when the running stage started, wall clock
+ *      double cpuStart         when the running stage started, CPU clock
+ *      Counters40_T counters   the hardware counters; NULL if not counting
+ *      struct stage stages[]   the recorded stages
+ */
+struct T {
+        const char *mode;
+        int count;
+        bool running;
+        double wallStart;
+        double cpuStart;
+        Counters40_T counters;
+        struct stage stages[MAX_STAGES];
+};
+
+/* readClock
+ *
+ * Read a clock in seconds.
+ *
+ * Parameters
+ *      clockid_t clock         the clock to read
+ *
+ * Returns
+ *      double                  the time on the clock, in seconds
+ */
+static double readClock(clockid_t clock)
+{
+        struct timespec now;
+        clock_gettime(clock, &now);
+        return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/* peakRssKB
+ *
+ * Get the peak resident set size of the process so far.
+ *
+ * Returns
+ *      long                    the peak resident set size, in kilobytes
+ */
+static long peakRssKB(void)
+{
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        return usage.ru_maxrss;
+}
+
+/* Stats40_new
+ *
+ * Allocate a new, empty set of stage statistics.
+ *
+ * Parameters
+ *      const char *mode        a name for the run, such as "compress"; must
+ *                              outlive the statistics
+ *
+ * Returns
+ *      T                       the created statistics
+ *
+ * Notes
+ *      Allocates memory; it is the responsibility of the client to free it
+ *      with Stats40_free().
+ */
+extern T Stats40_new(const char *mode)
+{
+        T stats;
+        NEW(stats);
+        stats->mode = mode;
+        stats->count = 0;
+        stats->running = false;
+        stats->counters = NULL;
+        return stats;
+}
+
+/* Stats40_free
+ *
+ * Deallocate and clear the given pointer to a set of statistics.
+ *
+ * Parameters
+ *      T *stats                the address of the statistics to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `stats` is NULL. Does nothing if `*stats` is NULL.
+ */
+extern void Stats40_free(T *stats)
+{
+        assert(stats != NULL);
+        if (*stats != NULL) {
+                if ((*stats)->counters != NULL) {
+                        Counters40_free(&(*stats)->counters);
+                }
+                FREE(*stats);
+        }
+}
+
+/* Stats40_count_hardware
+ *
+ * Also read hardware performance counters around every stage recorded from
+ * now on.
+ *
+ * Parameters
+ *      T stats                 the statistics to record into, or NULL
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Counters the system will not provide are reported as unavailable.
+ */
+extern void Stats40_count_hardware(T stats)
+{
+        if (stats != NULL && stats->counters == NULL) {
+                stats->counters = Counters40_new();
+        }
+}
+
+/* Stats40_start
+ *
+ * Start timing a stage.
+ *
+ * Parameters
+ *      T stats                 the statistics to record into, or NULL
+ *      const char *stage       the name of the stage; must outlive the
+ *                              statistics
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if a stage is already being timed, or if more stages are
+ *      recorded than the statistics have room for.
+ */
+extern void Stats40_start(T stats, const char *stage)
+{
+        if (stats == NULL) {
+                return;
+        }
+        assert(!stats->running);
+        assert(stats->count < MAX_STAGES);
+        stats->stages[stats->count].name = stage;
+        stats->running = true;
+        stats->wallStart = readClock(CLOCK_MONOTONIC);
+        stats->cpuStart = readClock(CLOCK_PROCESS_CPUTIME_ID);
+        if (stats->counters != NULL) {
+                Counters40_start(stats->counters);
+        }
+}
+
+/* Stats40_stop
+ *
+ * Stop timing the current stage.
+ *
+ * Parameters
+ *      T stats                 the statistics to record into, or NULL
+ *      size_t pixels           the number of image pixels the stage processed
+ *      size_t bytes            the number of bytes the stage produced
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if no stage is being timed.
+ */
+extern void Stats40_stop(T stats, size_t pixels, size_t bytes)
+{
+        if (stats == NULL) {
+                return;
+        }
+        assert(stats->running);
+        struct stage *stage = &stats->stages[stats->count];
+        if (stats->counters != NULL) {
+                Counters40_stop(stats->counters, stage->counts);
+        }
+        double cpuEnd = readClock(CLOCK_PROCESS_CPUTIME_ID);
+        double wallEnd = readClock(CLOCK_MONOTONIC);
+
+        stage->wallSec = wallEnd - stats->wallStart;
+        stage->cpuSec = cpuEnd - stats->cpuStart;
+        stage->pixels = pixels;
+        stage->bytes = bytes;
+        stage->maxRssKB = peakRssKB();
+        stats->count++;
+        stats->running = false;
+}
+
+/* megapixelsPerSec
+ *
+ * Get the throughput of a stage.
+ *
+ * Parameters
+ *      struct stage *stage     a recorded stage
+ *
+ * Returns
+ *      double                  the pixels processed per second of wall time,
+ *                              in millions; 0 if the stage took no time
+ */
+static double megapixelsPerSec(struct stage *stage)
+{
+        if (stage->wallSec <= 0) {
+                return 0;
+        }
+        return stage->pixels / stage->wallSec / 1e6;
+}
+
+/* counted
+ *
+ * Tell whether a stage has a real count from one counter.
+ *
+ * Parameters
+ *      T stats                 the statistics, with hardware counters on
+ *      struct stage *stage     a recorded stage
+ *      int which               the index of the counter
+ *
+ * Returns
+ *      bool                    false if the counter is unavailable or was
+ *                              never scheduled during the stage
+ */
+static bool counted(T stats, struct stage *stage, int which)
+{
+        return Counters40_available(stats->counters, which) &&
+               stage->counts[which] != COUNTERS40_NOT_COUNTED;
+}
+
+/* reportCountsJson
+ *
+ * Print the hardware counts of one stage as JSON members, null for counters
+ * that are unavailable and "not counted" for those never scheduled.
+ *
+ * Parameters
+ *      T stats                 the statistics being printed
+ *      struct stage *stage     a recorded stage
+ *      FILE *out               where to print them
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Prints nothing if hardware counters are off.
+ */
+static void reportCountsJson(T stats, struct stage *stage, FILE *out)
+{
+        Counters40_T counters = stats->counters;
+        if (counters == NULL) {
+                return;
+        }
+        for (int i = 0; i < COUNTERS40_NUM; i++) {
+                if (counted(stats, stage, i)) {
+                        fprintf(out, ", \"%s\": %llu", Counters40_name(i),
+                                (unsigned long long)stage->counts[i]);
+                } else if (Counters40_available(counters, i)) {
+                        fprintf(out, ", \"%s\": \"not counted\"",
+                                Counters40_name(i));
+                } else {
+                        fprintf(out, ", \"%s\": null", Counters40_name(i));
+                }
+        }
+        if (counted(stats, stage, COUNTERS40_CYCLES) &&
+            counted(stats, stage, COUNTERS40_INSTRUCTIONS) &&
+            stage->counts[COUNTERS40_CYCLES] > 0) {
+                fprintf(out, ", \"ipc\": %.3f",
+                        (double)stage->counts[COUNTERS40_INSTRUCTIONS] /
+                        stage->counts[COUNTERS40_CYCLES]);
+        } else {
+                fprintf(out, ", \"ipc\": null");
+        }
+}
+
+/* reportCountsTable
+ *
+ * Print the hardware counts of every stage as a table, n/a for counters that
+ * are unavailable and "not counted" for those never scheduled in a stage.
+ *
+ * Parameters
+ *      T stats                 the statistics being printed
+ *      FILE *out               where to print them
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Prints nothing if hardware counters are off.
+ */
+static void reportCountsTable(T stats, FILE *out)
+{
+        Counters40_T counters = stats->counters;
+        if (counters == NULL) {
+                return;
+        }
+        fprintf(out, "%-10s %6s", "counters", "IPC");
+        for (int i = COUNTERS40_CACHE_MISSES; i < COUNTERS40_NUM; i++) {
+                fprintf(out, " %14s", Counters40_name(i));
+        }
+        fprintf(out, "\n");
+        for (int s = 0; s < stats->count; s++) {
+                struct stage *stage = &stats->stages[s];
+                fprintf(out, "%-10s", stage->name);
+                if (counted(stats, stage, COUNTERS40_CYCLES) &&
+                    counted(stats, stage, COUNTERS40_INSTRUCTIONS) &&
+                    stage->counts[COUNTERS40_CYCLES] > 0) {
+                        fprintf(out, " %6.2f",
+                                (double)stage->counts[COUNTERS40_INSTRUCTIONS] /
+                                stage->counts[COUNTERS40_CYCLES]);
+                } else {
+                        fprintf(out, " %6s", "n/a");
+                }
+                for (int i = COUNTERS40_CACHE_MISSES; i < COUNTERS40_NUM; i++) {
+                        if (counted(stats, stage, i)) {
+                                fprintf(out, " %14llu",
+                                        (unsigned long long)stage->counts[i]);
+                        } else if (Counters40_available(counters, i)) {
+                                fprintf(out, " %14s", "not counted");
+                        } else {
+                                fprintf(out, " %14s", "n/a");
+                        }
+                }
+                fprintf(out, "\n");
+        }
+}
+
+/* Stats40_report
+ *
+ * Print the recorded statistics.
+ *
+ * Parameters
+ *      T stats                 the statistics to print, or NULL
+ *      FILE *out               where to print them
+ *      bool json               print one JSON object instead of a table
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `out` is NULL.
+ */
+extern void Stats40_report(T stats, FILE *out, bool json)
+{
+        assert(out != NULL);
+        if (stats == NULL) {
+                return;
+        }
+
+        double wallTotal = 0, cpuTotal = 0;
+        for (int i = 0; i < stats->count; i++) {
+                wallTotal += stats->stages[i].wallSec;
+                cpuTotal += stats->stages[i].cpuSec;
+        }
+
+        if (json) {
+                fprintf(out, "{\"mode\": \"%s\", \"stages\": [", stats->mode);
+                for (int i = 0; i < stats->count; i++) {
+                        struct stage *stage = &stats->stages[i];
+                        fprintf(out, "%s\n  {\"stage\": \"%s\", "
+                                "\"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+                                "\"mpix_per_s\": %.3f, \"pixels\": %zu, "
+                                "\"bytes\": %zu, \"max_rss_kb\": %ld",
+                                i > 0 ? "," : "", stage->name,
+                                stage->wallSec * 1e3, stage->cpuSec * 1e3,
+                                megapixelsPerSec(stage), stage->pixels,
+                                stage->bytes, stage->maxRssKB);
+                        reportCountsJson(stats, stage, out);
+                        fprintf(out, "}");
+                }
+                fprintf(out, "],\n \"wall_ms\": %.3f, \"cpu_ms\": %.3f, "
+                        "\"peak_rss_kb\": %ld,\n \"allocations\": ",
+                        wallTotal * 1e3, cpuTotal * 1e3, peakRssKB());
+                Alloc40_report(out, true);
+                fprintf(out, "}\n");
+                return;
+        }
+
+        fprintf(out, "%-10s %10s %10s %9s %14s %12s\n", stats->mode,
+                "wall ms", "cpu ms", "MPix/s", "bytes", "max RSS KB");
+        for (int i = 0; i < stats->count; i++) {
+                struct stage *stage = &stats->stages[i];
+                fprintf(out, "%-10s %10.3f %10.3f %9.2f %14zu %12ld\n",
+                        stage->name, stage->wallSec * 1e3,
+                        stage->cpuSec * 1e3, megapixelsPerSec(stage),
+                        stage->bytes, stage->maxRssKB);
+        }
+        fprintf(out, "%-10s %10.3f %10.3f\n", "total", wallTotal * 1e3,
+                cpuTotal * 1e3);
+        fprintf(out, "peak RSS: %ld KB\n", peakRssKB());
+        reportCountsTable(stats, out);
+        Alloc40_report(out, false);
+}
+
+#undef T
@@ -0,0 +1,131 @@
+/*
+ * stats40.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Defines Stats40_T, which records how long each stage of compressing or
+ * decompressing an image takes. For every stage it keeps the wall-clock time,
+ * the CPU time, the number of pixels processed and the number of bytes the
+ * stage produced, and it reports them (plus throughput in megapixels per
+ * second and the peak resident set size of the process) as a table or as
+ * JSON. Optionally it also reads hardware performance counters (see
+ * counters40.h) around every stage. Reports end with the memory allocated
+ * under each stage's tag (see alloc40.h).
+ *
+ * Every function accepts a NULL Stats40_T and then does nothing, so callers
+ * can leave the calls in place when no statistics are wanted.
+ */
+
+#ifndef STATS40_H
+#define STATS40_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define T Stats40_T
+typedef struct T *T;
+
+/* Stats40_new
+ *
+ * Allocate a new, empty set of stage statistics.
+ *
+ * Parameters
+ *      const char *mode        a name for the run, such as "compress"; must
+ *                              outlive the statistics
+ *
+ * Returns
+ *      T                       the created statistics
+ *
+ * Notes
+ *      Allocates memory; it is the responsibility of the client to free it
+ *      with Stats40_free().
+ */
+extern T Stats40_new(const char *mode);
+
+/* Stats40_free
+ *
+ * Deallocate and clear the given pointer to a set of statistics.
+ *
+ * Parameters
+ *      T *stats                the address of the statistics to deallocate
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `stats` is NULL. Does nothing if `*stats` is NULL.
+ */
+extern void Stats40_free(T *stats);
+
+/* Stats40_count_hardware
+ *
+ * Also read hardware performance counters (cycles, instructions, cache, TLB
+ * and branch misses) around every stage recorded from now on.
+ *
+ * Parameters
+ *      T stats                 the statistics to record into, or NULL
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Counters the system will not provide are reported as unavailable.
+ *      Counts are for the calling thread only.
+ */
+extern void Stats40_count_hardware(T stats);
+
+/* Stats40_start
+ *
+ * Start timing a stage.
+ *
+ * Parameters
+ *      T stats                 the statistics to record into, or NULL
+ *      const char *stage       the name of the stage; must outlive the
+ *                              statistics
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if a stage is already being timed, or if more stages are
+ *      recorded than the statistics have room for.
+ */
+extern void Stats40_start(T stats, const char *stage);
+
+/* Stats40_stop
+ *
+ * Stop timing the current stage.
+ *
+ * Parameters
+ *      T stats                 the statistics to record into, or NULL
+ *      size_t pixels           the number of image pixels the stage processed
+ *      size_t bytes            the number of bytes the stage produced
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if no stage is being timed.
+ */
+extern void Stats40_stop(T stats, size_t pixels, size_t bytes);
+
+/* Stats40_report
+ *
+ * Print the recorded statistics.
+ *
+ * Parameters
+ *      T stats                 the statistics to print, or NULL
+ *      FILE *out               where to print them
+ *      bool json               print one JSON object instead of a table
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `out` is NULL.
+ */
+extern void Stats40_report(T stats, FILE *out, bool json);
+
+#undef T
+#endif
@@ -0,0 +1,370 @@
+/*
+ * test40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Tests of 64-bit sizing in UArray2, UArray2b and the image header readers
+ *
+ * Usage: `./test40`, or `make check`
+ *
+ * Makes a UArray2 and a UArray2b of SIDE by SIDE 4-byte elements: 2^32
+ * elements and 16 GB. Their storage is mapped without reserving swap and
+ * only a few pages are ever touched, so the test takes milliseconds and
+ * almost no memory. Each array is checked at its four far corners, and
+ * the UArray2 also through a view and a crop that start deep inside it.
+ *
+ * Sizes that overflow a size_t and headers whose dimensions are over INT_MAX
+ * must be rejected; each is tried in a child process, which must not exit
+ * normally, since a CRE cannot be caught.
+ *
+ * Prints each failed check to `stderr`, and exits with failure if there was
+ * any.
+ */
+
+/*******************************************************************************
+ * Includes
+ ******************************************************************************/
+
+/* C standard library */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+
+/* POSIX */
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+/* CS 40 */
+#include "assert.h"
+#include "uarray2b.h"
+
+/* Ours */
+#include "uarray2.h"
+#include "readwrite.h"
+#include "codec40.h"
+
+/*******************************************************************************
+ * Constants
+ ******************************************************************************/
+
+/* The side of the large arrays: SIDE * SIDE is 2^32, so the index of an
+ * element of the last row is past INT_MAX as well as its byte offset */
+#define SIDE 65536
+
+/* The side of a block of the large UArray2b; 4 MB blocks are mapped lazily */
+#define BLOCKSIZE 1024
+
+/* The header every compressed image starts with */
+#define COMP40_MAGIC "COMP40 Compressed image format 2\n"
+
+/*******************************************************************************
+ * Checks
+ ******************************************************************************/
+
+/* The number of failed checks */
+static int failures = 0;
+
+/* check
+ *
+ * Records one check, printing it if it failed.
+ *
+ * Parameters
+ *      bool passed             whether the check passed
+ *      const char *what        what was checked
+ *
+ * Returns
+ *      None (void)
+ */
+static void check(bool passed, const char *what)
+{
+        if (!passed) {
+                fprintf(stderr, "test40: FAILED: %s\n", what);
+                failures++;
+        }
+}
+
+/* rejects
+ *
+ * Tells whether a call is rejected with a CRE, by making it in a child
+ * process.
+ *
+ * Parameters
+ *      void call(const void *arg)
+ *                              the call to make
+ *      const void *arg         passed to call
+ *
+ * Returns
+ *      bool                    true if the child did not exit normally after
+ *                              the call
+ *
+ * Notes
+ *      Will CRE if the child cannot be started. The child's `stderr` is
+ *      thrown away, so the message of the expected CRE is not printed.
+ */
+static bool rejects(void call(const void *arg), const void *arg)
+{
+        fflush(NULL);
+        pid_t pid = fork();
+        assert(pid >= 0);
+        if (pid == 0) {
+                int fd = open("/dev/null", O_WRONLY);
+                if (fd >= 0) {
+                        dup2(fd, STDERR_FILENO);
+                        close(fd);
+                }
+                call(arg);
+                _exit(EXIT_SUCCESS);
+        }
+
+        int status;
+        pid_t waited = waitpid(pid, &status, 0);
+        assert(waited == pid);
+        return !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS;
+}
+
+/*******************************************************************************
+ * Large arrays
+ ******************************************************************************/
+
+/* testUArray2
+ *
+ * Checks a UArray2 of more than 2^31 elements and 4 GB at its far corners,
+ * and through a view and a crop.
+ *
+ * Parameters
+ *      None
+ *
+ * Returns
+ *      None (void)
+ */
+static void testUArray2(void)
+{
+        UArray2_T array = UArray2_new_storage(SIDE, SIDE, sizeof(uint32_t), 0);
+        int last = SIDE - 1;
+        int corners[4][2] = { { 0, 0 }, { last, 0 }, { 0, last },
+                              { last, last } };
+
+        for (int i = 0; i < 4; i++) {
+                uint32_t *elem = UArray2_at(array, corners[i][0],
+                                            corners[i][1]);
+                *elem = 0xc0de0000u + i;
+        }
+        for (int i = 0; i < 4; i++) {
+                uint32_t *elem = UArray2_at(array, corners[i][0],
+                                            corners[i][1]);
+                check(*elem == 0xc0de0000u + i,
+                      "UArray2 corner holds its value");
+        }
+
+        char *first = UArray2_at(array, 0, 0);
+        char *end = UArray2_at(array, last, last);
+        size_t span = ((size_t)SIDE * SIDE - 1) * sizeof(uint32_t);
+        check((size_t)(end - first) == span,
+              "UArray2 far corner is past 4 GB from the first element");
+
+        /* a view of the bottom-right quarter, starting past 2^31 bytes */
+        int half = SIDE / 2;
+        UArray2_T view = UArray2_view(array, half, half, SIDE - half,
+                                      SIDE - half);
+        check(UArray2_at(view, 0, 0) == UArray2_at(array, half, half),
+              "UArray2 view starts at its offset");
+        check(UArray2_at(view, last - half, last - half) == end,
+              "UArray2 view reaches the far corner");
+        check(*(uint32_t *)UArray2_at(view, last - half, 0) ==
+              *(uint32_t *)UArray2_at(array, last, half),
+              "UArray2 view shares its elements");
+
+        /* narrowed again, so the offsets add up */
+        UArray2_crop(view, 1, half - 1, last - half, SIDE - 2 * half + 1);
+        check(UArray2_at(view, 0, 0) ==
+              UArray2_at(array, half + 1, 2 * half - 1),
+              "UArray2 crop of a view starts at both offsets");
+        check(UArray2_at(view, last - half - 1, SIDE - 2 * half) == end,
+              "UArray2 crop of a view reaches the far corner");
+        check(*(uint32_t *)UArray2_at(view, last - half - 1,
+                                      SIDE - 2 * half) == 0xc0de0003u,
+              "UArray2 crop of a view reads the far corner");
+        UArray2_free(&view);
+
+        /* the array itself cropped to its last row */
+        UArray2_crop(array, 0, last, SIDE, 1);
+        check(*(uint32_t *)UArray2_at(array, 0, 0) == 0xc0de0002u &&
+              *(uint32_t *)UArray2_at(array, last, 0) == 0xc0de0003u,
+              "UArray2 cropped to its last row reads its corners");
+        UArray2_free(&array);
+}
+
+/* testUArray2b
+ *
+ * Checks a UArray2b of more than 2^31 elements and 4 GB at its far corners.
+ *
+ * Parameters
+ *      None
+ *
+ * Returns
+ *      None (void)
+ */
+static void testUArray2b(void)
+{
+        UArray2b_T array = UArray2b_new(SIDE, SIDE, sizeof(uint32_t),
+                                        BLOCKSIZE);
+        int last = SIDE - 1;
+        int corners[4][2] = { { 0, 0 }, { last, 0 }, { 0, last },
+                              { last, last } };
+
+        for (int i = 0; i < 4; i++) {
+                uint32_t *elem = UArray2b_at(array, corners[i][0],
+                                             corners[i][1]);
+                *elem = 0xb10c0000u + i;
+        }
+        for (int i = 0; i < 4; i++) {
+                uint32_t *elem = UArray2b_at(array, corners[i][0],
+                                             corners[i][1]);
+                check(*elem == 0xb10c0000u + i,
+                      "UArray2b corner holds its value");
+        }
+        check((char *)UArray2b_at(array, last, last) -
+              (char *)UArray2b_at(array, last - 1, last) == sizeof(uint32_t),
+              "UArray2b far corner follows its neighbor in its block");
+        UArray2b_free(&array);
+}
+
+/*******************************************************************************
+ * Rejected sizes and headers
+ ******************************************************************************/
+
+/* newUArray2
+ *
+ * Makes, in a child of rejects, a UArray2 with the dimensions given.
+ *
+ * Parameters
+ *      const void *arg         the width, height and size, as an int[3]
+ */
+static void newUArray2(const void *arg)
+{
+        const int *dims = arg;
+        UArray2_T array = UArray2_new(dims[0], dims[1], dims[2]);
+        UArray2_free(&array);
+}
+
+/* newUArray2b
+ *
+ * Makes, in a child of rejects, a UArray2b with the dimensions given.
+ *
+ * Parameters
+ *      const void *arg         the width, height, size and blocksize, as an
+ *                              int[4]
+ */
+static void newUArray2b(const void *arg)
+{
+        const int *dims = arg;
+        UArray2b_T array = UArray2b_new(dims[0], dims[1], dims[2], dims[3]);
+        UArray2b_free(&array);
+}
+
+/* readHeader
+ *
+ * Reads, in a child of rejects, a compressed image header.
+ *
+ * Parameters
+ *      const void *arg         the header, as a string
+ */
+static void readHeader(const void *arg)
+{
+        FILE *input = fmemopen((void *)arg, strlen(arg), "r");
+        assert(input != NULL);
+        unsigned width, height;
+        readCompressedHeader(input, &width, &height);
+        fclose(input);
+}
+
+/* readPPM
+ *
+ * Reads, in a child of rejects, a PPM header.
+ *
+ * Parameters
+ *      const void *arg         the header, as a string
+ */
+static void readPPM(const void *arg)
+{
+        FILE *input = fmemopen((void *)arg, strlen(arg), "r");
+        assert(input != NULL);
+        unsigned width, height, maxval;
+        readPPMHeader(input, &width, &height, &maxval);
+        fclose(input);
+}
+
+/* dimensionsRead
+ *
+ * Tells whether Codec40_dimensions accepts a compressed image header.
+ *
+ * Parameters
+ *      const char *header      the header
+ *
+ * Returns
+ *      bool                    whether it was accepted
+ */
+static bool dimensionsRead(const char *header)
+{
+        unsigned width, height;
+        return Codec40_dimensions(header, strlen(header), &width, &height);
+}
+
+/* testRejected
+ *
+ * Checks that sizes that overflow and headers over INT_MAX are rejected,
+ * and that those at INT_MAX are not.
+ *
+ * Parameters
+ *      None
+ *
+ * Returns
+ *      None (void)
+ */
+static void testRejected(void)
+{
+        static const int hugeElems[3] = { INT_MAX, INT_MAX, INT_MAX };
+        static const int hugeBlocks[4] = { INT_MAX, INT_MAX, 1, 1 };
+        static const int wide[3] = { INT_MAX, 1, 1 };
+        check(rejects(newUArray2, hugeElems),
+              "UArray2_new rejects a size that overflows");
+        check(rejects(newUArray2b, hugeBlocks),
+              "UArray2b_new rejects a block count that overflows");
+        check(!rejects(newUArray2, wide),
+              "UArray2_new accepts a width of INT_MAX");
+
+        check(rejects(readHeader, COMP40_MAGIC "2147483648 2\n"),
+              "readCompressedHeader rejects a width over INT_MAX");
+        check(rejects(readHeader, COMP40_MAGIC "2 4294967298\n"),
+              "readCompressedHeader rejects a height over UINT_MAX");
+        check(!rejects(readHeader, COMP40_MAGIC "2147483647 2\n"),
+              "readCompressedHeader accepts a width of INT_MAX");
+        check(rejects(readPPM, "P6\n2 2147483648\n255\n"),
+              "readPPMHeader rejects a height over INT_MAX");
+        check(!rejects(readPPM, "P6\n2 2147483647\n255\n"),
+              "readPPMHeader accepts a height of INT_MAX");
+
+        check(!dimensionsRead(COMP40_MAGIC "2147483648 1\n"),
+              "Codec40_dimensions rejects a width over INT_MAX");
+        check(dimensionsRead(COMP40_MAGIC "2147483647 1\n"),
+              "Codec40_dimensions accepts a width of INT_MAX");
+}
+
+int main(void)
+{
+        testUArray2();
+        testUArray2b();
+        testRejected();
+
+        if (failures > 0) {
+                fprintf(stderr, "test40: %d checks failed\n", failures);
+                return EXIT_FAILURE;
+        }
+        printf("test40: all checks passed\n");
+        return EXIT_SUCCESS;
+}
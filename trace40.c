@@ -0,0 +1,273 @@
+/*
+ * trace40.c
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Implements the trace recorder. Each thread lazily gets a buffer of events,
+ * found through a thread-local pointer; the only lock is taken when a thread
+ * records its first span, to link its buffer into the list Trace40_stop
+ * walks. Events are Chrome "complete" events (phase "X"): a start time and a
+ * duration in microseconds from the start of recording.
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "assert.h"
+#include "mem.h"
+
+#include "trace40.h"
+
+/* The deepest spans can nest */
+#define MAX_DEPTH 16
+
+/* The longest span name kept, plus its terminator */
+#define NAME_LEN 32
+
+/* struct event
+ *
+ * Holds one finished span.
+ *
+ * Components
+ *      const char *category    the kind of span
+ *      char name[]             what the span was
+ *      double start            when it started, in microseconds
+ *      double duration         how long it took, in microseconds
+ */
+struct event {
+        const char *category;
+        char name[NAME_LEN];
+        double start;
+        double duration;
+};
+
+/* struct buffer
+ *
+ * Holds the events of one thread.
+ *
+ * Components
+ *      long tid                the kernel's id of the thread
+ *      struct event *events    the finished spans, in the order they ended
+ *      size_t count, capacity  how many events there are and there is room for
+ *      int depth               how many spans are open
+ *      struct event open[]     the open spans, outermost first
+ *      struct buffer *next     the buffer of another thread
+ */
+struct buffer {
+        long tid;
+        struct event *events;
+        size_t count, capacity;
+        int depth;
+        struct event open[MAX_DEPTH];
+        struct buffer *next;
+};
+
+static bool recording = false;
+static char *tracePath = NULL;
+static double origin;
+static pthread_mutex_t buffersLock = PTHREAD_MUTEX_INITIALIZER;
+static struct buffer *buffers = NULL;
+static __thread struct buffer *local = NULL;
+
+/* nowUs
+ *
+ * Read the monotonic clock, in microseconds.
+ */
+static double nowUs(void)
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+/* localBuffer
+ *
+ * Get the buffer of the calling thread, making it on first use.
+ *
+ * Returns
+ *      struct buffer *         the buffer
+ */
+static struct buffer *localBuffer(void)
+{
+        if (local == NULL) {
+                NEW0(local);
+                local->tid = syscall(SYS_gettid);
+                pthread_mutex_lock(&buffersLock);
+                local->next = buffers;
+                buffers = local;
+                pthread_mutex_unlock(&buffersLock);
+        }
+        return local;
+}
+
+/* Trace40_start
+ *
+ * Start recording trace events.
+ *
+ * Parameters
+ *      const char *path        the file the events are written to
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if path is NULL or recording has already started.
+ *      Call before starting any threads that record.
+ *      The file is written by Trace40_stop, or at exit if that is never
+ *      called.
+ */
+extern void Trace40_start(const char *path)
+{
+        assert(path != NULL);
+        assert(!recording);
+        tracePath = ALLOC(strlen(path) + 1);
+        strcpy(tracePath, path);
+        origin = nowUs();
+        recording = true;
+        atexit(Trace40_stop);
+}
+
+/* writeEvents
+ *
+ * Write the events of every thread as a Chrome trace.
+ *
+ * Parameters
+ *      FILE *out               where to write them
+ *
+ * Returns
+ *      (Nothing.)
+ */
+static void writeEvents(FILE *out)
+{
+        long pid = getpid();
+        bool first = true;
+        fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [");
+        for (struct buffer *b = buffers; b != NULL; b = b->next) {
+                fprintf(out, "%s\n{\"name\": \"thread_name\", \"ph\": \"M\", "
+                        "\"pid\": %ld, \"tid\": %ld, \"args\": {\"name\": "
+                        "\"%s %ld\"}}", first ? "" : ",", pid, b->tid,
+                        b->tid == pid ? "main" : "thread", b->tid);
+                first = false;
+                for (size_t i = 0; i < b->count; i++) {
+                        struct event *e = &b->events[i];
+                        fprintf(out, ",\n{\"name\": \"%s\", \"cat\": \"%s\", "
+                                "\"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+                                "\"pid\": %ld, \"tid\": %ld}", e->name,
+                                e->category, e->start, e->duration, pid,
+                                b->tid);
+                }
+        }
+        fprintf(out, "\n]}\n");
+}
+
+/* Trace40_stop
+ *
+ * Stop recording and write every thread's events to the file.
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Does nothing if not recording.
+ *      Call after every thread that records has finished.
+ *      Prints a message to `stderr` if the file cannot be written.
+ */
+extern void Trace40_stop(void)
+{
+        if (!recording) {
+                return;
+        }
+        recording = false;
+
+        FILE *out = fopen(tracePath, "w");
+        if (out == NULL) {
+                perror(tracePath);
+        } else {
+                writeEvents(out);
+                fclose(out);
+        }
+
+        while (buffers != NULL) {
+                struct buffer *b = buffers;
+                buffers = b->next;
+                FREE(b->events);
+                FREE(b);
+        }
+        local = NULL;
+        FREE(tracePath);
+}
+
+/* Trace40_begin
+ *
+ * Start a span on the calling thread.
+ *
+ * Parameters
+ *      const char *category    the kind of span, such as "stage" or "io";
+ *                              must outlive the recording
+ *      const char *name        what the span is; copied, and cut to 31
+ *                              characters
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Spans nest at most 16 deep; deeper spans are not recorded.
+ */
+extern void Trace40_begin(const char *category, const char *name)
+{
+        if (!recording) {
+                return;
+        }
+        struct buffer *b = localBuffer();
+        if (b->depth < MAX_DEPTH) {
+                struct event *e = &b->open[b->depth];
+                e->category = category;
+                strncpy(e->name, name, NAME_LEN - 1);
+                e->name[NAME_LEN - 1] = '\0';
+                e->start = nowUs() - origin;
+        }
+        b->depth++;
+}
+
+/* Trace40_end
+ *
+ * End the innermost span started on the calling thread.
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if no span is open on the calling thread.
+ */
+extern void Trace40_end(void)
+{
+        if (!recording) {
+                return;
+        }
+        double end = nowUs() - origin;
+        struct buffer *b = localBuffer();
+        assert(b->depth > 0);
+        b->depth--;
+        if (b->depth >= MAX_DEPTH) {
+                return;
+        }
+
+        if (b->count == b->capacity) {
+                if (b->capacity == 0) {
+                        b->capacity = 64;
+                        b->events = ALLOC(b->capacity * sizeof(struct event));
+                } else {
+                        b->capacity *= 2;
+                        RESIZE(b->events, b->capacity * sizeof(struct event));
+                }
+        }
+        struct event *e = &b->events[b->count++];
+        *e = b->open[b->depth];
+        e->duration = end - e->start;
+}
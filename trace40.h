@@ -0,0 +1,82 @@
+/*
+ * trace40.h
+ * by Rigoberto Rodriguez-Anton (rrodi08), Rebecca Lee (rlee19)
+ * arith
+ *
+ * Records a timeline of what the codec does as Chrome trace events, the JSON
+ * format read by chrome://tracing and https://ui.perfetto.dev. Every event
+ * is a span with a name, a category (such as "stage" or "io") and the id of
+ * the thread that ran it; spans may nest.
+ *
+ * Each thread records into its own buffer, so recording takes no lock and
+ * costs two clock reads per span. The buffers are written out when recording
+ * stops, or when the program exits. Every function does nothing while
+ * nothing is being recorded, so callers can leave the calls in place.
+ */
+
+#ifndef TRACE40_H
+#define TRACE40_H
+
+/* Trace40_start
+ *
+ * Start recording trace events.
+ *
+ * Parameters
+ *      const char *path        the file the events are written to
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if path is NULL or recording has already started.
+ *      Call before starting any threads that record.
+ *      The file is written by Trace40_stop, or at exit if that is never
+ *      called.
+ */
+extern void Trace40_start(const char *path);
+
+/* Trace40_stop
+ *
+ * Stop recording and write every thread's events to the file.
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Does nothing if not recording.
+ *      Call after every thread that records has finished.
+ *      Prints a message to `stderr` if the file cannot be written.
+ */
+extern void Trace40_stop(void);
+
+/* Trace40_begin
+ *
+ * Start a span on the calling thread.
+ *
+ * Parameters
+ *      const char *category    the kind of span, such as "stage" or "io";
+ *                              must outlive the recording
+ *      const char *name        what the span is; copied, and cut to 31
+ *                              characters
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Spans nest at most 16 deep; deeper spans are not recorded.
+ */
+extern void Trace40_begin(const char *category, const char *name);
+
+/* Trace40_end
+ *
+ * End the innermost span started on the calling thread.
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if no span is open on the calling thread.
+ */
+extern void Trace40_end(void);
+
+#endif
@@ -6,38 +6,88 @@
  * Implements the UArray2 data structure. It represents an unboxed 2D array
  * with fixed width, height, and element size. Supports access at arbitrary
  * indices of the array. Also includes map functions for row- and column-major
- * iteration.
+ * iteration. The elements live in one buffer from pool40, so the rasters of
+ * one image can reuse the memory of the last.
  */
 
 #include "stdlib.h"
 #include "stdio.h"
 #include "stdbool.h"
+#include "string.h"
+#include "limits.h"
  
-#include "uarray.h"
 #include "assert.h"
 #include "mem.h"
  
 #include "uarray2.h"
+#include "alloc40.h"
+#include "pool40.h"
  
 #define T UArray2_T
  
  /* struct UArray2_T
   * 
-  * Holds private data for each UArray2 instance.
+  * Holds private data for each UArray2 instance. An array may be a view of a
+  * rectangle inside a larger array, in which case its elements are found at
+  * `offset + col + stride * row` in the underlying storage. That index, and
+  * the size of the storage, are computed in size_t, so an array may hold more
+  * than INT_MAX elements and more than 4 GB.
   * 
   * Components
   *      int width       the width (number of columns) of the array
   *      int height      the height (number of rows) of the array
-  *      UArray2_T data  the underlying 1D array used to store the array's data
+  *      int size        the size of each element, in bytes
+  *      int stride      the number of elements in one row of the storage
+  *      size_t offset   the index in the storage of element (0, 0)
+  *      bool owner      whether this array frees the storage
+  *      char *elems     the storage of the array's data, row by row
+  *      size_t accounted the bytes counted for this array by alloc40
+  *      int tag         the alloc40 tag they were counted under
   */
  struct UArray2_T
  {
          int width;
          int height;
          int size;
-         UArray_T arr;
+         int stride;
+         size_t offset;
+         bool owner;
+         char *elems;
+         size_t accounted;
+         int tag;
  };
  
+/* defaultStorage
+ *
+ * Get the storage UArray2_new uses, from the comma-separated words
+ * ("aligned", "huge") of the UARRAY2_STORAGE environment variable. Read
+ * once; racing first calls all compute the same answer.
+ */
+static unsigned defaultStorage(void)
+{
+        static int storage = -1;
+        int known = __atomic_load_n(&storage, __ATOMIC_RELAXED);
+        if (known >= 0) {
+                return known;
+        }
+
+        unsigned flags = 0;
+        const char *words = getenv("UARRAY2_STORAGE");
+        while (words != NULL && *words != '\0') {
+                size_t len = strcspn(words, ",");
+                if (len == strlen("aligned") &&
+                    strncmp(words, "aligned", len) == 0) {
+                        flags |= UARRAY2_ALIGNED;
+                } else if (len == strlen("huge") &&
+                           strncmp(words, "huge", len) == 0) {
+                        flags |= UARRAY2_HUGE;
+                }
+                words += len + (words[len] == ',');
+        }
+        __atomic_store_n(&storage, (int)flags, __ATOMIC_RELAXED);
+        return flags;
+}
+
  /* UArray2_new
 * 
 * Allocate, initialize, and return a new unboxed 2D array.
@@ -54,26 +104,156 @@
 * Notes
 *      Will CRE if width and/or height are negative.
 *      Will CRE if size is not positive.
+*      Will CRE if the elements would take more bytes than a size_t can count.
 *      Allocates memory; will CRE if allocation fails. It is the responsibility
 *      of the client to free this array with UArray2_free().
 *      All elements are initialized to zero.
+*      Counted by alloc40 under the calling thread's tag; raises
+*      Alloc40_Over_Budget if that would go over the memory budget.
+*      Stored as the UARRAY2_STORAGE environment variable asks; see
+*      UArray2_new_storage().
 */
  extern T UArray2_new(int width, int height, int size)
  {
-         assert(width >= 0);
-         assert(height >= 0);
-         assert(size > 0);
- 
-         UArray2_T new_arr;
-         NEW(new_arr);
- 
-         new_arr->width = width;
-         new_arr->height = height;
-         new_arr->size = size;
-         new_arr->arr = UArray_new(width * height, size);
-         
-         return new_arr;
+         return UArray2_new_storage(width, height, size, defaultStorage());
  }
+
+/* UArray2_new_storage
+ * 
+ * Allocate, initialize, and return a new unboxed 2D array, choosing how its
+ * elements are stored.
+ * 
+ * Parameters
+ *      int width       the width (number of columns) of the array
+ *      int height      the height (number of rows) of the array
+ *      int size        the size of each element, in bytes; must include padding
+ *                      necessary for alignment
+ *      unsigned storage
+ *                      0, or UARRAY2_ALIGNED and/or UARRAY2_HUGE
+ *
+ * Returns
+ *      T               the created array
+ *
+ * Notes
+ *      Otherwise as UArray2_new(), which calls this with the storage the
+ *      environment asks for.
+ *      The elements always start on a 64-byte boundary. With UARRAY2_ALIGNED,
+ *      rows are padded so that every row does too. With UARRAY2_HUGE, arrays
+ *      of 2 MB or more are backed by huge pages where the system has them.
+ */
+extern T UArray2_new_storage(int width, int height, int size, unsigned storage)
+{
+        assert(width >= 0);
+        assert(height >= 0);
+        assert(size > 0);
+
+        int stride = width;
+        if (storage & UARRAY2_ALIGNED) {
+                /* the fewest elements that fill whole cache lines */
+                int unit = POOL40_ALIGN;
+                for (int bytes = size; bytes % 2 == 0 && unit > 1; bytes /= 2) {
+                        unit /= 2;
+                }
+                if (width <= INT_MAX - (unit - 1)) {
+                        stride = (width + unit - 1) / unit * unit;
+                }
+        }
+        size_t bytes, accounted;
+        bool overflow =
+                __builtin_mul_overflow((size_t)stride, height, &bytes) ||
+                __builtin_mul_overflow(bytes, size, &bytes) ||
+                __builtin_add_overflow(bytes, sizeof(struct UArray2_T),
+                                       &accounted);
+        assert(!overflow);
+
+        int tag = Alloc40_count(accounted);
+
+        UArray2_T new_arr;
+        NEW(new_arr);
+
+        new_arr->width = width;
+        new_arr->height = height;
+        new_arr->size = size;
+        new_arr->stride = stride;
+        new_arr->offset = 0;
+        new_arr->owner = true;
+        new_arr->elems = Pool40_alloc(bytes, (storage & UARRAY2_HUGE) != 0);
+        new_arr->accounted = accounted;
+        new_arr->tag = tag;
+
+        return new_arr;
+}
+
+/* UArray2_view
+ * 
+ * Create an array that views a rectangle of elements inside another array,
+ * without copying them.
+ * 
+ * Parameters
+ *      T parent        the array to view
+ *      int col         the column of `parent` that becomes column 0
+ *      int row         the row of `parent` that becomes row 0
+ *      int width       the width (number of columns) of the view
+ *      int height      the height (number of rows) of the view
+ *
+ * Returns
+ *      T               the created view
+ *
+ * Notes
+ *      Will CRE if `parent` is NULL or the rectangle does not fit in it.
+ *      The view shares its elements with `parent`; writes through either are
+ *      seen by both. `parent` must outlive the view. Freeing the view with
+ *      UArray2_free() leaves the elements (and `parent`) alone.
+ */
+extern T UArray2_view(T parent, int col, int row, int width, int height)
+{
+        assert(parent != NULL);
+        assert(col >= 0 && width >= 0 && width <= parent->width - col);
+        assert(row >= 0 && height >= 0 && height <= parent->height - row);
+
+        UArray2_T view;
+        NEW(view);
+        *view = *parent;
+        view->width = width;
+        view->height = height;
+        view->offset = parent->offset + col + (size_t)parent->stride * row;
+        view->owner = false;
+        view->accounted = sizeof(struct UArray2_T);
+        view->tag = Alloc40_count(view->accounted);
+
+        return view;
+}
+
+/* UArray2_crop
+ * 
+ * Narrow an array, in place, to a rectangle of its own elements. Takes
+ * constant time: no element is moved or copied.
+ * 
+ * Parameters
+ *      T uarray2       the array to narrow
+ *      int col         the column that becomes column 0
+ *      int row         the row that becomes row 0
+ *      int width       the new width (number of columns) of the array
+ *      int height      the new height (number of rows) of the array
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` is NULL or the rectangle does not fit in it.
+ *      The elements outside the rectangle stay allocated until the array is
+ *      freed, but are no longer reachable.
+ */
+extern void UArray2_crop(T uarray2, int col, int row, int width, int height)
+{
+        assert(uarray2 != NULL);
+        assert(col >= 0 && width >= 0 && width <= uarray2->width - col);
+        assert(row >= 0 && height >= 0 && height <= uarray2->height - row);
+
+        uarray2->offset += col + (size_t)uarray2->stride * row;
+        uarray2->width = width;
+        uarray2->height = height;
+}
  
  /* UArray2_free
  * 
@@ -89,6 +269,7 @@
  *      Will CRE if `uarray2` or `*uarray2` is NULL.
  *      Deallocates `*uarray2`. The caller relinquishes ownership of `*uarray2`.
  *      Sets `*uarray2` to NULL.
+ *      Freeing a view does not deallocate the elements it shares.
  */
  extern void UArray2_free(T *uarray2)
  {
@@ -97,7 +278,12 @@
          T referent = *uarray2;
          assert(referent != NULL);
  
-         UArray_free(&(referent->arr));
+         if (referent->owner) {
+                 /* an owner accounts for its header and its elements */
+                 Pool40_free(referent->elems, referent->accounted -
+                                              sizeof(struct UArray2_T));
+         }
+         Alloc40_uncount(referent->tag, referent->accounted);
          FREE(*uarray2);
          *uarray2 = NULL;
  }
@@ -182,7 +368,8 @@ void *UArray2_at(T uarray2, int col, int row)
         assert(col >= 0 && col < uarray2->width);
         assert(row >= 0 && row < uarray2->height);
 
-        return UArray_at(uarray2->arr, col + uarray2->width * row);
+        size_t index = uarray2->offset + col + (size_t)uarray2->stride * row;
+        return uarray2->elems + index * uarray2->size;
 }
 
  /* UArray2_map_row_major
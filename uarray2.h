@@ -7,6 +7,15 @@
  * fixed width, height, and element size. Supports access at arbitrary indices
  * of the array. Also includes map functions for row- and column-major
  * iteration.
+ *
+ * How the elements are stored can be chosen per array with
+ * UArray2_new_storage, or for every array made by UArray2_new (and so by the
+ * A2Methods backends) with the UARRAY2_STORAGE environment variable: a
+ * comma-separated list of "aligned" and "huge", such as "aligned,huge".
+ *
+ * Dimensions are ints, as the A2Methods interface requires, but sizes and
+ * indices are computed in size_t: an array may hold more than INT_MAX
+ * elements and more than 4 GB.
  */
 
 #ifndef UARRAY2_INCLUDED
@@ -15,6 +24,10 @@
 #define T UArray2_T
 typedef struct T *T;
 
+/* Storage options for UArray2_new_storage */
+#define UARRAY2_ALIGNED 1u      /* pad rows to start on 64-byte boundaries */
+#define UARRAY2_HUGE    2u      /* back large arrays with huge pages */
+
 /* UArray2_new
  * 
  * Allocate, initialize, and return a new unboxed 2D array.
@@ -31,12 +44,89 @@ typedef struct T *T;
  * Notes
  *      Will CRE if width and/or height are negative.
  *      Will CRE if size is not positive.
+ *      Will CRE if the elements would take more bytes than a size_t can count.
  *      Allocates memory; will CRE if allocation fails. It is the responsibility
  *      of the client to free this array with UArray2_free().
  *      All elements are initialized to zero.
+ *      Counted by alloc40 under the calling thread's tag; raises
+ *      Alloc40_Over_Budget if that would go over the memory budget.
+ *      Stored as the UARRAY2_STORAGE environment variable asks; see
+ *      UArray2_new_storage().
  */
 extern T UArray2_new(int width, int height, int size);
 
+/* UArray2_new_storage
+ * 
+ * Allocate, initialize, and return a new unboxed 2D array, choosing how its
+ * elements are stored.
+ * 
+ * Parameters
+ *      int width       the width (number of columns) of the array
+ *      int height      the height (number of rows) of the array
+ *      int size        the size of each element, in bytes; must include padding
+ *                      necessary for alignment
+ *      unsigned storage
+ *                      0, or UARRAY2_ALIGNED and/or UARRAY2_HUGE
+ *
+ * Returns
+ *      T               the created array
+ *
+ * Notes
+ *      Otherwise as UArray2_new(), which calls this with the storage the
+ *      environment asks for.
+ *      The elements always start on a 64-byte boundary. With UARRAY2_ALIGNED,
+ *      rows are padded so that every row does too. With UARRAY2_HUGE, arrays
+ *      of 2 MB or more are backed by huge pages where the system has them.
+ */
+extern T UArray2_new_storage(int width, int height, int size,
+                             unsigned storage);
+
+/* UArray2_view
+ * 
+ * Create an array that views a rectangle of elements inside another array,
+ * without copying them.
+ * 
+ * Parameters
+ *      T parent        the array to view
+ *      int col         the column of `parent` that becomes column 0
+ *      int row         the row of `parent` that becomes row 0
+ *      int width       the width (number of columns) of the view
+ *      int height      the height (number of rows) of the view
+ *
+ * Returns
+ *      T               the created view
+ *
+ * Notes
+ *      Will CRE if `parent` is NULL or the rectangle does not fit in it.
+ *      The view shares its elements with `parent`; writes through either are
+ *      seen by both. `parent` must outlive the view. Freeing the view with
+ *      UArray2_free() leaves the elements (and `parent`) alone.
+ *      A view is an ordinary UArray2, so it works with uarray2_methods_plain.
+ */
+extern T UArray2_view(T parent, int col, int row, int width, int height);
+
+/* UArray2_crop
+ * 
+ * Narrow an array, in place, to a rectangle of its own elements. Takes
+ * constant time: no element is moved or copied.
+ * 
+ * Parameters
+ *      T uarray2       the array to narrow
+ *      int col         the column that becomes column 0
+ *      int row         the row that becomes row 0
+ *      int width       the new width (number of columns) of the array
+ *      int height      the new height (number of rows) of the array
+ *
+ * Returns
+ *      (Nothing.)
+ *
+ * Notes
+ *      Will CRE if `uarray2` is NULL or the rectangle does not fit in it.
+ *      The elements outside the rectangle stay allocated until the array is
+ *      freed, but are no longer reachable.
+ */
+extern void UArray2_crop(T uarray2, int col, int row, int width, int height);
+
 /* UArray2_free
  * 
  * Deallocate and clear the given pointer to an array.
@@ -51,6 +141,7 @@ extern T UArray2_new(int width, int height, int size);
  *      Will CRE if `uarray2` or `*uarray2` is NULL.
  *      Deallocates `*uarray2`. The caller relinquishes ownership of `*uarray2`.
  *      Sets `*uarray2` to NULL.
+ *      Freeing a view does not deallocate the elements it shares.
  */
 extern void UArray2_free(T *uarray2);
 
@@ -19,6 +19,7 @@
  #include "mem.h"
  
  #include "uarray2b.h"
+ #include "alloc40.h"
  
  #define T UArray2b_T
  
@@ -30,8 +31,9 @@
 * Holds private data for each UArray2b instance.
 * This implementation is similar to the one suggested in the spec, internally
 * using a UArray2 of UArray2. (Our UArray2 implementation itself uses a single
-* UArray.) The width, height, and element size of the array are guaranteed not
-* to change. The same applies for the distribution of elements into blocks.
+* buffer from pool40.) The width, height, and element size of the array are
+* guaranteed not to change. The same applies for the distribution of elements
+* into blocks.
 * Each block is the same size and holds the same set of elements in contiguous
 * memory locations throughout the lifetime of the UArray2b.
 *
@@ -46,6 +48,8 @@
 *      UArray2_T blocks
 *                      the underlying 2D array of blocks; each element of this
 *                      array is *itself* a UArray2_T of actual array elements
+*      int tag         the alloc40 tag this header was counted under; the
+*                      blocks count themselves through UArray2_new
 */
  struct UArray2b_T {
          int width;
@@ -57,6 +61,7 @@
          int blocksize;
  
          UArray2_T blocks;
+         int tag;
  };
  
  /* UArray2b_new
@@ -82,6 +87,8 @@
 *      Allocates memory; will CRE if allocation fails. It is the responsibility
 *              of the client to free this array with UArray2b_free().
 *      All elements are initialized to zero.
+*      Counted by alloc40 under the calling thread's tag; raises
+*      Alloc40_Over_Budget if that would go over the memory budget.
 */
  T UArray2b_new(int width, int height, int size, int blocksize)
  {
@@ -100,6 +107,7 @@
          /* Create the outer array (of blocks) */
          UArray2b_T new_arr;
          NEW(new_arr);
+         new_arr->tag = Alloc40_count(sizeof(*new_arr));
  
          new_arr->width = width;
          new_arr->height = height;
@@ -191,6 +199,7 @@
          }
  
          UArray2_free(&(referent->blocks));
+         Alloc40_uncount(referent->tag, sizeof(*referent));
          FREE(*array2b);
          *array2b = NULL;
  }